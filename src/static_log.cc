@@ -8,29 +8,287 @@ namespace static_log
 
 uint32_t io_internal = 1000;
 
-void preallocate()
+void preallocate(size_t buffer_size)
 {
-    details::StaticLogBackend::preallocate();
+    details::StaticLogBackend::getDefault().preallocate(buffer_size);
+}
+
+void setStagingBufferSize(size_t buffer_size, size_t elastic_limit)
+{
+    details::StaticLogBackend::getDefault().setStagingBufferSize(buffer_size, elastic_limit);
+}
+
+void setStagingMemory(uint32_t flags)
+{
+    details::StaticLogBackend::getDefault().setStagingMemory(flags);
+}
+
+void setStagingWatermark(uint32_t percent)
+{
+    details::StaticLogBackend::getDefault().setStagingWatermark(percent);
+}
+
+void setStagingPoolSize(size_t max_bytes)
+{
+    details::StaticLogBackend::getDefault().setStagingPoolSize(max_bytes);
+}
+
+void setNumaWorkers(bool enabled)
+{
+    details::StaticLogBackend::getDefault().setNumaWorkers(enabled);
+}
+
+void setBackendWorkers(uint32_t num_workers, ShardOutput output)
+{
+    details::StaticLogBackend::getDefault().setBackendWorkers(num_workers, output);
+}
+
+void setBackendThreads(const int* cpus, size_t num_cpus, int sched_policy, int sched_priority)
+{
+    details::StaticLogBackend::getDefault().setBackendThreads(cpus, num_cpus, sched_policy,
+                                                              sched_priority);
+}
+
+void setBackendWaitStrategy(WaitStrategy strategy, uint32_t max_backoff_us)
+{
+    details::StaticLogBackend::getDefault().setBackendWaitStrategy(strategy, max_backoff_us);
+}
+
+void setOverflowPolicy(LogLevels::LogLevel level, OverflowPolicy policy)
+{
+    details::StaticLogBackend::getDefault().setOverflowPolicy(level, policy);
+}
+
+void setOverflowPolicy(OverflowPolicy policy)
+{
+    for (int level = 0; level < LogLevels::kNUM_LOG_LEVELS; ++level)
+        details::StaticLogBackend::getDefault().setOverflowPolicy(static_cast<LogLevels::LogLevel>(level), policy);
+}
+
+void setThreadOverflowPolicy(OverflowPolicy policy)
+{
+    details::StaticLogBackend::getDefault().setThreadOverflowPolicy(policy);
+}
+
+void clearThreadOverflowPolicy()
+{
+    details::StaticLogBackend::getDefault().setThreadOverflowPolicy(-1);
 }
 
 void setLogFile(const char* filename)
 {
-    details::StaticLogBackend::setLogFile(filename);
+    details::StaticLogBackend::getDefault().setLogFile(filename);
 }
 
 LogLevels::LogLevel getLogLevel() 
 {
-    return details::StaticLogBackend::getLogLevel();
+    return details::StaticLogBackend::getDefault().getLogLevel();
 }
 
 void setLogLevel(LogLevels::LogLevel log_level) 
 {
-    details::StaticLogBackend::setLogLevel(log_level);
+    details::StaticLogBackend::getDefault().setLogLevel(log_level);
 }
 
 void sync()
 {
-    details::StaticLogBackend::sync();
+    details::StaticLogBackend::getDefault().sync();
+}
+
+void setDrainBatchSize(uint32_t max_entries)
+{
+    details::StaticLogBackend::getDefault().setDrainBatchSize(max_entries);
+}
+
+void setOutputOrdering(OutputOrdering ordering, uint32_t reorder_window_us)
+{
+    details::StaticLogBackend::getDefault().setOutputOrdering(ordering, reorder_window_us);
+}
+
+void setOutputBuffering(size_t flush_threshold, uint32_t max_latency_us)
+{
+    details::StaticLogBackend::getDefault().setOutputBuffering(flush_threshold, max_latency_us);
+}
+
+void setOutputSink(OutputSink sink, uint32_t queue_depth, int writer_cpu)
+{
+    details::StaticLogBackend::getDefault().setOutputSink(sink, queue_depth, writer_cpu);
+}
+
+void setOutputFormat(OutputFormat format)
+{
+    details::StaticLogBackend::getDefault().setOutputFormat(format);
+}
+
+void setTimestampFormat(TimestampFormat format)
+{
+    details::StaticLogBackend::getDefault().setTimestampFormat(format);
+}
+
+bool setLogPattern(const char* pattern)
+{
+    return details::StaticLogBackend::getDefault().setLogPattern(pattern);
+}
+
+OutputStats getOutputStats()
+{
+    return details::StaticLogBackend::getDefault().getOutputStats();
+}
+
+StagingStats getStagingStats()
+{
+    return details::StaticLogBackend::getDefault().getStagingStats();
+}
+
+ClockCalibration getClockCalibration()
+{
+    return details::StaticLogBackend::getDefault().getClockCalibration();
+}
+
+void setClockRecalibrationInterval(uint32_t interval_ms)
+{
+    details::StaticLogBackend::getDefault().setClockRecalibrationInterval(interval_ms);
+}
+
+Logger::Logger(const char* log_file):
+    backend_(new details::StaticLogBackend(log_file))
+{
+}
+
+Logger::~Logger()
+{
+    delete backend_;
+}
+
+void Logger::preallocate(size_t buffer_size)
+{
+    backend_->preallocate(buffer_size);
+}
+
+void Logger::setStagingBufferSize(size_t buffer_size, size_t elastic_limit)
+{
+    backend_->setStagingBufferSize(buffer_size, elastic_limit);
+}
+
+void Logger::setStagingMemory(uint32_t flags)
+{
+    backend_->setStagingMemory(flags);
+}
+
+void Logger::setStagingWatermark(uint32_t percent)
+{
+    backend_->setStagingWatermark(percent);
+}
+
+void Logger::setStagingPoolSize(size_t max_bytes)
+{
+    backend_->setStagingPoolSize(max_bytes);
+}
+
+void Logger::setNumaWorkers(bool enabled)
+{
+    backend_->setNumaWorkers(enabled);
+}
+
+void Logger::setBackendWorkers(uint32_t num_workers, ShardOutput output)
+{
+    backend_->setBackendWorkers(num_workers, output);
+}
+
+void Logger::setBackendThreads(const int* cpus, size_t num_cpus, int sched_policy, int sched_priority)
+{
+    backend_->setBackendThreads(cpus, num_cpus, sched_policy, sched_priority);
+}
+
+void Logger::setBackendWaitStrategy(WaitStrategy strategy, uint32_t max_backoff_us)
+{
+    backend_->setBackendWaitStrategy(strategy, max_backoff_us);
+}
+
+void Logger::setOverflowPolicy(LogLevels::LogLevel level, OverflowPolicy policy)
+{
+    backend_->setOverflowPolicy(level, policy);
+}
+
+void Logger::setOverflowPolicy(OverflowPolicy policy)
+{
+    for (int level = 0; level < LogLevels::kNUM_LOG_LEVELS; ++level)
+        backend_->setOverflowPolicy(static_cast<LogLevels::LogLevel>(level), policy);
+}
+
+void Logger::setThreadOverflowPolicy(OverflowPolicy policy)
+{
+    backend_->setThreadOverflowPolicy(policy);
+}
+
+void Logger::clearThreadOverflowPolicy()
+{
+    backend_->setThreadOverflowPolicy(-1);
+}
+
+void Logger::setLogFile(const char* filename)
+{
+    backend_->setLogFile(filename);
+}
+
+LogLevels::LogLevel Logger::getLogLevel()
+{
+    return backend_->getLogLevel();
+}
+
+void Logger::setLogLevel(LogLevels::LogLevel log_level)
+{
+    backend_->setLogLevel(log_level);
+}
+
+void Logger::sync()
+{
+    backend_->sync();
+}
+
+void Logger::setDrainBatchSize(uint32_t max_entries)
+{
+    backend_->setDrainBatchSize(max_entries);
+}
+
+void Logger::setOutputOrdering(OutputOrdering ordering, uint32_t reorder_window_us)
+{
+    backend_->setOutputOrdering(ordering, reorder_window_us);
+}
+
+void Logger::setOutputBuffering(size_t flush_threshold, uint32_t max_latency_us)
+{
+    backend_->setOutputBuffering(flush_threshold, max_latency_us);
+}
+
+void Logger::setOutputSink(OutputSink sink, uint32_t queue_depth, int writer_cpu)
+{
+    backend_->setOutputSink(sink, queue_depth, writer_cpu);
+}
+
+void Logger::setOutputFormat(OutputFormat format)
+{
+    backend_->setOutputFormat(format);
+}
+
+void Logger::setTimestampFormat(TimestampFormat format)
+{
+    backend_->setTimestampFormat(format);
+}
+
+bool Logger::setLogPattern(const char* pattern)
+{
+    return backend_->setLogPattern(pattern);
+}
+
+OutputStats Logger::getOutputStats()
+{
+    return backend_->getOutputStats();
+}
+
+StagingStats Logger::getStagingStats()
+{
+    return backend_->getStagingStats();
 }
 
 } // namespace static_log
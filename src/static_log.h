@@ -2,6 +2,8 @@
 #define STATIC_LOG_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <sched.h>
 #include "tsc_clock.h"
 
 namespace static_log {
@@ -41,6 +43,196 @@ namespace LogLevels {
 
 extern uint32_t io_internal;
 
+/**
+ * Order in which the backend outputs the messages of different threads.
+ */
+enum OutputOrdering {
+    // Merge all threads by timestamp
+    kTIME_ORDERED = 0,
+    // Drain each thread in turn, only the order within a thread is kept
+    kUNORDERED
+};
+
+/**
+ * State of the model used by the backend to convert the TSC values recorded
+ * at the call site into wall-clock timestamps.
+ */
+struct ClockCalibration {
+    // Nanoseconds per TSC tick
+    double   ns_per_tick;
+
+    // Reference pair the model is anchored on
+    uint64_t base_tsc;
+    int64_t  base_ns;
+
+    // Error of the previous model, in nanoseconds, observed at the last
+    // recalibration, and the largest such error seen so far
+    int64_t  last_drift_ns;
+    int64_t  max_drift_ns;
+
+    // Number of (re)calibrations performed, 0 until the backend has started
+    uint64_t num_calibrations;
+
+    uint32_t recalibrate_interval_ms;
+};
+
+/**
+ * How the backend writes the formatted output to the log file.
+ */
+enum OutputSink {
+    // pwritev() from the backend worker
+    kSYNC_WRITE = 0,
+    // Asynchronous writes through io_uring, overlapping formatting and I/O
+    kIO_URING,
+    // pwritev() from a writer thread, fed through a bounded queue of output
+    // chunks, so that the backend keeps draining while a write blocks
+    kWRITER_THREAD
+};
+
+/**
+ * What a backend worker does when a pass found nothing to write, see
+ * setBackendWaitStrategy. Trades the latency from a message being logged
+ * to it being drained for the CPU the worker burns while idle.
+ */
+enum WaitStrategy {
+    // Sleeps on a futex until sync() or io_internal microseconds. No CPU
+    // when idle, up to io_internal of latency
+    kWAIT_SLEEP = 0,
+    // Polls again right away. The lowest latency, a whole core
+    kWAIT_BUSY_SPIN,
+    // Spins on pause between polls, doubling the spin up to a limit. A
+    // whole core too, but fewer polls and less contention with the
+    // sibling hyperthread
+    kWAIT_BACKOFF,
+    // Like kWAIT_BACKOFF, with the spins in tpause, a light sleep state
+    // that saves power and frees the core for its sibling. kWAIT_BACKOFF
+    // on CPUs without WAITPKG
+    kWAIT_TPAUSE
+};
+
+/**
+ * Where the backend workers write their lines, see setBackendWorkers.
+ */
+enum ShardOutput {
+    // Every worker appends its lines to the log file, a pass at a time
+    kMERGED_OUTPUT = 0,
+    // Each worker writes its own file: the log file for the first one, and
+    // the log file name followed by ".<worker>" for the others
+    kSHARD_FILES
+};
+
+/**
+ * Encoding of the log file.
+ */
+enum OutputFormat {
+    // Human readable lines formatted by the backend
+    kTEXT = 0,
+    // Raw arguments plus a call site dictionary, rendered offline by the
+    // static_log_decode tool
+    kBINARY
+};
+
+/**
+ * How the time of a message is rendered by the %T field of the log
+ * pattern, see setLogPattern.
+ */
+enum TimestampFormat {
+    // Local time, 2026-10-16-14:07:57.581963213
+    kLOCAL_NANOSECONDS = 0,
+    // Local time, 2026-10-16-14:07:57.581963
+    kLOCAL_MICROSECONDS,
+    // Nanoseconds since the epoch, 1792159677581963213
+    kEPOCH_NANOSECONDS,
+    // UTC in the ISO-8601 format, 2026-10-16T14:07:57.581963213Z
+    kISO8601_UTC
+};
+
+/**
+ * What a thread does with a message when its StagingBuffer is full, see
+ * setOverflowPolicy.
+ */
+enum OverflowPolicy {
+    // Wait for the backend to drain the buffer
+    kBLOCK = 0,
+    // Drop the message
+    kDROP_NEWEST,
+    // Discard the oldest messages of the buffer to make room, the buffer
+    // keeps the latest ones like a flight recorder
+    kOVERWRITE_OLDEST
+};
+
+/**
+ * How the memory of the StagingBuffers is allocated, flags of
+ * setStagingMemory.
+ */
+enum StagingMemoryFlags {
+    // malloc(), the pages are faulted in by the first messages
+    kSTAGING_MALLOC = 0,
+    // mmap() with MAP_POPULATE, all the pages are faulted in when the
+    // buffer is allocated, e.g. by preallocate()
+    kSTAGING_PREFAULT = 1,
+    // Huge pages, reserved ones (MAP_HUGETLB) if the system has some left,
+    // transparent ones otherwise
+    kSTAGING_HUGEPAGES = 2,
+    // mlock() the buffer so that its pages are never swapped out
+    kSTAGING_MLOCK = 4
+};
+
+/**
+ * Statistics of the backend output stage.
+ */
+struct OutputStats {
+    // Totals since start-up
+    uint64_t bytes_written;
+    uint64_t num_flushes;
+    uint64_t num_syscalls;
+
+    // Size of the most recent flush, in bytes and in write syscalls, and
+    // the largest flush so far
+    uint64_t last_flush_bytes;
+    uint64_t last_flush_syscalls;
+    uint64_t max_flush_bytes;
+
+    // Messages that arrived after the reorder window and could not be
+    // output in time order
+    uint64_t num_out_of_order;
+
+    // Sink in use, kSYNC_WRITE if io_uring was requested but is unavailable
+    OutputSink active_sink;
+};
+
+/**
+ * Statistics of the StagingBuffers the logging threads write to.
+ */
+struct StagingStats {
+    // Messages logged and bytes they took in the StagingBuffers
+    uint64_t num_messages;
+    uint64_t bytes_logged;
+
+    // Segments added to full elastic StagingBuffers, see
+    // setStagingBufferSize
+    uint64_t num_segments_chained;
+
+    // StagingBuffers allocated from the pool of retired ones and from the
+    // heap, and the memory in the pool, see setStagingPoolSize
+    uint64_t num_pool_hits;
+    uint64_t num_pool_misses;
+    uint64_t pool_bytes;
+
+    // Messages dropped or overwritten by the overflow policies, see
+    // setOverflowPolicy
+    uint64_t num_dropped;
+
+    // Times the threads waited for space in a full StagingBuffer, and the
+    // TSC ticks they spent waiting
+    uint64_t num_times_producer_blocked;
+    uint64_t cycles_producer_blocked;
+
+    // Times a thread crossing the fill watermark of its StagingBuffer woke
+    // up a sleeping backend, see setStagingWatermark
+    uint64_t num_watermark_wakeups;
+};
+
 // User API
 
 /**
@@ -48,8 +240,165 @@ extern uint32_t io_internal;
  * StaticLog system for the current thread. Although optional, it is
  * recommended to invoke this function in every thread that will use the
  * StaticLog system before the first log message.
+ *
+ * \param buffer_size
+ *      Capacity of the StagingBuffer of the thread in bytes, 0 for the one
+ *      set by setStagingBufferSize. Ignored if the thread already has one.
+ */
+void preallocate(size_t buffer_size = 0);
+
+/**
+ * Sets the capacity of the StagingBuffers of the threads that log or
+ * preallocate() afterwards without giving one.
+ *
+ * A thread whose StagingBuffer is full waits for the backend to drain it.
+ * In the elastic mode it chains a new segment of the same capacity to its
+ * buffer instead and keeps logging; the backend releases the full segment
+ * once it has written it out. The thread only waits when its segments
+ * would take more than elastic_limit bytes.
+ *
+ * \param buffer_size
+ *      Capacity in bytes, 1MB by default, at least 4KB
+ * \param elastic_limit
+ *      0 to disable the elastic mode (the default), or the most memory the
+ *      segments of a thread may take
+ */
+void setStagingBufferSize(size_t buffer_size, size_t elastic_limit = 0);
+
+/**
+ * Selects how the StagingBuffers allocated afterwards get their memory.
+ * With the default malloc() the first messages of a thread fault in the
+ * pages of its buffer one by one, in the logging call. With
+ * kSTAGING_PREFAULT the buffer allocated by preallocate() is fully faulted
+ * in, and the thread takes no page fault while logging.
+ *
+ * \param flags
+ *      kSTAGING_MALLOC, or kSTAGING_PREFAULT, kSTAGING_HUGEPAGES and
+ *      kSTAGING_MLOCK or-ed together
+ */
+void setStagingMemory(uint32_t flags);
+
+/**
+ * Sets the fill level at which the StagingBuffers allocated afterwards
+ * wake up the backend. A thread crossing it wakes up a sleeping backend
+ * worker right away instead of letting it sleep for up to io_internal
+ * microseconds, so that a burst is drained before it fills the buffer.
+ * The fill is measured against what the backend has consumed, so a
+ * stream the backend keeps up with never wakes it. It only happens once
+ * per crossing: the buffer checks the watermark again after its next trip
+ * through the slow path of the reservation. The wakeup costs no syscall
+ * unless a worker is actually sleeping.
+ *
+ * \param percent
+ *      Fill level in percent of the capacity, 50 by default, 0 disables
+ *      the wakeups
+ */
+void setStagingWatermark(uint32_t percent);
+
+/**
+ * Sets how much memory the backend keeps from the StagingBuffers of the
+ * threads that exited (and from the drained elastic segments). A new
+ * thread or segment adopts a kept buffer of its capacity, whose pages are
+ * already faulted in, instead of allocating one, which saves the cost of
+ * thread churn in thread pools.
+ *
+ * \param max_bytes
+ *      Memory kept at most, 8MB by default, 0 disables the pool
+ */
+void setStagingPoolSize(size_t max_bytes);
+
+/**
+ * Runs one backend worker per NUMA node instead of a single one. The
+ * StagingBuffer of a thread is always placed on the node it runs on when
+ * it allocates it; with the per-node workers it is also drained by the
+ * worker bound to that node, so that neither the buffer nor the formatting
+ * crosses the interconnect. Each worker writes its lines to the log file
+ * in batches: they are in order per thread, but kTIME_ORDERED only orders
+ * the threads of a node. Everything logged before is written out first.
+ *
+ * \param enabled
+ *      true for a worker per node, false for a single worker (the default)
+ */
+void setNumaWorkers(bool enabled);
+
+/**
+ * Splits the StagingBuffers among several backend workers, so that the
+ * draining and formatting keep up with many logging threads. A thread's
+ * StagingBuffer belongs to the shard of its id modulo num_workers, and
+ * each shard is drained by a single worker, so the lines of a thread stay
+ * in order; kTIME_ORDERED only orders the threads of a shard. With
+ * setNumaWorkers there are num_workers workers per node. Everything
+ * logged before is written out first.
+ *
+ * \param num_workers
+ *      Number of workers, 1 by default, up to kMAX_BACKEND_WORKERS
+ * \param output
+ *      Whether the workers share the log file or write one file each
+ */
+void setBackendWorkers(uint32_t num_workers, ShardOutput output = kMERGED_OUTPUT);
+
+/**
+ * Sets where and how the backend workers run, from their next start: the
+ * workers are restarted, writing out everything logged before. By default
+ * worker i is pinned to core 1 + i, or to its node with setNumaWorkers.
+ *
+ * \param cpus
+ *      CPUs the workers are pinned to, worker i to cpus[i % num_cpus],
+ *      NULL for the default
+ * \param num_cpus
+ *      Number of entries of cpus
+ * \param sched_policy
+ *      SCHED_OTHER (the default), SCHED_FIFO or SCHED_RR
+ * \param sched_priority
+ *      Priority of the real-time policies
+ */
+void setBackendThreads(const int* cpus, size_t num_cpus, int sched_policy = SCHED_OTHER,
+                       int sched_priority = 0);
+
+/**
+ * Selects how the backend workers wait for messages when they are idle,
+ * see WaitStrategy. Takes effect at the next pass.
+ *
+ * \param strategy
+ *      kWAIT_SLEEP by default
+ * \param max_backoff_us
+ *      Longest spin of kWAIT_BACKOFF and kWAIT_TPAUSE between two polls
+ */
+void setBackendWaitStrategy(WaitStrategy strategy, uint32_t max_backoff_us = 50);
+
+/**
+ * Sets what a thread does with a message of the given level when its
+ * StagingBuffer is full, or when its elastic segments took their limit. By
+ * default all the levels block.
+ *
+ * kDROP_NEWEST and kOVERWRITE_OLDEST never wait for the backend. The
+ * overwriting thread cannot discard messages the backend is writing out,
+ * the new message is dropped instead then. Once the backend has drained the
+ * buffer it writes a "N messages dropped" line for the lost messages, which
+ * are also counted in getStagingStats().
+ *
+ * \param level
+ *      Level of the messages the policy applies to
+ * \param policy
+ *      kBLOCK, kDROP_NEWEST or kOVERWRITE_OLDEST
+ */
+void setOverflowPolicy(LogLevels::LogLevel level, OverflowPolicy policy);
+
+/**
+ * Sets the overflow policy of all the levels.
+ */
+void setOverflowPolicy(OverflowPolicy policy);
+
+/**
+ * Sets the overflow policy of the messages of the calling thread, whatever
+ * their level, e.g. to never block a latency critical thread.
+ */
+void setThreadOverflowPolicy(OverflowPolicy policy);
+
+/**
+ * Makes the calling thread use the overflow policies of the levels again.
  */
-void preallocate();
+void clearThreadOverflowPolicy();
 
 /**
  * Sets the file location for the StaticLog output. All NANO_LOG statements
@@ -85,6 +434,196 @@ LogLevels::LogLevel getLogLevel();
  */
 void sync();
 
+/**
+ * Sets how many log messages the backend processes before checking the
+ * thread list, timers and clock again: per thread in the unordered mode,
+ * and in total in the time ordered mode. Space is released to the producers
+ * once per batch.
+ *
+ * \param max_entries
+ *      Batch size, 0 (the default) drains everything available
+ */
+void setDrainBatchSize(uint32_t max_entries);
+
+/**
+ * Selects how messages logged by different threads are ordered in the
+ * output.
+ *
+ * In the time ordered mode (the default) messages are merged by timestamp.
+ * A message is held back until it is reorder_window_us old, so the output
+ * is globally sorted as long as no thread takes longer than that between
+ * stamping a message and publishing it. The unordered mode skips the merge
+ * for maximum throughput.
+ *
+ * \param ordering
+ *      kTIME_ORDERED or kUNORDERED
+ * \param reorder_window_us
+ *      Reorder window of the time ordered mode, in microseconds
+ */
+void setOutputOrdering(OutputOrdering ordering, uint32_t reorder_window_us = 0);
+
+/**
+ * Configures how the backend coalesces formatted messages before writing
+ * them to the log file.
+ *
+ * \param flush_threshold
+ *      Amount of buffered output, in bytes, that triggers a write
+ * \param max_latency_us
+ *      Longest time a message may stay buffered before being written
+ */
+void setOutputBuffering(size_t flush_threshold, uint32_t max_latency_us);
+
+/**
+ * Selects how the output is written. The io_uring sink registers the output
+ * chunks and the log file with the kernel and keeps up to queue_depth
+ * flushes in flight while the backend keeps formatting. It falls back to
+ * the synchronous sink when io_uring is not available, which is reported
+ * by getOutputStats(). The writer thread sink hands the same chunks to a
+ * thread of each backend worker doing the writes, so that slow storage
+ * only stalls the backend once queue_depth flushes are waiting.
+ *
+ * \param sink
+ *      kSYNC_WRITE (the default), kIO_URING or kWRITER_THREAD
+ * \param queue_depth
+ *      Number of flushes kept in flight by the asynchronous sinks
+ * \param writer_cpu
+ *      CPU the writer threads are pinned to, -1 to leave them unpinned
+ */
+void setOutputSink(OutputSink sink, uint32_t queue_depth = 4, int writer_cpu = -1);
+
+/**
+ * Selects the encoding of the log file. The binary format skips all the
+ * formatting in the backend and produces much smaller files, use the
+ * static_log_decode tool to turn them into text. A file only holds one
+ * format, the new one is used from the next setLogFile() on.
+ *
+ * \param format
+ *      kTEXT (the default) or kBINARY
+ */
+void setOutputFormat(OutputFormat format);
+
+/**
+ * Selects how the time of each message is rendered in the text output. The
+ * static_log_decode tool takes the format of binary logs as its -t option.
+ * Takes effect from the next pass of the backend on.
+ *
+ * \param format
+ *      kLOCAL_NANOSECONDS (the default), kLOCAL_MICROSECONDS,
+ *      kEPOCH_NANOSECONDS or kISO8601_UTC
+ */
+void setTimestampFormat(TimestampFormat format);
+
+/**
+ * Sets the layout of the lines of the text output. Each field is a '%'
+ * followed by a letter, anything else is copied as is:
+ *   %T  timestamp, see setTimestampFormat
+ *   %l  level name
+ *   %t  id of the logging thread
+ *   %P  process id
+ *   %f  source file, as given to the compiler
+ *   %s  source file without its directories
+ *   %F  function
+ *   %L  line
+ *   %v  message
+ *   %%  '%'
+ * The default is "[%T][%l][%F][%L]%v". The pattern is compiled once, each
+ * line only costs the fields it selects. The static_log_decode tool takes
+ * the pattern of binary logs as its -p option.
+ *
+ * \param pattern
+ *      Layout of the lines, e.g. "%T [%l] %t %s:%L %v"
+ * \return
+ *      false if the pattern holds an unknown field, the layout is then left
+ *      unchanged
+ */
+bool setLogPattern(const char* pattern);
+
+/**
+ * Returns the statistics of the output stage.
+ */
+OutputStats getOutputStats();
+
+/**
+ * Returns the statistics of the StagingBuffers, summed over all threads.
+ */
+StagingStats getStagingStats();
+
+/**
+ * Returns the current TSC calibration state used to timestamp log messages.
+ */
+ClockCalibration getClockCalibration();
+
+/**
+ * Sets how often the backend re-anchors the TSC to wall-clock model.
+ *
+ * \param interval_ms
+ *      Recalibration interval in milliseconds
+ */
+void setClockRecalibrationInterval(uint32_t interval_ms);
+
+namespace details {
+class StaticLogBackend;
+}
+
+/**
+ * A logger independent of the default one of STATIC_LOG, logged to with
+ * STATIC_LOG_TO. It has its own StagingBuffers in each thread, backend
+ * worker, log file and level, so that a flood of messages on one logger
+ * never blocks nor delays the threads logging to another.
+ *
+ * The methods apply to the logger like the functions of the same name
+ * apply to the default one. At most kMAX_LOGGERS loggers exist at a time,
+ * the default one included. Destroying a logger writes out what was logged
+ * to it, no thread may log to it anymore then.
+ */
+class Logger {
+public:
+    /**
+     * \param log_file
+     *      File to log to
+     */
+    explicit Logger(const char* log_file);
+    ~Logger();
+
+    Logger(const Logger&)=delete;
+    Logger& operator=(const Logger&)=delete;
+
+    void preallocate(size_t buffer_size = 0);
+    void setStagingBufferSize(size_t buffer_size, size_t elastic_limit = 0);
+    void setStagingMemory(uint32_t flags);
+    void setStagingWatermark(uint32_t percent);
+    void setStagingPoolSize(size_t max_bytes);
+    void setNumaWorkers(bool enabled);
+    void setBackendWorkers(uint32_t num_workers, ShardOutput output = kMERGED_OUTPUT);
+    void setBackendThreads(const int* cpus, size_t num_cpus, int sched_policy = SCHED_OTHER,
+                           int sched_priority = 0);
+    void setBackendWaitStrategy(WaitStrategy strategy, uint32_t max_backoff_us = 50);
+    void setOverflowPolicy(LogLevels::LogLevel level, OverflowPolicy policy);
+    void setOverflowPolicy(OverflowPolicy policy);
+    void setThreadOverflowPolicy(OverflowPolicy policy);
+    void clearThreadOverflowPolicy();
+    void setLogFile(const char* filename);
+    LogLevels::LogLevel getLogLevel();
+    void setLogLevel(LogLevels::LogLevel log_level);
+    void sync();
+    void setDrainBatchSize(uint32_t max_entries);
+    void setOutputOrdering(OutputOrdering ordering, uint32_t reorder_window_us = 0);
+    void setOutputBuffering(size_t flush_threshold, uint32_t max_latency_us);
+    void setOutputSink(OutputSink sink, uint32_t queue_depth = 4, int writer_cpu = -1);
+    void setOutputFormat(OutputFormat format);
+    void setTimestampFormat(TimestampFormat format);
+    bool setLogPattern(const char* pattern);
+    OutputStats getOutputStats();
+    StagingStats getStagingStats();
+
+    details::StaticLogBackend& getBackend() {
+        return *backend_;
+    }
+
+private:
+    details::StaticLogBackend* backend_;
+};
+
 /**
  * STATIC_LOG macro used for logging.
  *
@@ -95,17 +634,35 @@ void sync();
  * \param ...
  *      Log arguments associated with the printf-like string.
  */
-#define STATIC_LOG(severity, format, ...) do { \
+#define STATIC_LOG(severity, format, ...) \
+    STATIC_LOG_TO_BACKEND(static_log::details::StaticLogBackend::getDefault(), \
+                          severity, format, ##__VA_ARGS__)
+
+/**
+ * STATIC_LOG to a Logger.
+ *
+ * \param logger
+ *      static_log::Logger to log to
+ */
+#define STATIC_LOG_TO(logger, severity, format, ...) \
+    STATIC_LOG_TO_BACKEND((logger).getBackend(), severity, format, ##__VA_ARGS__)
+
+#define STATIC_LOG_TO_BACKEND(backend, severity, format, ...) do { \
+    static_log::details::StaticLogBackend& static_log_backend = (backend); \
     constexpr int n_params = static_log::details::countFmtParams(format); \
     \
     /*** Very Important*** These must be 'static' so that we can save pointers 
      **/ \
     static constexpr std::array<static_log::details::ParamType, n_params> param_types = \
                                 static_log::details::analyzeFormatString<n_params>(format); \
+    static constexpr auto format_layout = static_log::details::analyzeFormatLayout<n_params>(format); \
+    using arg_types = decltype(static_log::details::argTypeList(__VA_ARGS__)); \
     static constexpr static_log::details::StaticInfo static_info =  \
-                            static_log::details::StaticInfo(n_params, param_types.data(), format, severity, __FUNCTION__, __LINE__); \
+                            static_log::details::StaticInfo(n_params, param_types.data(), arg_types::sizes, \
+                                                            format, severity, __FUNCTION__, __FILE__, __LINE__, \
+                                                            static_log::details::getFormatFunction<format_layout>(arg_types{})); \
     \
-    if (severity > static_log::getLogLevel()) \
+    if (severity > static_log_backend.getLogLevel()) \
         break; \
     \
     /* Triggers the GNU printf checker by passing it into a no-op function.
@@ -113,19 +670,27 @@ void sync();
      * evaluate for cases like '++i'.*/ \
     if (false) { static_log::details::checkFormat(format, ##__VA_ARGS__); } /*NOLINT(cppcoreguidelines-pro-type-vararg, hicpp-vararg)*/\
     \
-    static size_t param_size[n_params + 1]{};   \
+    static const uint32_t callsite_id = static_log::details::StaticLogBackend::registerCallsite(&static_info);   \
+    /* Lengths of the string arguments of this message */ \
+    size_t string_sizes[n_params + 1];   \
     uint64_t previousPrecision = -1;   \
     size_t alloc_size = static_log::details::getArgSizes(param_types, previousPrecision,    \
-                            param_size, ##__VA_ARGS__) + sizeof(static_log::details::LogEntry);    \
-    char *write_pos = static_log::details::StaticLogBackend::reserveAlloc(alloc_size);   \
+                            string_sizes, ##__VA_ARGS__) + sizeof(static_log::details::LogEntry)    \
+                            + static_log::details::kMAX_VARINT_LEN;    \
+    char *write_pos = static_log_backend.reserveAlloc(alloc_size, severity);   \
+    /* Dropped by the overflow policy */ \
+    if (write_pos == nullptr) \
+        break; \
     \
-    static_log::details::LogEntry *log_entry = new(write_pos) static_log::details::LogEntry(&static_info, param_size);    \
+    static_log::details::LogEntry *log_entry = reinterpret_cast<static_log::details::LogEntry *>(write_pos);    \
+    log_entry->callsite_id = callsite_id;    \
     write_pos += sizeof(static_log::details::LogEntry);    \
-    static_log::details::storeArguments(param_types, param_size, &write_pos, ##__VA_ARGS__);    \
-    log_entry->entry_size = static_log::details::downCast<uint32_t>(alloc_size);    \
-    log_entry->timestamp = __builtin_ia32_rdtsc();  \
+    write_pos = static_log_backend.encodeTimestamp(write_pos, __builtin_ia32_rdtsc());  \
+    static_log::details::storeArguments(param_types, string_sizes, &write_pos, ##__VA_ARGS__);    \
+    uint32_t entry_size = static_log::details::downCast<uint32_t>(write_pos - reinterpret_cast<char *>(log_entry));    \
+    log_entry->entry_size = entry_size;    \
     \
-    static_log::details::StaticLogBackend::finishAlloc(alloc_size);  \
+    static_log_backend.finishAlloc(entry_size);  \
 } while(0)
 
 } // namespace static_log
@@ -13,564 +13,476 @@
 
 #include <chrono>
 #include <iostream>
-#include <chrono>
+#include <algorithm>
 
 #include "static_log_internal.h"
-#include "static_log_cycles.h"
+#include "static_log_format.h"
+#include "static_log_binary.h"
 
 
 namespace static_log {
 
 namespace details {
 
-static const char* log_level_str[] = {
-    "non",
-    "error",
-    "warn",
-    "notice",
-    "debug"
-};
+#define DEFAULT_LOGFILE     "log.txt"
 
-__thread StagingBuffer *StaticLogBackend::staging_buffer_ = nullptr;
-StaticLogBackend StaticLogBackend::logger_;
+__thread StaticLogBackend::ThreadBuffer StaticLogBackend::thread_buffers_[kMAX_LOGGERS];
 thread_local StaticLogBackend::StagingBufferDestroyer StaticLogBackend::destroyer_{};
+std::mutex StaticLogBackend::ids_mutex_;
+bool StaticLogBackend::ids_used_[kMAX_LOGGERS];
+uint64_t StaticLogBackend::last_serial_ = 0;
+std::mutex StaticLogBackend::callsite_mutex_;
+std::vector<Callsite> StaticLogBackend::callsites_;
+StaticLogBackend StaticLogBackend::logger_(DEFAULT_LOGFILE);
 
 #define DEFAULT_INTERVAL 10
 uint32_t poll_interval_no_work = DEFAULT_INTERVAL;
 
-#define DEFAULT_LOGFILE     "log.txt"
-#define DEFALT_CACHE_SIZE 1024 * 1024
+#define DEFAULT_DRAIN_BATCH_SIZE 0
 
-StaticLogBackend::StaticLogBackend():
+StaticLogBackend::StaticLogBackend(const char* log_file):
+    id_(0),
+    serial_(0),
     current_log_level_(LogLevels::kDEBUG),
+    control_mutex_(),
     buffer_mutex_(),
     cond_mutex_(),
     wake_up_cond_(),
     next_buffer_id_(0),
-    thread_buffers_(),
+    registries_(new StagingRegistry[getNumaNodes().size() * kMAX_BACKEND_WORKERS]),
+    num_registries_(getNumaNodes().size() * kMAX_BACKEND_WORKERS),
+    pool_(),
+    staging_buffer_size_(kSTAGING_BUFFER_SIZE),
+    elastic_limit_(0),
+    num_segments_chained_(0),
+    staging_memory_(kSTAGING_MALLOC),
+    watermark_percent_(50),
+    wakeup_seq_(0),
+    num_sleeping_(0),
+    num_watermark_wakeups_(0),
     is_stop_(false),
     is_exit_(false),
+    drain_batch_size_(DEFAULT_DRAIN_BATCH_SIZE),
+    ordering_(kTIME_ORDERED),
+    reorder_window_us_(0),
+    num_late_entries_(0),
+    workers_(),
+    numa_workers_(false),
+    num_shards_(1),
+    shard_output_(kMERGED_OUTPUT),
+    worker_cpus_(),
+    sched_policy_(SCHED_OTHER),
+    sched_priority_(0),
+    wait_strategy_(kWAIT_SLEEP),
+    max_backoff_us_(50),
     outfd_(-1),
-    log_buffer_(NULL),
-    bufflen_(0)
+    log_file_(log_file),
+    shard_outputs_(new std::atomic<OutputBuffer*>[num_registries_ - 1]),
+    num_shard_outputs_(num_registries_ - 1),
+    shard_fds_(),
+    clock_(),
+    output_mutex_(),
+    output_(),
+    flush_threshold_(OutputBuffer::kDEFAULT_FLUSH_THRESHOLD),
+    max_latency_us_(OutputBuffer::kDEFAULT_MAX_LATENCY_US),
+    output_sink_(kSYNC_WRITE),
+    queue_depth_(OutputBuffer::kDEFAULT_QUEUE_DEPTH),
+    writer_cpu_(-1),
+    output_format_(kTEXT),
+    active_format_(kTEXT),
+    timestamp_format_(kLOCAL_NANOSECONDS),
+    layout_(),
+    layout_version_(0),
+    pid_(getpid()),
+    retire_mutex_(),
+    retired_stats_(),
+    retire_version_(0)
 {
-    const char * logfile = DEFAULT_LOGFILE;
-    outfd_ = open(logfile, O_RDWR|O_CREAT, 0666);
-    if (outfd_ < 0) {
-        fprintf(stderr, "Failed to open log file\n");
+    std::unique_lock<std::mutex> lock(ids_mutex_);
+    while (id_ < kMAX_LOGGERS && ids_used_[id_])
+        id_++;
+    if (id_ == kMAX_LOGGERS) {
+        fprintf(stderr, "Failed to create a logger, %u of them exist already\n", kMAX_LOGGERS);
         exit(-1);
     }
+    ids_used_[id_] = true;
+    serial_ = ++last_serial_;
+    lock.unlock();
 
-    log_buffer_ = (char*)malloc(DEFALT_CACHE_SIZE);
-    if (log_buffer_ == NULL) {
-        fprintf(stderr, "Failed to create log buffer\n");
+    outfd_ = open(log_file, O_RDWR|O_CREAT, 0666);
+    if (outfd_ < 0) {
+        fprintf(stderr, "Failed to open log file %s\n", log_file);
         exit(-1);
     }
-    bufflen_ = DEFALT_CACHE_SIZE;
 
-    fdflush_ = std::thread(&StaticLogBackend::ioPoll, this);
+    for (auto& policy : overflow_policies_)
+        policy.store(kBLOCK, std::memory_order_relaxed);
+    for (size_t i = 0; i < num_shard_outputs_; ++i)
+        shard_outputs_[i].store(nullptr, std::memory_order_relaxed);
+
+    startWorkers();
 }
 
 StaticLogBackend::~StaticLogBackend()
 {
-    is_stop_ = true;
-    if(fdflush_.joinable())
-        fdflush_.join();
+    // The default logger goes away at exit and waits for the threads,
+    // the others only write out what was logged to them
+    stopWorkers(this != &logger_);
+    for (size_t i = 0; i < num_registries_; ++i) {
+        registries_[i].forEachSlot([](std::atomic<StagingBuffer*>& slot) {
+            StagingBuffer* segment = slot.load();
+            while (segment != nullptr) {
+                // The thread still holds the last segment
+                StagingBuffer* next = segment->next_.load();
+                if (next != nullptr || (segment->release_state_.fetch_or(StagingBuffer::kLOGGER_RELEASED)
+                                        & StagingBuffer::kTHREAD_RELEASED))
+                    delete segment;
+                segment = next;
+            }
+        });
+    }
     if (outfd_ != -1)
         close(outfd_);
-    if (log_buffer_)
-        free(log_buffer_);
-    bufflen_ = 0;
-}
+    for (size_t i = 0; i < num_shard_outputs_; ++i)
+        delete shard_outputs_[i].load();
 
-/** Convert the int type into a two-bit string, like int(2) -> "02"
-* \param ts
-*       Time which can be month, day, hour, min or second
-* \param raw
-*       buffer to store the string
-*/
-static void
-convertInt2Str(int ts, char*& raw) {
-    if (ts < 10) {
-        *raw = '0';
-        raw++;
-        *raw = std::to_string(ts).c_str()[0];
-        raw++;
-    } else {
-        memcpy(raw, std::to_string(ts).c_str(), 2);
-        raw+=2;
-    }
+    std::unique_lock<std::mutex> lock(ids_mutex_);
+    ids_used_[id_] = false;
 }
 
-#define TIEMSTAMP_PREFIX_LEN 31
-// [xxxx-xx-xx-hh:mm:ss.xxxxxxxxx]
-int
-generateTimePrefix(uint64_t timestamp, char* raw_data) {
-    // char* origin = raw_data;
-    int prefix_len{0};
-    const int nano_bits = 9;
-    static_assert(TIEMSTAMP_PREFIX_LEN < DEFALT_CACHE_SIZE, "default buffer size is smaller than time prefix len");
-    *raw_data = '[';    prefix_len += 1;
-    raw_data++;
-    uint64_t nano = timestamp % 1000000000;
-    timestamp = timestamp / 1000000000;
-    struct tm* tm_now = localtime((time_t*)&timestamp);
-    memcpy(raw_data, std::to_string(tm_now->tm_year + 1900).c_str(), 4);
-    raw_data += 4; prefix_len += 4;
-    *raw_data++ = '-'; prefix_len += 1;
-    convertInt2Str(tm_now->tm_mon + 1, raw_data);   prefix_len += 2;
-    *raw_data++ = '-'; prefix_len += 1;
-    convertInt2Str(tm_now->tm_mday, raw_data);  prefix_len += 2;
-    *raw_data++ = '-';  prefix_len += 1;
-    convertInt2Str(tm_now->tm_hour, raw_data);  prefix_len += 2;
-    *raw_data++ = ':';  prefix_len += 1;
-    convertInt2Str(tm_now->tm_min, raw_data);   prefix_len += 2;
-    *raw_data++ = ':';  prefix_len += 1;
-    convertInt2Str(tm_now->tm_sec, raw_data);   prefix_len += 2;
-    *raw_data++ = '.';  prefix_len += 1;
-    int nanolen = strlen(std::to_string(nano).c_str());
-    memcpy(raw_data + nano_bits - nanolen , std::to_string(nano).c_str(), nanolen);
-    if (nanolen < nano_bits) {
-        int bits = nano_bits - nanolen;
-        for(int i = 0; i < bits; ++i)
-            *raw_data++ = '0';
-        raw_data += nanolen;
-    } else {
-        raw_data += nano_bits;
-    }
-    prefix_len += nano_bits;
-    *raw_data = ']';    prefix_len += 1;
-    assert(prefix_len == TIEMSTAMP_PREFIX_LEN);
-    return prefix_len;
+void
+StaticLogBackend::releaseThreadBuffer(StagingBuffer* buffer)
+{
+    // A worker may delete the buffer as soon as the thread is released,
+    // which has to be the last access unless the logger is gone already
+    if (buffer->release_state_.fetch_or(StagingBuffer::kTHREAD_RELEASED, std::memory_order_acq_rel)
+            & StagingBuffer::kLOGGER_RELEASED)
+        delete buffer;
 }
 
-/**
- * 63 significant initial characters in an internal identifier or a macro name
- * https://en.cppreference.com/w/c/language/identifier
- */
-#define MAX_FUNC_NAME 63
-#define MAX_LINE    128
-/**
-* Generate log call information, including information level, function name, 
-* and call line number. The format generated is like 
-* [LEVEL][FUNCTION][LINE]
-* \param static_info
-*   Raw binary infomation which generated by the front logger   
-* \param raw
-*   Buffer to store the call information
-* \return 
-*   Length of call information
-*/
-static int
-generateCallInfoPrefix(const StaticInfo* static_info, char* raw)
+size_t
+StaticLogBackend::registryIndex(int node, uint32_t buffer_id)
 {
-    constexpr int max_call_info_len = 1 + 5 + 2 + MAX_FUNC_NAME + 2 + MAX_LINE + 1; // [LEVEL][FUNC_NAME][LINE]
-    static_assert(DEFALT_CACHE_SIZE - TIEMSTAMP_PREFIX_LEN > max_call_info_len, "log buffer is too small to store func infomation\n");
-    int prefix_len = 0;
-    *raw++ = '[';
-    prefix_len++;
-    auto level_len = strlen(log_level_str[(uint32_t)static_info->log_level]);
-    memcpy(raw, log_level_str[(uint32_t)static_info->log_level], level_len);
-    raw += level_len;
-    prefix_len += level_len;
-    *raw++ = ']';
-    prefix_len++;
-    *raw++ = '[';
-    prefix_len++;
-    auto fn_len = strlen(static_info->function_name);
-    memcpy(raw, static_info->function_name, fn_len);
-    raw += fn_len;
-    prefix_len += strlen(static_info->function_name);
-    *raw++ = ']';
-    prefix_len++;
-    *raw++ = '[';
-    prefix_len++;
-    auto line_len = strlen(std::to_string(static_info->line).c_str());
-    memcpy(raw, std::to_string(static_info->line).c_str(), line_len);
-    prefix_len += line_len;
-    raw += line_len;
-    *raw++ = ']';
-    prefix_len++;
-    return prefix_len;
+    size_t shard = buffer_id % num_shards_.load(std::memory_order_relaxed);
+    const std::vector<NumaNode>& nodes = getNumaNodes();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].id == node)
+            return i * kMAX_BACKEND_WORKERS + shard;
+    }
+    return shard;
 }
 
-static int
-resize_log_buffer(char*&  log_buffer, size_t& old_size, size_t new_size)
+void
+StaticLogBackend::writeFileHeader(int fd)
 {
-    char* buffer = (char*)malloc(new_size);
-    if (buffer == NULL) {
-        fprintf(stderr, "Failed to resize log buffer, wanted to alloc %lu\n", new_size);
-        return -1;
-    }
-    memcpy(buffer, log_buffer, old_size);
-    free(log_buffer);
-    log_buffer = buffer;
-    old_size = new_size;
-    return 0;
+    // The workers restarted on the same file continue it
+    if (lseek(fd, 0, SEEK_CUR) != 0)
+        return;
+    // The records of a file reused for a binary log would be followed by
+    // the tail of the previous content, which is not a record
+    if (ftruncate(fd, 0) != 0)
+        fprintf(stderr, "Failed to truncate the binary log\n");
+    BinaryFileHeader header{};
+    memcpy(header.magic, kBINARY_LOG_MAGIC, sizeof(header.magic));
+    header.version = kBINARY_LOG_VERSION;
+    header.pid = pid_;
+    if (write(fd, &header, sizeof(header)) != sizeof(header))
+        fprintf(stderr, "Failed to write the binary log header\n");
 }
 
-#define CHECK_LOG_BUFFER_REALLOC() do { \
-    if (fmt_len >= reserved) {   \
-        int ret = resize_log_buffer(log_buffer, log_buffer_len, (fmt_len << 1) + log_buffer_len - reserved);   \
-        if (ret < 0) return -1; \
-        reserved = log_buffer_len - start_pos;  \
-        goto retry; \
-    }   \
-} while(0)
-
-
-/**
-* Encode the non-string parameters of the binary log into strings, 
-*
-* Only support 8 16 32 64-bit parameters, and convert them into corresponding 
-* types according to the format characters during encoding and convert 
-* them to the corresponding strings through the c original format
-* 
-* \param log_buffer
-*   Reference to pointer used to store logs.
-* \param log_buffer_len
-*   Reference to length of the log buffer
-* \param reserved
-*   Reference to  reserved space to store message
-* \param start_pos
-*   The position which next to write
-* \param fmt
-* \param param
-*   Binary parameter infomation which generated by front logger
-* \param param_size
-*   Size of the param
-*/
-#pragma GCC diagnostic ignored "-Wformat"
-static int
-decodeNonStringFmt(
-    char*& log_buffer, 
-    size_t& log_buffer_len,
-    size_t& reserved,
-    size_t start_pos,
-    char * fmt, 
-    const char* param, 
-    size_t param_size)
+void
+StaticLogBackend::startWorkers()
 {
-    size_t fmt_len = 0;
-    char terminal_flag = fmt[strlen(fmt) - 1];
-retry:
-    switch (param_size) {
-    case sizeof(char):
-        {
-            const char* param8 = param;
-            if (terminal_flag == 'c') {
-                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(char*)param8);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else if (terminal_flag == 'd' || terminal_flag == 'i') {
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(int8_t*)param8);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else if (terminal_flag == 'u' || terminal_flag == 'o' || terminal_flag == 'x' || terminal_flag == 'X') {
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(uint8_t*)param8);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else 
-                fprintf(stderr, "Failed to parse fmt with a one bytes long param\n");
-            break;
-        }
-    case sizeof(uint16_t):
-        {
-            const uint16_t* param16 = (uint16_t*)param;
-            if (terminal_flag == 'd' || terminal_flag == 'i') {
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(int16_t*)param16);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else if (terminal_flag == 'u' || terminal_flag == 'o' || terminal_flag == 'x' || terminal_flag == 'X') {
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(uint16_t*)param16);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else 
-                fprintf(stderr, "Failed to parse fmt with a two bytes long param\n");
-            break;
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    is_exit_ = false;
+    is_stop_ = false;
+    // The format is fixed for the whole file, written before any worker
+    // appends to it
+    active_format_ = output_format_;
+    if (active_format_ == kBINARY && outfd_ != -1)
+        writeFileHeader(outfd_);
+    output_.setFd(outfd_);
+    lock.unlock();
+
+    // Shard s drains the registries of the shards that are s modulo
+    // num_shards, so that the buffers registered while there were more
+    // shards still have a single worker
+    const std::vector<NumaNode>& nodes = getNumaNodes();
+    size_t num_shards = num_shards_.load();
+    bool per_node = numa_workers_ && nodes.size() > 1;
+    size_t num_groups = per_node ? nodes.size() : 1;
+    size_t num_workers = num_groups * num_shards;
+    for (size_t index = 0; index < num_workers; ++index) {
+        size_t group = index / num_shards;
+        size_t shard = index % num_shards;
+        std::vector<size_t> registries;
+        for (size_t i = 0; i < num_registries_; ++i) {
+            size_t node_index = i / kMAX_BACKEND_WORKERS;
+            if ((!per_node || node_index == group) && (i % kMAX_BACKEND_WORKERS) % num_shards == shard)
+                registries.push_back(i);
         }
-    case sizeof(uint32_t):
-        {
-            const uint32_t* param32 = (uint32_t*)param;
-            if (terminal_flag == 'd' || terminal_flag == 'i') {
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(int32_t*)param32);
-                CHECK_LOG_BUFFER_REALLOC();
+        int node = per_node ? nodes[group].id : (numa_workers_ ? nodes[0].id : -1);
+
+        OutputBuffer* output = &output_;
+        bool batched = num_workers > 1 && shard_output_ == kMERGED_OUTPUT;
+        if (shard_output_ == kSHARD_FILES && index > 0) {
+            std::string path = log_file_ + "." + std::to_string(index);
+            int fd = open(path.c_str(), O_RDWR|O_CREAT, 0666);
+            if (fd == -1)
+                fprintf(stderr, "Failed to open file %s\n", path.c_str());
+            else if (active_format_ == kBINARY)
+                writeFileHeader(fd);
+            shard_fds_.push_back(fd);
+            output = shard_outputs_[index - 1].load();
+            if (output == nullptr) {
+                output = new OutputBuffer();
+                shard_outputs_[index - 1].store(output, std::memory_order_release);
             }
-            else if (terminal_flag == 'u' || terminal_flag == 'o' || terminal_flag == 'x' || terminal_flag == 'X') {
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(uint32_t*)param32);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else if (terminal_flag == 'f' || terminal_flag == 'F' || terminal_flag == 'e' ||terminal_flag == 'e' || 
-                terminal_flag == 'E' || terminal_flag == 'g' || terminal_flag == 'G'|| terminal_flag == 'a' ||terminal_flag == 'A') {
-                static_assert(sizeof(float) == sizeof(uint32_t));
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(float*)param32);
-                CHECK_LOG_BUFFER_REALLOC();
-            }            
-            else 
-                fprintf(stderr, "Failed to parse fmt with a two bytes long param\n");
-            break;
-        }
-    case sizeof(uint64_t):
-        {
-            const uint64_t* param64 = (uint64_t*)param;
-            if (terminal_flag == 'd' || terminal_flag == 'i') {
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(int64_t*)param64);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else if (terminal_flag == 'u' || terminal_flag == 'o' || terminal_flag == 'x' || terminal_flag == 'X') {
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(uint64_t*)param64);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else if (terminal_flag == 'f' || terminal_flag == 'F' || terminal_flag == 'e' ||terminal_flag == 'e' || 
-                terminal_flag == 'E' || terminal_flag == 'g' || terminal_flag == 'G'|| terminal_flag == 'a' ||terminal_flag == 'A') {
-                static_assert(sizeof(double) == sizeof(uint64_t));
-                fmt_len = snprintf(log_buffer + start_pos, log_buffer_len, fmt, *(double*)param64);
-                CHECK_LOG_BUFFER_REALLOC();
-            }
-            else
-                fprintf(stderr, "Failed to parse fmt with a two bytes long param\n");
-            break;
+            output->setFd(fd);
         }
-    default:
-        fprintf(stderr, "Failed to decode fmt param, got size %lu\n", param_size);
-        break;
+        workers_.emplace_back(new BackendWorker(*this, index, std::move(registries), node,
+                                                *output, batched));
     }
-    return fmt_len;
+    for (auto& worker : workers_)
+        worker->start();
 }
-#pragma GCC diagnostic pop
 
-#define DEFAULT_PARAM_CACHE_SIZE 1024
-static int
-decodeStringFmt(char*& log_buffer, size_t& bufferlen, size_t& reserved, size_t start_pos, const char* param, size_t param_size, const char* fmt)
+void
+StaticLogBackend::stopWorkers(bool exiting)
 {
-    assert((char*)log_buffer - (char*)start_pos == bufferlen - reserved);
-    char string_param_cache[DEFAULT_PARAM_CACHE_SIZE];
-    bool dynamic_alloc = false;
-    char* param_buffer = string_param_cache;
-    int ret = 0;
-    if (param_size >= DEFAULT_PARAM_CACHE_SIZE) {
-        param_buffer = (char*)malloc(param_size + 1); // strlen(str) + '\0'
-        if (param_buffer == NULL) {
-            fprintf(stderr, "Failed to alloc param buffer\n");
-            return -1;
-        }
-        dynamic_alloc = true;
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    is_stop_ = true;
+    is_exit_ = exiting;
+    wake_up_cond_.notify_all();
+    lock.unlock();
+    for (auto& worker : workers_)
+        worker->join();
+    workers_.clear();
+    output_.setFd(-1);
+    for (size_t i = 0; i < shard_fds_.size(); ++i) {
+        shard_outputs_[i].load()->setFd(-1);
+        if (shard_fds_[i] != -1)
+            close(shard_fds_[i]);
     }
-    memcpy(param_buffer, param, param_size);
-    param_buffer[param_size] = '\0';
-    size_t needed_fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, param_buffer);
-    if (needed_fmt_len > reserved) {
-        size_t new_log_buflen = needed_fmt_len + 1 + bufferlen - reserved;
-        char* tmp = (char*)malloc(new_log_buflen);
-        if (tmp == NULL) {
-            fprintf(stderr, "Failed to realloc log buffer, needed alloc size %lu\n", needed_fmt_len);
-            ret = -1;
-            goto out;
+    shard_fds_.clear();
+}
+
+char *
+StaticLogBackend::reserveOverflow(size_t nbytes, LogLevels::LogLevel level)
+{
+    StagingBuffer* buffer = thread_buffers_[id_].buffer;
+    // An elastic buffer grows up to its limit before the policy applies
+    if (buffer->elastic_limit_ != 0) {
+        char* pos = chainStagingBuffer(nbytes);
+        if (pos != nullptr)
+            return pos;
+        // Still too large for the new segment, if one was chained
+        buffer = thread_buffers_[id_].buffer;
+    }
+
+    int8_t thread_policy = buffer->chain_->overflow_policy;
+    OverflowPolicy policy = thread_policy >= 0 ? static_cast<OverflowPolicy>(thread_policy)
+                                               : overflow_policies_[level].load(std::memory_order_relaxed);
+    switch (policy) {
+    case kOVERWRITE_OLDEST:
+        while (buffer->discardOldestEntry()) {
+            char* pos = buffer->reserveSpaceInternal(nbytes, false);
+            if (pos != nullptr)
+                return pos;
         }
-        reserved = new_log_buflen - bufferlen + reserved;
-        bufferlen = new_log_buflen;
-        memcpy(tmp, log_buffer, start_pos);
-        snprintf(tmp + start_pos, needed_fmt_len + 1, fmt, param_buffer);
-        free(log_buffer);
-        log_buffer = tmp;
+        // The backend is reading the buffer, drop the message instead
+        break;
+    case kDROP_NEWEST:
+        break;
+    default:
+        return buffer->reserveSpaceInternal(nbytes, true);
     }
-    ret = needed_fmt_len;
-out:
-    if (dynamic_alloc)
-        free(param_buffer);
-    return ret;
+    buffer->num_allocations_--;
+    buffer->chain_->num_dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
 }
 
-/**
-* The binary log content of the front-end is formatted into a readable format and written to disk
-*
-* \param fmt
-*   Pointer to paramter formatter like %s %d
-* \param num_params
-*   The number of parameters
-* \param param_type
-*   Pointer to the type of paramter
-* \param param_size_list
-*   Pointer to size of the paramter
-* \param param_list
-*   Pointer to binary infomation of parameter
-* \param log_buffer
-*   Reference to pointer used to store readable information
-* \param buflen
-*   Reference to the length of buffer
-* \param start_pos
-*   Next position to write in
-*/
-static int
-process_fmt(
-        const char* fmt, 
-        const int num_params, 
-        const ParamType* param_types,
-        size_t* param_size_list,
-        const char* param_list, 
-        char*& log_buffer, size_t& buflen, size_t start_pos)
+char *
+StaticLogBackend::chainStagingBuffer(size_t nbytes)
 {
-    char* log_pos = log_buffer + start_pos;
-    size_t fmt_list_len = strlen(fmt);
-    size_t reserved = buflen - start_pos;
-    size_t pos = 0;
-    int param_idx = 0;
-    bool success = true;
-    while (pos < fmt_list_len) {
-        if (fmt[pos] != '%') {
-            *log_pos++ = fmt[pos++];
-            reserved--;
-            continue;
-        } else {
-            ++pos;
-            int fmt_single_len = 1;
-            if (fmt[pos] == '%') {
-                *log_pos++ = '%';
-                reserved--;
-                ++pos;
-                continue;
-            } else {
-                int fmt_start_pos = pos - 1;
-                while (!isTerminal(fmt[pos])) {
-                    fmt_single_len++;
-                    pos++;
-                }
-                fmt_single_len++;
-                pos++;
-                char* fmt_single;
-                char static_fmt_cache[100];
-                bool dynamic_fmt = false;
-                if (fmt_single_len < 100) {
-                    memset(static_fmt_cache, 0, 100);
-                    fmt_single = static_fmt_cache;
-                } else {
-                    fmt_single = (char*)malloc(fmt_single_len);
-                    dynamic_fmt = true;
-                }
-                memcpy(fmt_single, fmt + fmt_start_pos, fmt_single_len);
-                int log_fmt_len = 0;
-
-                if (param_idx < num_params) {
-                    if (param_types[param_idx] > ParamType::kNON_STRING) {
-                        uint32_t string_size = *(uint32_t*)param_list;
-                        param_list += sizeof(uint32_t);
-                        log_fmt_len = decodeStringFmt(log_buffer, buflen, reserved, log_pos - log_buffer, param_list, string_size, fmt_single);
-                        param_list = param_list + string_size;
-                    }
-                    else {
-                        log_fmt_len = decodeNonStringFmt(log_buffer, buflen, reserved, log_pos - log_buffer, fmt_single, param_list, param_size_list[param_idx]);
-                        if (log_fmt_len == -1)  {
-                            success = false;
-                            break;
-                        }
-                        param_list += param_size_list[param_idx];
-                    }
-                    log_pos += log_fmt_len;
-                    reserved -= log_fmt_len;
-                    param_idx++;
-                } else {
-                    fprintf(stderr, "Failed to fmt log\n");
-                    success = false;
-                    if (dynamic_fmt) 
-                        free(fmt_single);
-                    break;
+    StagingBuffer* full = thread_buffers_[id_].buffer;
+    size_t capacity = full->capacity_;
+    if (full->chain_->bytes.load() + capacity > full->elastic_limit_)
+        return nullptr;
+    // Segments are allocated like the first one of the thread
+    StagingMemory memory = pool_.acquire(capacity, full->memory_flags_, full->node_);
+    if (memory.data == nullptr)
+        return nullptr;
+
+    StagingBuffer* next = new StagingBuffer(full->id_, memory, full->elastic_limit_, full->chain_);
+    next->setWatermark(watermark_percent_.load());
+    // Timestamps keep being encoded relative to the last entry of the full
+    // segment, which is also the last one the consumer will read from it
+    next->last_producer_tsc_ = full->last_producer_tsc_;
+    next->last_consumer_tsc_ = full->last_producer_tsc_;
+    // The message is counted by the segment it ends up in
+    full->num_allocations_--;
+    // Publishes the final producer_pos_ of the full segment along with it
+    full->next_.store(next, std::memory_order_release);
+    thread_buffers_[id_].buffer = next;
+    num_segments_chained_.fetch_add(1, std::memory_order_relaxed);
+    return next->reserveProducerSpace(nbytes);
+}
+
+void
+StaticLogBackend::wakeUpWorkers()
+{
+    wakeup_seq_.fetch_add(1);
+    if (num_sleeping_.load() == 0)
+        return;
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    wake_up_cond_.notify_all();
+    num_watermark_wakeups_.fetch_add(1, std::memory_order_relaxed);
+}
+
+StagingStats
+StaticLogBackend::getStagingStats()
+{
+    StagingStats stats;
+    for (size_t i = 0; i < num_registries_; ++i)
+        registries_[i].beginRead();
+    uint64_t version;
+    do {
+        while ((version = retire_version_.load()) & 1)
+            std::this_thread::yield();
+        stats = retired_stats_;
+        for (size_t i = 0; i < num_registries_; ++i) {
+            registries_[i].forEachSlot([&](std::atomic<StagingBuffer*>& slot) {
+                StagingBuffer* thread_buffer = slot.load();
+                if (thread_buffer == nullptr)
+                    return;
+                for (auto segment = thread_buffer; segment != nullptr; segment = segment->next_.load()) {
+                    stats.num_messages += segment->num_allocations_;
+                    stats.bytes_logged += segment->num_bytes_logged_;
+                    stats.num_times_producer_blocked += segment->num_times_producer_blocked_;
+                    stats.cycles_producer_blocked += segment->cycles_producer_blocked_;
                 }
-                if (dynamic_fmt) 
-                    free(fmt_single);
-            }
+                stats.num_dropped += thread_buffer->chain_->num_dropped.load(std::memory_order_relaxed);
+            });
         }
-    }
-    return success? buflen - reserved: -1;
+    } while (retire_version_.load() != version);
+    for (size_t i = 0; i < num_registries_; ++i)
+        registries_[i].endRead();
+    stats.num_segments_chained = num_segments_chained_.load(std::memory_order_relaxed);
+    stats.num_watermark_wakeups = num_watermark_wakeups_.load(std::memory_order_relaxed);
+    stats.num_pool_hits = pool_.getHits();
+    stats.num_pool_misses = pool_.getMisses();
+    stats.pool_bytes = pool_.getBytes();
+    return stats;
 }
 
-void 
-StaticLogBackend::processLogBuffer(StagingBuffer* stagingbuffer)
+StagingPool::~StagingPool()
 {
-    uint64_t bytes_available = 0;
-    char* raw_data = stagingbuffer->peek(&bytes_available);
-    if (bytes_available > 0) {
-        LogEntry *log_entry = (LogEntry *)raw_data;
-        log_entry->timestamp = get_nanotime();
-        auto prefix_ts_len = generateTimePrefix(log_entry->timestamp, log_buffer_);
-        // log_content_cache[prefix_len] = '\0';
-        auto prefix_callinfo_len = generateCallInfoPrefix(log_entry->static_info, log_buffer_ + prefix_ts_len);
-        const char* fmt = log_entry->static_info->format;
-        int len = process_fmt(fmt, 
-                    log_entry->static_info->num_params, 
-                    log_entry->static_info->param_types,
-                    (size_t*)log_entry->param_size,
-                    (char*)log_entry + sizeof(LogEntry),
-                    log_buffer_, bufflen_, prefix_ts_len + prefix_callinfo_len);
-        char* log = log_buffer_ + prefix_ts_len + prefix_callinfo_len + len;
-        *log = '\n';
-        if (len != -1 && outfd_ != -1) {
-            write(StaticLogBackend::logger_.outfd_, log_buffer_, prefix_ts_len + prefix_callinfo_len + len + 1);
-            stagingbuffer->consume(log_entry->entry_size);
+    for (auto& storage : storages_)
+        freeStagingMemory(storage);
+}
+
+StagingMemory
+StagingPool::acquire(size_t capacity, uint32_t flags, int node)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Most recently retired first, its pages are the likeliest to be
+    // still cached
+    for (size_t i = storages_.size(); i-- > 0;) {
+        const StagingMemory& storage = storages_[i];
+        if (storage.capacity == capacity && storage.flags == flags && storage.node == node) {
+            StagingMemory memory = storage;
+            storages_.erase(storages_.begin() + i);
+            num_bytes_ -= capacity;
+            num_hits_.fetch_add(1, std::memory_order_relaxed);
+            return memory;
         }
     }
+    lock.unlock();
+    num_misses_.fetch_add(1, std::memory_order_relaxed);
+    return allocateStagingMemory(capacity, flags, node);
 }
 
-static int
-threadBindCore(int i)
-{  
-    cpu_set_t mask;  
-    CPU_ZERO(&mask);  
-  
-    CPU_SET(i,&mask);  
-  
-    if(-1 == pthread_setaffinity_np(pthread_self() ,sizeof(mask),&mask))  
-    {  
-        fprintf(stderr, "pthread_setaffinity_np erro\n");  
-        return -1;  
-    }  
-    return 0;  
-} 
-
-void 
-StaticLogBackend::ioPoll()
+bool
+StagingPool::release(const StagingMemory& memory)
 {
-    threadBindCore(1);
-
-    // walkLogBuffer();
-    std::unique_lock<std::mutex> guard(buffer_mutex_);
-    while(!is_stop_ || !thread_buffers_.empty()) {
-        if (is_exit_) return;
-        guard.unlock();
-        std::pair<uint64_t, static_log::details::StagingBuffer *> earliest_thead_buffer{UINT64_MAX, nullptr};
-        guard.lock();
-        for(size_t i = 0; i < thread_buffers_.size(); ++i) {
-            auto thread_buffer = thread_buffers_[i];
-            if (!thread_buffer->checkCanDelete()) {
-                uint64_t bytes_available = 0;
-                char* raw_data = thread_buffer->peek(&bytes_available);
-                if (bytes_available > 0) {
-                    LogEntry *log_entry = (LogEntry *)raw_data;
-                    if (log_entry->timestamp < earliest_thead_buffer.first) {
-                        earliest_thead_buffer.first = log_entry->timestamp;
-                        earliest_thead_buffer.second = thread_buffer;
-                    }
-                }
-            }
-            else {
-                delete thread_buffer;
-                thread_buffers_.erase(thread_buffers_.begin() + i);
-                if (thread_buffers_.empty())
-                    break;
-                --i;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (num_bytes_ + memory.capacity > max_bytes_)
+        return false;
+    storages_.push_back(memory);
+    num_bytes_ += memory.capacity;
+    return true;
+}
+
+void
+StagingPool::setMaxBytes(size_t max_bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    // The oldest go first
+    while (num_bytes_ > max_bytes_) {
+        StagingMemory& storage = storages_.front();
+        num_bytes_ -= storage.capacity;
+        freeStagingMemory(storage);
+        storages_.erase(storages_.begin());
+    }
+}
+
+size_t
+StagingPool::getBytes()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return num_bytes_;
+}
+
+StagingRegistry::~StagingRegistry()
+{
+    Block* block = head_.next.load();
+    while (block != nullptr) {
+        Block* next = block->next.load();
+        delete block;
+        block = next;
+    }
+}
+
+void
+StagingRegistry::add(StagingBuffer* buffer)
+{
+    // Counted first so that the worker does not exit with it unregistered
+    num_buffers_.fetch_add(1);
+    Block* block = &head_;
+    Block* spare = nullptr;
+    for (;;) {
+        for (auto& slot : block->slots) {
+            StagingBuffer* expected = nullptr;
+            if (slot.load(std::memory_order_relaxed) == nullptr
+                    && slot.compare_exchange_strong(expected, buffer, std::memory_order_release)) {
+                delete spare;
+                return;
             }
         }
-        if (earliest_thead_buffer.first != UINT64_MAX) {
-            processLogBuffer(earliest_thead_buffer.second);
-        } else {
-            wake_up_cond_.wait_for(guard, std::chrono::microseconds(io_internal));
+
+        Block* next = block->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            // All full, append a block holding the buffer
+            if (spare == nullptr)
+                spare = new Block();
+            spare->slots[0].store(buffer, std::memory_order_relaxed);
+            if (block->next.compare_exchange_strong(next, spare, std::memory_order_release,
+                                                    std::memory_order_acquire))
+                return;
+            // Another thread appended one first, look for a slot in it
+            spare->slots[0].store(nullptr, std::memory_order_relaxed);
         }
+        block = next;
     }
 }
 
 char *
 StagingBuffer::reserveSpaceInternal(size_t nbytes, bool blocking) 
 {
-    const char *end_of_buffer = storage_ + kSTAGING_BUFFER_SIZE;
+    const char *end_of_buffer = storage_ + capacity_;
+    uint64_t block_start_tsc = 0;
 
     // There's a subtle point here, all the checks for remaining
     // space are strictly < or >, not <= or => because if we allow
@@ -607,14 +519,72 @@ StagingBuffer::reserveSpaceInternal(size_t nbytes, bool blocking)
         min_free_space_ = end_of_buffer - storage_;
 #endif
 
-        // Needed to prevent infinite loops in tests
-        if (!blocking && min_free_space_ <= nbytes)
-            return nullptr;
+        if (min_free_space_ <= nbytes) {
+            if (!blocking)
+                return nullptr;
+            if (block_start_tsc == 0) {
+                block_start_tsc = __builtin_ia32_rdtsc();
+                num_times_producer_blocked_++;
+            }
+        }
     }
 
+    if (block_start_tsc != 0)
+        cycles_producer_blocked_ += __builtin_ia32_rdtsc() - block_start_tsc;
+    // The consumer moved since the last crossing, watch for the next one
+    wakeup_free_space_ = watermark_free_space_;
     return producer_pos_;
 }
 
+bool
+StagingBuffer::crossedWatermark()
+{
+    char *cached_consumer_pos = consumer_pos_;
+    uint64_t fill;
+    if (cached_consumer_pos <= producer_pos_)
+        fill = producer_pos_ - cached_consumer_pos;
+    else
+        fill = (end_of_recorded_space_ - cached_consumer_pos) + (producer_pos_ - storage_);
+
+    uint64_t watermark_fill = capacity_ - watermark_free_space_;
+    if (fill < watermark_fill) {
+        // Check again once the producer could have filled up to it
+        uint64_t headroom = watermark_fill - fill;
+        wakeup_free_space_ = min_free_space_ > headroom ? min_free_space_ - headroom : 0;
+        return false;
+    }
+    wakeup_free_space_ = 0;
+    return true;
+}
+
+bool
+StagingBuffer::discardOldestEntry()
+{
+    uint8_t expected = kUNCLAIMED;
+    if (!owner_.compare_exchange_strong(expected, kPRODUCER, std::memory_order_acquire))
+        return false;
+
+    bool discarded = false;
+    char* pos = consumer_pos_;
+    // Roll over like peek()
+    if (producer_pos_ < pos && pos == end_of_recorded_space_) {
+        pos = storage_;
+        discarded = true;
+    }
+    if (pos != producer_pos_) {
+        const LogEntry* log_entry = (const LogEntry*)pos;
+        uint64_t delta;
+        decodeVarint(pos + sizeof(LogEntry), &delta);
+        last_consumer_tsc_ += static_cast<uint64_t>(zigzagDecode(delta));
+        pos += log_entry->entry_size;
+        chain_->num_dropped.fetch_add(1, std::memory_order_relaxed);
+        discarded = true;
+    }
+    consumer_pos_ = pos;
+    owner_.store(kUNCLAIMED, std::memory_order_release);
+    return discarded;
+}
+
 char *
 StagingBuffer::peek(uint64_t *bytes_available) {
     // Save a consistent copy of producerPos
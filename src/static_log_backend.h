@@ -10,14 +10,22 @@
 
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 #include <condition_variable>
 #include <thread>
 #include <iostream>
 #include <atomic>
+#include <algorithm>
 
 #include "static_log.h"
 #include "static_log_common.h"
+#include "static_log_clock.h"
+#include "static_log_sink.h"
+#include "static_log_timestamp.h"
+#include "static_log_layout.h"
+#include "static_log_memory.h"
+#include "static_log_numa.h"
 
 namespace static_log {
 namespace details{
@@ -25,6 +33,33 @@ namespace details{
 extern uint32_t poll_interval_no_work;
 
 class StagingBufferDestroyer;
+struct StaticInfo;
+struct LogEntry;
+
+/**
+ * Static information of a call site, registered at its first use
+ */
+struct Callsite {
+    const StaticInfo* static_info;
+    // Layout of its lines, bound by the backend worker when it first sees
+    // the call site and again when the pattern changes
+    CallsiteLayout layout;
+};
+
+/**
+ * State shared by the segments of the StagingBuffer of a thread
+ */
+struct StagingChain {
+    // Bytes taken by the segments still alive
+    std::atomic<size_t> bytes{0};
+    // Messages dropped or overwritten by the overflow policy, and how many
+    // of them the backend has reported, see reportDroppedMessages
+    std::atomic<uint64_t> num_dropped{0};
+    uint64_t num_dropped_reported = 0;
+    // Overflow policy of the thread, -1 for the one of the message level.
+    // Only used by the thread itself.
+    int8_t overflow_policy = -1;
+};
 
 /**
  * Implements a circular FIFO producer/consumer byte queue that is used
@@ -43,14 +78,15 @@ public:
      *
      * This mechanism is in place to allow the producer to initialize
      * the contents of the reservation before exposing it to the
-     * consumer. This function will block behind the consumer if
-     * there's not enough space.
+     * consumer.
      *
      * \param nbytes
      *      Number of bytes to allocate
      *
      * \return
-     *      Pointer to at least nbytes of contiguous space
+     *      Pointer to at least nbytes of contiguous space, nullptr if
+     *      there's not enough space, the caller then applies the overflow
+     *      policy, see StaticLogBackend::reserveOverflow
      */
     inline char *
     reserveProducerSpace(size_t nbytes) {
@@ -61,7 +97,7 @@ public:
             return producer_pos_;
 
         // Slow allocation
-        return reserveSpaceInternal(nbytes);
+        return reserveSpaceInternal(nbytes, false);
     }
 
     /**
@@ -70,15 +106,50 @@ public:
      *
      * \param nbytes
      *      Number of bytes to expose to the consumer
+     * \return
+     *      true if the buffer just crossed its fill watermark, the caller
+     *      then wakes up the backend
      */
-    inline void
+    inline bool
     finishReservation(size_t nbytes) {
         assert(nbytes < min_free_space_);
         assert(producer_pos_ + nbytes <
-                storage_ + kSTAGING_BUFFER_SIZE);
+                storage_ + capacity_);
 
         min_free_space_ -= nbytes;
         producer_pos_ += nbytes;
+        num_bytes_logged_ += nbytes;
+
+        if (min_free_space_ >= wakeup_free_space_)
+            return false;
+        return crossedWatermark();
+    }
+
+    /**
+    * Sets the fill level at which finishReservation reports a crossing
+    *
+    * \param percent
+    *      Percent of the capacity, 0 to never report one
+    */
+    void setWatermark(uint32_t percent) {
+        watermark_free_space_ = percent == 0 ? 0 : capacity_ - capacity_ * std::min(percent, 100u) / 100;
+        wakeup_free_space_ = watermark_free_space_;
+    }
+
+    /**
+    * Encodes the timestamp of a new entry relative to the previous one
+    * logged to this buffer, see LogEntry.
+    *
+    * \param pos
+    *      Where to write, with room for kMAX_VARINT_LEN bytes
+    * \return
+    *      Position after the encoded timestamp
+    */
+    inline char *
+    encodeTimestamp(char *pos, uint64_t tsc) {
+        pos = encodeVarint(pos, zigzagEncode(static_cast<int64_t>(tsc - last_producer_tsc_)));
+        last_producer_tsc_ = tsc;
+        return pos;
     }
 
     /**
@@ -108,6 +179,36 @@ public:
         consumer_pos_ += nbytes;
     }
 
+    /**
+     * Keeps the producer from discarding entries, see discardOldestEntry.
+     * The consumer holds the claim from peek() until the matching
+     * consume().
+     */
+    inline void
+    claim() {
+        uint8_t expected = kUNCLAIMED;
+        while (!owner_.compare_exchange_weak(expected, kCONSUMER, std::memory_order_acquire)) {
+            // The producer only holds it to skip one entry
+            expected = kUNCLAIMED;
+            std::this_thread::yield();
+        }
+    }
+
+    inline void
+    unclaim() {
+        owner_.store(kUNCLAIMED, std::memory_order_release);
+    }
+
+    /**
+     * Releases the space of the oldest entry to the producer without
+     * handing it to the consumer, for the kOVERWRITE_OLDEST policy. Only
+     * called by the producer.
+     *
+     * \return
+     *      false if the buffer is empty or the consumer is reading it
+     */
+    bool discardOldestEntry();
+
     /**
      * Returns true if it's safe for the compression thread to delete
      * the StagingBuffer and remove it from the global vector.
@@ -117,7 +218,10 @@ public:
      */
     bool
     checkCanDelete() {
-        return should_deallocate_ && consumer_pos_ == producer_pos_;
+        // The acquire pairs with the release of the thread, after its last
+        // entry
+        return (release_state_.load(std::memory_order_acquire) & kTHREAD_RELEASED)
+                && consumer_pos_ == producer_pos_;
     }
 
 
@@ -125,22 +229,67 @@ public:
         return id_;
     }
 
-    StagingBuffer(uint32_t bufferId)
-            : producer_pos_(storage_)
-            , end_of_recorded_space_(storage_
-                                    + kSTAGING_BUFFER_SIZE)
-            , min_free_space_(kSTAGING_BUFFER_SIZE)
+    size_t getCapacity() const {
+        return capacity_;
+    }
+
+    // Backing store, see allocateStagingMemory
+    StagingMemory getMemory() const {
+        return StagingMemory{storage_, capacity_, memory_flags_, node_};
+    }
+
+    /**
+    * \param bufferId
+    *      Id of the thread, shared by all the segments of an elastic buffer
+    * \param memory
+    *      Backing store allocated with allocateStagingMemory(), owned by
+    *      the StagingBuffer
+    * \param elastic_limit
+    *      0, or the total size the segments of the thread may take, see
+    *      StaticLogBackend::chainStagingBuffer
+    * \param chain
+    *      State shared by the segments of the thread, created by the first
+    *      one when null
+    */
+    StagingBuffer(uint32_t bufferId, const StagingMemory& memory,
+                  size_t elastic_limit = 0,
+                  std::shared_ptr<StagingChain> chain = nullptr)
+            : producer_pos_(memory.data)
+            , end_of_recorded_space_(memory.data + memory.capacity)
+            , min_free_space_(memory.capacity)
+            , wakeup_free_space_(0)
+            , watermark_free_space_(0)
+            , elastic_limit_(elastic_limit)
             , cycles_producer_blocked_(0)
             , num_times_producer_blocked_(0)
             , num_allocations_(0)
-            , consumer_pos_(storage_)
-            , should_deallocate_(false)
+            , num_bytes_logged_(0)
+            , last_producer_tsc_(0)
+            , consumer_pos_(memory.data)
+            , last_consumer_tsc_(0)
+            , owner_(kUNCLAIMED)
+            , release_state_(0)
             , id_(bufferId)
-            , storage_() {
+            , next_(nullptr)
+            , chain_(chain ? std::move(chain) : std::make_shared<StagingChain>())
+            , capacity_(memory.capacity)
+            , storage_(memory.data)
+            , memory_flags_(memory.flags)
+            , node_(memory.node) {
+        chain_->bytes.fetch_add(capacity_);
     }
 
     ~StagingBuffer() {
-        should_deallocate_ = true;
+        chain_->bytes.fetch_sub(capacity_);
+        freeStagingMemory(getMemory());
+    }
+
+    /**
+    * Hands the backing store over to the caller, the destructor then leaves
+    * it alone
+    */
+    void releaseStorage() {
+        storage_ = nullptr;
     }
 
     StagingBuffer(const StagingBuffer&)=delete;
@@ -161,9 +310,9 @@ private:
     *      Number of contiguous bytes to reserve.
     *
     * \param blocking
-    *      Test parameter that indicates that the function should
-    *      return with a nullptr rather than block when there's
-    *      not enough space.
+    *      false to return nullptr rather than block when there's not
+    *      enough space, the time spent blocked is accounted in
+    *      cycles_producer_blocked_
     *
     * \return
     *      A pointer into storage[] that can be written to by the producer for
@@ -171,6 +320,18 @@ private:
     */
     char *reserveSpaceInternal(size_t nbytes, bool blocking = true);
 
+    /**
+    * Slow path of finishReservation once min_free_space_, a stale lower
+    * bound, suggests the watermark is crossed. Looks at the consumer to
+    * get the actual fill, and re-arms for the bytes left before the
+    * watermark if the backend kept up.
+    *
+    * \return
+    *      true if the buffer is filled past the watermark, the wakeup is
+    *      then disarmed until reserveSpaceInternal re-arms it
+    */
+    bool crossedWatermark();
+
     // Position within storage[] where the producer may place new data
     char *producer_pos_;
 
@@ -182,6 +343,16 @@ private:
     // rolling over the producer_pos_ or stalling behind the consumer
     uint64_t min_free_space_;
 
+    // finishReservation checks the fill of the buffer once min_free_space_
+    // drops below wakeup_free_space_, which is 0 once a crossing is
+    // reported, see setWatermark and crossedWatermark
+    uint64_t wakeup_free_space_;
+    uint64_t watermark_free_space_;
+
+    // Total size the segments of an elastic buffer may take, 0 if the
+    // producer blocks when the buffer is full
+    size_t elastic_limit_;
+
     // Number of cycles producer was blocked while waiting for space to
     // free up in the StagingBuffer for an allocation.
     uint64_t cycles_producer_blocked_;
@@ -193,49 +364,568 @@ private:
     // Number of alloc()'s performed
     uint64_t num_allocations_;
 
+    // Number of bytes made visible to the consumer
+    uint64_t num_bytes_logged_;
+
+    // Timestamp of the last entry logged, the base of the next delta
+    uint64_t last_producer_tsc_;
+
     // An extra cache-line to separate the variables that are primarily
     // updated/read by the producer (above) from the ones by the
     // consumer(below)
     char cacheline_spacer_[2*BYTES_PER_CACHE_LINE];
 
     // Position within the storage buffer where the consumer will consume
-    // the next bytes from. This value is only updated by the consumer.
+    // the next bytes from. This value is only updated by the consumer, or
+    // by the producer when it holds the claim, see discardOldestEntry.
     char* volatile consumer_pos_;
 
-    // Indicates that the thread owning this StagingBuffer has been
-    // destructed (i.e. no more messages will be logged to it) and thus
-    // should be cleaned up once the buffer has been emptied by the
-    // compression thread.
-    bool should_deallocate_;
+    // Timestamp of the last entry processed by the consumer, mirrors
+    // last_producer_tsc_
+    uint64_t last_consumer_tsc_;
+
+    // Side allowed to move consumer_pos_, see claim()
+    enum : uint8_t { kUNCLAIMED = 0, kCONSUMER, kPRODUCER };
+    std::atomic<uint8_t> owner_;
+
+    // Set by the thread and by its logger as they let go of the buffer.
+    // Once the thread released it (i.e. no more messages will be logged to
+    // it), the backend deletes the buffer after emptying it, or the logger
+    // does on its destruction, see StaticLogBackend::releaseThreadBuffer
+    enum : uint8_t { kTHREAD_RELEASED = 1, kLOGGER_RELEASED = 2 };
+    std::atomic<uint8_t> release_state_;
 
     // Uniquely identifies this StagingBuffer for this execution. It's
     // similar to ThreadId, but is only assigned to threads that NANO_LOG).
     uint32_t id_;
 
+    // Segment the producer moved to when this one filled up in the elastic
+    // mode, this one receives no more entries once it is set
+    std::atomic<StagingBuffer*> next_;
+
+    // State shared by the segments of the thread
+    std::shared_ptr<StagingChain> chain_;
+
     // Backing store used to implement the circular queue
-    char storage_[kSTAGING_BUFFER_SIZE];
+    size_t capacity_;
+    char*  storage_;
+    uint32_t memory_flags_;
+
+    // NUMA node of the thread when it allocated the buffer
+    int node_;
 
     friend class StaticLogBackend;
+    friend class BackendWorker;
     friend class StagingBufferDestroyer;
 };
 
+/**
+ * Registry of the StagingBuffers of the logging threads. A thread adds its
+ * buffer to the first free slot of an append-only list of blocks without
+ * locking, so its start-up never waits behind the backend worker. Only the
+ * worker draining the registry empties slots, the blocks are kept until
+ * the registry goes away.
+ */
+class StagingRegistry {
+public:
+    static const size_t kSLOTS_PER_BLOCK = 64;
+
+    struct Block {
+        Block() : next(nullptr) {
+            for (auto& slot : slots)
+                slot.store(nullptr, std::memory_order_relaxed);
+        }
+
+        std::atomic<StagingBuffer*> slots[kSLOTS_PER_BLOCK];
+        std::atomic<Block*> next;
+    };
+
+    StagingRegistry() : head_(), num_buffers_(0), num_readers_(0) {}
+    ~StagingRegistry();
+
+    StagingRegistry(const StagingRegistry&)=delete;
+    StagingRegistry& operator=(const StagingRegistry&)=delete;
+
+    /**
+    * Registers the buffer of a new thread, lock-free
+    */
+    void add(StagingBuffer* buffer);
+
+    /**
+    * Empties a slot, only called by the worker draining the registry. The
+    * buffer it held may still be in use by a reader, see hasReaders.
+    */
+    void remove(std::atomic<StagingBuffer*>& slot) {
+        slot.store(nullptr);
+        num_buffers_.fetch_sub(1);
+    }
+
+    /**
+    * Calls fn on every slot, empty ones included
+    */
+    template<typename Fn>
+    void forEachSlot(Fn fn) {
+        for (Block* block = &head_; block != nullptr; block = block->next.load(std::memory_order_acquire)) {
+            for (auto& slot : block->slots)
+                fn(slot);
+        }
+    }
+
+    size_t size() const {
+        return num_buffers_.load();
+    }
+
+    /**
+    * Brackets the walks of the threads other than the backend worker, the
+    * worker only deletes the buffers it removed while no walk is running
+    */
+    void beginRead() {
+        num_readers_.fetch_add(1);
+    }
+
+    void endRead() {
+        num_readers_.fetch_sub(1);
+    }
+
+    bool hasReaders() const {
+        return num_readers_.load() != 0;
+    }
+
+private:
+    Block head_;
+    std::atomic<size_t> num_buffers_;
+    std::atomic<uint32_t> num_readers_;
+};
+
+/**
+ * Backing stores of retired StagingBuffers, adopted by the next threads
+ * and elastic segments of the same capacity and NUMA node so that they
+ * start with pages already faulted in, and local. Filled by the backend
+ * workers, up to a size limit.
+ */
+class StagingPool {
+public:
+    StagingPool() : mutex_(), storages_(), max_bytes_(kSTAGING_POOL_SIZE),
+                    num_bytes_(0), num_hits_(0), num_misses_(0) {}
+    ~StagingPool();
+
+    StagingPool(const StagingPool&)=delete;
+    StagingPool& operator=(const StagingPool&)=delete;
+
+    /**
+    * Returns a pooled backing store of the given capacity, StagingMemoryFlags
+    * and NUMA node, or a new one
+    *
+    * \return
+    *      A store whose data is nullptr if the allocation failed
+    */
+    StagingMemory acquire(size_t capacity, uint32_t flags, int node);
+
+    /**
+    * Keeps a backing store for a later acquire
+    *
+    * \return
+    *      false if the pool is full, the caller still owns it then
+    */
+    bool release(const StagingMemory& memory);
+
+    /**
+    * Sets the most memory the pool keeps, trimming it if needed
+    */
+    void setMaxBytes(size_t max_bytes);
+
+    uint64_t getHits() const { return num_hits_.load(std::memory_order_relaxed); }
+    uint64_t getMisses() const { return num_misses_.load(std::memory_order_relaxed); }
+    size_t getBytes();
+
+private:
+    std::mutex mutex_;
+    std::vector<StagingMemory> storages_;
+    size_t max_bytes_;
+    size_t num_bytes_;
+    std::atomic<uint64_t> num_hits_;
+    std::atomic<uint64_t> num_misses_;
+};
+
+class StaticLogBackend;
+
+/**
+ * Thread draining the StagingBuffers of a set of registries, formatting
+ * their entries and handing them to an output of the backend. There is a
+ * single worker draining every registry by default, one per shard with
+ * setBackendWorkers, and one per shard of each NUMA node with
+ * setNumaWorkers, bound to its node and draining the buffers of the
+ * threads that started on it.
+ *
+ * Everything but the output, the call site registry and the retired
+ * statistics is private to the worker. When several share the output,
+ * each one formats a pass into its own batch and appends it to the output
+ * in one go, so that the lines of a shard stay in order but the shards are
+ * only interleaved batch by batch.
+ */
+class BackendWorker {
+public:
+    /**
+    * \param index
+    *      Position of the worker, the first one calibrates the clock and
+    *      configures the output
+    * \param registries
+    *      Indexes of the registries of StaticLogBackend the worker drains
+    * \param node
+    *      NUMA node to run on, -1 to keep the default affinity
+    * \param output
+    *      Output the lines go to, configured by the worker unless it is
+    *      shared and the worker is not the first one
+    * \param batched
+    *      true if other workers share the output
+    */
+    BackendWorker(StaticLogBackend& backend, uint32_t index, std::vector<size_t> registries,
+                  int node, OutputBuffer& output, bool batched);
+    ~BackendWorker();
+
+    BackendWorker(const BackendWorker&)=delete;
+    BackendWorker& operator=(const BackendWorker&)=delete;
+
+    void start();
+    void join();
+
+    void processLogBuffer(StagingBuffer* stagingbuffer);
+
+    /**
+    * Formats and writes the entries available in a StagingBuffer, releasing
+    * the space to the producer with one consume() per contiguous batch.
+    *
+    * \param stagingbuffer
+    *      Buffer to drain
+    * \param budget
+    *      Maximum number of entries to process, 0 means no limit
+    * \return
+    *      Number of entries processed
+    */
+    uint32_t drainLogBuffer(StagingBuffer* stagingbuffer, uint32_t budget);
+
+    /**
+    * Read position of the time ordered merge within one StagingBuffer
+    */
+    struct MergeCursor {
+        // Timestamp and arguments of the entry at data + bytes_consumed
+        uint64_t timestamp;
+        const char* args;
+        StagingBuffer* buffer;
+        // Contiguous region returned by peek()
+        char* data;
+        uint64_t bytes_available;
+        // Bytes formatted but not yet released to the producer
+        uint64_t bytes_consumed;
+    };
+
+    /**
+    * K-way merge of the StagingBuffers through a min-heap keyed on the
+    * timestamp of each buffer's head entry. Entries stamped after limit_tsc
+    * are left in place so that a late producer can still publish older
+    * entries ahead of them.
+    *
+    * \param buffers
+    *      StagingBuffers to merge
+    * \param limit_tsc
+    *      Watermark, only entries stamped at or before it are output
+    * \param budget
+    *      Maximum number of entries to process, 0 means no limit
+    * \param[out] next_tsc
+    *      Timestamp of the earliest entry left behind, UINT64_MAX if none
+    * \return
+    *      Number of entries processed
+    */
+    uint32_t mergeLogBuffers(const std::vector<StagingBuffer *>& buffers,
+                             uint64_t limit_tsc,
+                             uint32_t budget,
+                             uint64_t* next_tsc);
+
+    /**
+    * Positions a cursor on the next contiguous region of a StagingBuffer,
+    * following the segments of an elastic buffer
+    *
+    * \return
+    *      false if the buffer has nothing to consume
+    */
+    static bool refillCursor(MergeCursor& cursor);
+
+private:
+    /**
+    * Traverse the log buffer queue and write to the acquired logs, 
+    * all using periodic timing behavior
+    */
+    void run();
+
+    /**
+    * Pins the thread to its CPU or node and sets its scheduling policy
+    */
+    void applyThreadConfig();
+
+    /**
+    * Waits after a pass that found nothing to do
+    *
+    * \param guard
+    *      Lock of buffer_mutex_, held on entry and on return
+    * \param wait_us
+    *      Longest wait, until the next flush or reorder deadline
+    */
+    void waitIdle(std::unique_lock<std::mutex>& guard, WaitStrategy strategy,
+                  uint32_t max_backoff_us, uint64_t wait_us);
+
+    /**
+    * Calls fn on every slot of the registries of the worker
+    */
+    template<typename Fn>
+    void forEachSlot(Fn fn);
+
+    // Number of buffers in the registries of the worker
+    size_t numBuffers();
+
+    /**
+    * Replaces the head of an elastic StagingBuffer by the next segment once
+    * the worker has drained it
+    *
+    * \param slot
+    *      Slot of the registry holding the oldest segment of the thread
+    * \return
+    *      The segment to drain in place of the one in the slot
+    */
+    StagingBuffer* releaseDrainedSegments(std::atomic<StagingBuffer*>& slot);
+
+    /**
+    * Adds the statistics of a StagingBuffer unlinked from the registry to
+    * the retired ones of the backend, and queues it for deletion by
+    * reclaimSegments. Called between the increments of retire_version_.
+    *
+    * \param last
+    *      true if it is the last segment of its thread
+    */
+    void retireStagingBuffer(StagingBuffer* segment, bool last);
+
+    /**
+    * Deletes the retired StagingBuffers unless a stats reader may still be
+    * walking them, their backing stores go to the pool
+    */
+    void reclaimSegments();
+
+    /**
+    * Writes a "N messages dropped" line for the messages the overflow
+    * policy dropped from a thread since the last report
+    *
+    * \param thread_buffer
+    *      Oldest segment of the thread
+    */
+    void reportDroppedMessages(StagingBuffer* thread_buffer);
+
+    /**
+    * Formats a single log entry and appends it to the output buffer
+    *
+    * \return
+    *      false if the entry could not be formatted
+    */
+    bool formatLogEntry(const LogEntry* log_entry, uint32_t thread_id,
+                        uint64_t timestamp, const char* args);
+
+    /**
+    * Appends a log entry to the output buffer as a binary record, preceded
+    * by the description of its call site the first time the worker sees it
+    * in the current file
+    */
+    bool writeBinaryEntry(const LogEntry* log_entry, uint32_t thread_id,
+                          uint64_t timestamp, const char* args);
+
+    /**
+    * Writes a log entry in the output format of the current file
+    *
+    * \param thread_id
+    *      Id of the StagingBuffer the entry was read from
+    * \param timestamp
+    *      TSC value of the entry, decoded by the caller
+    * \param args
+    *      Start of the arguments of the entry
+    */
+    inline bool writeLogEntry(const LogEntry* log_entry, uint32_t thread_id,
+                              uint64_t timestamp, const char* args);
+
+    // Appends to the output, or to the batch of the pass when it is shared
+    void appendOutput(const char* data, size_t len);
+
+    /**
+    * Returns the call site with the given id, refreshing the worker's copy
+    * of the registry when the id is newer than it
+    */
+    inline const Callsite& lookupCallsite(uint32_t id)
+    {
+        if (id >= callsite_cache_.size())
+            refreshCallsites();
+        return callsite_cache_[id];
+    }
+
+    /**
+    * Copies the call sites registered since the last call into
+    * callsite_cache_ and binds their layout
+    */
+    void refreshCallsites();
+
+    StaticLogBackend& backend_;
+    uint32_t index_;
+    std::vector<size_t> registries_;
+    int      node_;
+
+    std::thread thread_;
+
+    // Copy of the clock model, refreshed every pass
+    ClockCalibration clock_;
+
+    // Time at which the current pass started
+    int64_t pass_start_ns_;
+
+    // Output of the worker, and the lines of the pass, appended to it at
+    // its end when it is shared
+    OutputBuffer& output_;
+    bool batched_;
+    std::string batch_;
+
+    // Renderer of the line timestamps
+    TimestampRenderer timestamp_;
+
+    // Copy of the line layout of the backend the call sites of
+    // callsite_cache_ are bound to
+    LineLayout active_layout_;
+    uint64_t   active_layout_version_;
+
+    // Copy of the call site registry, the only one with the layouts
+    std::vector<Callsite> callsite_cache_;
+
+    // Call sites the worker already described in the current binary file
+    std::vector<bool> callsite_described_;
+
+    // Latest timestamp output by the merge
+    uint64_t last_merged_tsc_;
+
+    // Scratch heap of mergeLogBuffers
+    std::vector<MergeCursor> merge_heap_;
+
+    // Current spin of the backoff wait strategies
+    uint64_t backoff_us_;
+
+    // Watermark crossings already seen when the pass started, see
+    // StaticLogBackend::wakeUpWorkers
+    uint64_t wakeup_seq_;
+
+    // Segments removed from the registries, deleted by reclaimSegments
+    std::vector<StagingBuffer *> retired_segments_;
+
+    // Stores the formatted log content
+    char*   log_buffer_;
+    size_t  bufflen_;
+};
+
+/**
+ * A logger: the StagingBuffers of the threads logging to it, its backend
+ * workers and its log file. STATIC_LOG and the free functions of
+ * static_log.h use the static default logger, the others are created
+ * through static_log::Logger. Loggers share nothing but the call site
+ * registry.
+ */
 class StaticLogBackend {
 public:
+    /**
+    * \param log_file
+    *      File to log to, opened right away
+    */
+    explicit StaticLogBackend(const char* log_file);
     ~StaticLogBackend();
 
+    static StaticLogBackend& getDefault()
+    {
+        return logger_;
+    }
+
     /**
     * The write cache work queue is allocated in advance, and if the function
     * is not called, the request of the queue will be postponed until the first 
     * write log 
+    *
+    * \param buffer_size
+    *   Capacity of the queue, 0 for the one set by setStagingBufferSize
     */
-    static void preallocate()
+    void preallocate(size_t buffer_size = 0)
     {
-        logger_.ensureStagingBufferAllocated();
+        ensureStagingBufferAllocated(buffer_size);
     }
 
-    static LogLevels::LogLevel getLogLevel()
+    void setStagingBufferSize(size_t buffer_size, size_t elastic_limit)
     {
-        return logger_.current_log_level_;
+        staging_buffer_size_ = std::max(buffer_size, kMIN_STAGING_BUFFER_SIZE);
+        elastic_limit_ = elastic_limit;
+    }
+
+    void setOverflowPolicy(LogLevels::LogLevel level, OverflowPolicy policy)
+    {
+        if (level >= 0 && level < LogLevels::kNUM_LOG_LEVELS)
+            overflow_policies_[level].store(policy, std::memory_order_relaxed);
+    }
+
+    void setThreadOverflowPolicy(int8_t policy)
+    {
+        ensureStagingBufferAllocated();
+        thread_buffers_[id_].buffer->chain_->overflow_policy = policy;
+    }
+
+    void setStagingMemory(uint32_t flags)
+    {
+        staging_memory_ = flags;
+    }
+
+    void setStagingWatermark(uint32_t percent)
+    {
+        watermark_percent_ = percent;
+    }
+
+    void setStagingPoolSize(size_t max_bytes)
+    {
+        pool_.setMaxBytes(max_bytes);
+    }
+
+    void setNumaWorkers(bool enabled)
+    {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        stopWorkers(true);
+        numa_workers_ = enabled;
+        startWorkers();
+    }
+
+    void setBackendWorkers(uint32_t num_workers, ShardOutput output)
+    {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        stopWorkers(true);
+        num_shards_ = std::min(std::max(num_workers, 1u), kMAX_BACKEND_WORKERS);
+        shard_output_ = output;
+        startWorkers();
+    }
+
+    void setBackendThreads(const int* cpus, size_t num_cpus, int sched_policy, int sched_priority)
+    {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        stopWorkers(true);
+        worker_cpus_.assign(cpus, cpus + (cpus != NULL ? num_cpus : 0));
+        sched_policy_ = sched_policy;
+        sched_priority_ = sched_priority;
+        startWorkers();
+    }
+
+    void setBackendWaitStrategy(WaitStrategy strategy, uint32_t max_backoff_us)
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        wait_strategy_ = strategy;
+        max_backoff_us_ = max_backoff_us;
+    }
+
+    LogLevels::LogLevel getLogLevel()
+    {
+        return current_log_level_;
     }
 
     /**
@@ -248,33 +938,38 @@ public:
     * \param log_file
     *   new log file path
     */
-    static void setLogFile(const char* log_file)
+    void setLogFile(const char* log_file)
     {
-        std::unique_lock<std::mutex> lock(logger_.buffer_mutex_);
-        logger_.is_stop_ = true;
-        logger_.is_exit_ = true;
-        lock.unlock();
-        logger_.fdflush_.join();
-        lock.lock();
-        logger_.is_exit_ = false;
-        if (logger_.outfd_ != -1) {
-            close(logger_.outfd_);
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        stopWorkers(true);
+        if (outfd_ != -1) {
+            close(outfd_);
         }
-        logger_.outfd_ = -1;
-        logger_.outfd_ = open(log_file, O_RDWR|O_CREAT, 0666);
-        if(logger_.outfd_ == -1) {
+        outfd_ = -1;
+        outfd_ = open(log_file, O_RDWR|O_CREAT, 0666);
+        if(outfd_ == -1) {
             fprintf(stderr, "%s: Failed to open file %s\n", __FUNCTION__, log_file);
             return;
         }
-        lock.unlock();
-        logger_.fdflush_ = std::move(std::thread(&StaticLogBackend::ioPoll, &logger_));
+        log_file_ = log_file;
+        startWorkers();
+    }
+
+    // Wake up backend workers
+    void sync()
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        wake_up_cond_.notify_all();
+    }
+
+    ClockCalibration getClockCalibration()
+    {
+        return clock_.snapshot();
     }
 
-    // Wake up backend worker
-    static void sync()
+    void setClockRecalibrationInterval(uint32_t interval_ms)
     {
-        std::unique_lock<std::mutex> lock(logger_.buffer_mutex_);
-        logger_.wake_up_cond_.notify_one();
+        clock_.setRecalibrationInterval(interval_ms);
     }
 
     /**
@@ -284,12 +979,12 @@ public:
     * \param log_level
     *      LogLevel enum that specifies the minimum log level.
     */
-    static void setLogLevel(LogLevels::LogLevel log_level) {
+    void setLogLevel(LogLevels::LogLevel log_level) {
         if (log_level < 0)
             log_level = static_cast<LogLevels::LogLevel>(0);
         else if (log_level >= LogLevels::LogLevel::kNUM_LOG_LEVELS)
             log_level = static_cast<LogLevels::LogLevel>(LogLevels::LogLevel::kNUM_LOG_LEVELS - 1);
-        logger_.current_log_level_ = log_level;
+        current_log_level_ = log_level;
     }
 
     /**
@@ -299,20 +994,28 @@ public:
      * to the compression thread and this function shall not be invoked
      * again until the corresponding finishAlloc() is invoked first.
      *
-     * Note this will block of the buffer is full.
+     * When the buffer is full the overflow policy of the thread or of the
+     * level applies, see setOverflowPolicy.
      *
      * \param nbytes
      *      number of bytes to allocate in the
+     * \param level
+     *      Level of the message
      *
      * \return
-     *      pointer to the allocated space
+     *      pointer to the allocated space, nullptr if the message is
+     *      dropped
      */
-    static inline char *
-    reserveAlloc(size_t nbytes) {
-        if (staging_buffer_ == nullptr)
-            logger_.ensureStagingBufferAllocated();
+    inline char *
+    reserveAlloc(size_t nbytes, LogLevels::LogLevel level) {
+        ThreadBuffer& slot = thread_buffers_[id_];
+        if (slot.serial != serial_)
+            ensureStagingBufferAllocated();
 
-        return logger_.staging_buffer_->reserveProducerSpace(nbytes);
+        char* pos = slot.buffer->reserveProducerSpace(nbytes);
+        if (pos == nullptr)
+            pos = reserveOverflow(nbytes, level);
+        return pos;
     }
 
     /**
@@ -322,15 +1025,115 @@ public:
      * \param nbytes
      *      Number of bytes to make visible
      */
-    static inline void
+    inline void
     finishAlloc(size_t nbytes) {
-        logger_.staging_buffer_->finishReservation(nbytes);
+        if (thread_buffers_[id_].buffer->finishReservation(nbytes))
+            wakeUpWorkers();
     }
 
-    void processLogBuffer(StagingBuffer* stagingbuffer);
+    /**
+     * Encodes the timestamp of the entry being written to the thread's
+     * StagingBuffer, see StagingBuffer::encodeTimestamp.
+     */
+    inline char *
+    encodeTimestamp(char *pos, uint64_t tsc) {
+        return thread_buffers_[id_].buffer->encodeTimestamp(pos, tsc);
+    }
+
+    /**
+     * Assigns an id to a call site, the STATIC_LOG macro calls it once per
+     * call site and stores the id in each of its entries.
+     *
+     * \return
+     *      Id of the call site
+     */
+    static uint32_t registerCallsite(const StaticInfo* static_info)
+    {
+        std::unique_lock<std::mutex> lock(callsite_mutex_);
+        callsites_.push_back(Callsite{static_info});
+        return callsites_.size() - 1;
+    }
+
+    /**
+    * Sets how many entries the backend drains per pass, from each
+    * StagingBuffer in the unordered mode and in total in the time ordered
+    * mode.
+    *
+    * \param max_entries
+    *      Batch size, 0 drains everything available
+    */
+    void setDrainBatchSize(uint32_t max_entries)
+    {
+        drain_batch_size_ = max_entries;
+    }
+
+    void setOutputOrdering(OutputOrdering ordering, uint32_t reorder_window_us)
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        ordering_ = ordering;
+        reorder_window_us_ = reorder_window_us;
+    }
+
+    void setOutputBuffering(size_t flush_threshold, uint32_t max_latency_us)
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        flush_threshold_ = flush_threshold;
+        max_latency_us_ = max_latency_us;
+    }
+
+    void setOutputSink(OutputSink sink, uint32_t queue_depth, int writer_cpu)
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        output_sink_ = sink;
+        queue_depth_ = queue_depth;
+        writer_cpu_ = writer_cpu;
+    }
+
+    void setOutputFormat(OutputFormat format)
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        output_format_ = format;
+    }
+
+    void setTimestampFormat(TimestampFormat format)
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        timestamp_format_ = format;
+    }
+
+    bool setLogPattern(const char* pattern)
+    {
+        // Compiled here so that the backend worker only copies the ops
+        LineLayout layout;
+        if (!layout.compile(pattern))
+            return false;
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        layout_ = std::move(layout);
+        layout_version_++;
+        return true;
+    }
+
+    StagingStats getStagingStats();
+
+    OutputStats getOutputStats()
+    {
+        OutputStats stats = output_.getStats();
+        // The totals include the files of the other workers
+        for (size_t i = 0; i < num_shard_outputs_; ++i) {
+            OutputBuffer* output = shard_outputs_[i].load(std::memory_order_acquire);
+            if (output == nullptr)
+                continue;
+            OutputStats shard_stats = output->getStats();
+            stats.bytes_written += shard_stats.bytes_written;
+            stats.num_flushes += shard_stats.num_flushes;
+            stats.num_syscalls += shard_stats.num_syscalls;
+            stats.max_flush_bytes = std::max(stats.max_flush_bytes, shard_stats.max_flush_bytes);
+        }
+        stats.num_out_of_order = num_late_entries_.load(std::memory_order_relaxed);
+        return stats;
+    }
 
 private:
-    StaticLogBackend();
     StaticLogBackend(const StaticLogBackend&)=delete;
     StaticLogBackend& operator=(const StaticLogBackend&)=delete;
     StaticLogBackend(StaticLogBackend&&)=delete;
@@ -341,57 +1144,177 @@ private:
      * This is used by the generated C++ code to ensure it has space to
      * log uncompressed messages to and by the user if they wish to
      * preallocate the data structures on thread creation.
+     *
+     * \param buffer_size
+     *      Capacity of the StagingBuffer, 0 for staging_buffer_size_
      */
-    inline void ensureStagingBufferAllocated()
+    inline void ensureStagingBufferAllocated(size_t buffer_size = 0)
     {
-        if (staging_buffer_ == nullptr) {
-            std::unique_lock<std::mutex> guard(buffer_mutex_);
-            uint32_t bufferId = next_buffer_id_++;
-
-            // Unlocked for the expensive StagingBuffer allocation
-            guard.unlock();
-            staging_buffer_ = new StagingBuffer(bufferId);
-            guard.lock();
-
-            thread_buffers_.push_back(staging_buffer_);
+        ThreadBuffer& slot = thread_buffers_[id_];
+        if (slot.serial != serial_) {
+            // Left by a destroyed logger that had the same id
+            if (slot.buffer != nullptr)
+                releaseThreadBuffer(slot.buffer);
+            uint32_t bufferId = next_buffer_id_.fetch_add(1, std::memory_order_relaxed);
+            size_t capacity = buffer_size == 0 ? staging_buffer_size_.load()
+                                               : std::max(buffer_size, kMIN_STAGING_BUFFER_SIZE);
+            // The buffer stays on the node the thread starts on
+            int node = currentNumaNode();
+            StagingMemory memory = pool_.acquire(capacity, staging_memory_.load(), node);
+            if (memory.data == NULL) {
+                fprintf(stderr, "Failed to allocate a staging buffer of %lu bytes\n", capacity);
+                exit(-1);
+            }
+            slot.buffer = new StagingBuffer(bufferId, memory, elastic_limit_.load());
+            slot.buffer->setWatermark(watermark_percent_.load());
+            slot.serial = serial_;
+            registries_[registryIndex(node, bufferId)].add(slot.buffer);
             destroyer_.createDestroyer();
         }
     }
     
     /**
-    * Traverse the log buffer queue and write to the acquired logs, 
-    * all using periodic timing behavior
+    * Slow path of reserveAlloc when the StagingBuffer of the thread is full,
+    * chains a new segment to an elastic buffer or else applies the overflow
+    * policy of the thread or of the level
+    *
+    * \return
+    *      Pointer to at least nbytes of contiguous space, nullptr if the
+    *      message is dropped
+    */
+    char* reserveOverflow(size_t nbytes, LogLevels::LogLevel level);
+
+    /**
+    * Moves the thread to a new segment chained after its full elastic
+    * StagingBuffer, the backend worker drains the full one and then
+    * releases it.
+    *
+    * \return
+    *      Pointer to at least nbytes of contiguous space, nullptr if the
+    *      segments of the thread would take more than the elastic limit
+    */
+    char* chainStagingBuffer(size_t nbytes);
+
+    /**
+    * Wakes up the sleeping backend workers for a StagingBuffer that crossed
+    * its watermark, without a syscall when none is sleeping. Pairs with
+    * BackendWorker::waitIdle: a worker either sees the new wakeup_seq_ or
+    * is counted in num_sleeping_ when this checks it.
+    */
+    void wakeUpWorkers();
+
+    /**
+    * Index in registries_ of the registry of a new StagingBuffer: the
+    * registries of a NUMA node are followed by those of the next one, and
+    * the buffer goes to the one of its shard
+    */
+    size_t registryIndex(int node, uint32_t buffer_id);
+
+    /**
+    * Starts the backend workers on outfd_, num_shards_ of them, times the
+    * number of NUMA nodes with numa_workers_. With kSHARD_FILES, opens the
+    * files of the workers other than the first one.
+    */
+    void startWorkers();
+
+    /**
+    * Writes the header of a binary log file
     */
-    void ioPoll();
+    void writeFileHeader(int fd);
+
+    /**
+    * Stops the backend workers and writes out what they formatted
+    *
+    * \param exiting
+    *      true to stop after the current pass, false to wait until every
+    *      thread exited and its StagingBuffer was drained
+    */
+    void stopWorkers(bool exiting);
+
+    /**
+    * Lets go of the StagingBuffer of the calling thread, when it exits or
+    * when its logger was destroyed. The backend deletes it once drained,
+    * unless the logger is gone already, then it is deleted right away.
+    */
+    static void releaseThreadBuffer(StagingBuffer* buffer);
 
 private:
-    static __thread StagingBuffer *staging_buffer_;
+    /**
+    * StagingBuffer of a thread for the logger of a given id, the serial
+    * tells the loggers that had this id apart
+    */
+    struct ThreadBuffer {
+        uint64_t serial;
+        StagingBuffer* buffer;
+    };
+    static __thread ThreadBuffer thread_buffers_[kMAX_LOGGERS];
 
     class StagingBufferDestroyer {
     public:
         StagingBufferDestroyer() {}
         ~StagingBufferDestroyer() {
-            if (StaticLogBackend::staging_buffer_ != nullptr) {
-                StaticLogBackend::staging_buffer_->should_deallocate_ = true;
+            for (auto& slot : StaticLogBackend::thread_buffers_) {
+                if (slot.buffer != nullptr)
+                    StaticLogBackend::releaseThreadBuffer(slot.buffer);
             }
         }
         void createDestroyer() {}
     };
     static thread_local StagingBufferDestroyer destroyer_;
 
+    // Ids of the loggers alive, and the serial of the last one created
+    static std::mutex ids_mutex_;
+    static bool ids_used_[kMAX_LOGGERS];
+    static uint64_t last_serial_;
+
+    // Index of the logger in thread_buffers_, and its serial
+    uint32_t id_;
+    uint64_t serial_;
+
     // Minimum log level that RuntimeLogger will accept. Anything lower will
     // be dropped.
     LogLevels::LogLevel current_log_level_;
 
+    // Serializes setLogFile and setNumaWorkers
+    std::mutex control_mutex_;
+
     // Used to synchonize the log buffer
     std::mutex buffer_mutex_;
     // Used to synchonize the backend worker
     std::mutex cond_mutex_;
     std::condition_variable wake_up_cond_;
-    uint32_t   next_buffer_id_;
+    std::atomic<uint32_t> next_buffer_id_;
+
+    // Globally the thread-local stagingBuffers, the oldest segment of each
+    // thread in the elastic mode, in kMAX_BACKEND_WORKERS registries per
+    // NUMA node, one per possible shard
+    std::unique_ptr<StagingRegistry[]> registries_;
+    size_t num_registries_;
+
+    // Backing stores of the deleted segments, reused by new ones
+    StagingPool pool_;
+
+    // Capacity of the StagingBuffers and elastic limit of the threads that
+    // did not preallocate one, see setStagingBufferSize
+    std::atomic<size_t> staging_buffer_size_;
+    std::atomic<size_t> elastic_limit_;
+    std::atomic<uint64_t> num_segments_chained_;
+
+    // StagingMemoryFlags of the StagingBuffers allocated from now on, see
+    // setStagingMemory
+    std::atomic<uint32_t> staging_memory_;
+
+    // Fill watermark of the StagingBuffers allocated from now on, see
+    // setStagingWatermark. wakeup_seq_ counts the crossings, num_sleeping_
+    // the workers waiting on wake_up_cond_ and num_watermark_wakeups_ the
+    // crossings that found one.
+    std::atomic<uint32_t> watermark_percent_;
+    std::atomic<uint64_t> wakeup_seq_;
+    std::atomic<uint32_t> num_sleeping_;
+    std::atomic<uint64_t> num_watermark_wakeups_;
 
-    // Globally the thread-local stagingBuffers
-    std::vector<StagingBuffer *> thread_buffers_;
+    // Overflow policy of each level, see setOverflowPolicy
+    std::atomic<OverflowPolicy> overflow_policies_[LogLevels::kNUM_LOG_LEVELS];
 
     // Flag signaling the thread to stop running.
     std::atomic<bool> is_stop_;
@@ -399,19 +1322,105 @@ private:
     // Only used in setlogFile
     std::atomic<bool> is_exit_;
 
-    // Backend worker who really sync the message into file
-    std::thread fdflush_;
+    // Number of entries drained from a StagingBuffer per pass, see
+    // setDrainBatchSize
+    std::atomic<uint32_t> drain_batch_size_;
 
-    // The file fd which sync log message to disk
+    // How entries of different threads are ordered in the output, see
+    // setOutputOrdering. Written under buffer_mutex_.
+    OutputOrdering ordering_;
+    uint32_t       reorder_window_us_;
+
+    // Number of entries that arrived after the reorder window and were
+    // output out of order
+    std::atomic<uint64_t> num_late_entries_;
+
+    // Backend workers who really sync the message into file, and whether
+    // there is one per NUMA node, see setNumaWorkers
+    std::vector<std::unique_ptr<BackendWorker>> workers_;
+    bool numa_workers_;
+
+    // Number of shards the StagingBuffers are split into, and where their
+    // workers write, see setBackendWorkers
+    std::atomic<uint32_t> num_shards_;
+    ShardOutput shard_output_;
+
+    // CPUs and scheduling of the workers, see setBackendThreads, and how
+    // they wait when idle, written under buffer_mutex_
+    std::vector<int> worker_cpus_;
+    int      sched_policy_;
+    int      sched_priority_;
+    WaitStrategy wait_strategy_;
+    uint32_t max_backoff_us_;
+
+    // The file fd which sync log message to disk, and its path
     int     outfd_;
+    std::string log_file_;
 
-    // Stores the formatted log content
-    char*   log_buffer_;
-    size_t  bufflen_;
+    // Outputs of the workers other than the first one with kSHARD_FILES,
+    // created on first use and kept for their statistics, and the files
+    // they write while the workers run
+    std::unique_ptr<std::atomic<OutputBuffer*>[]> shard_outputs_;
+    size_t num_shard_outputs_;
+    std::vector<int> shard_fds_;
+
+    // Converts the TSC stamped by the front logger into wall-clock time,
+    // calibrated by the first backend worker
+    TscClock clock_;
+
+    // Coalesces formatted lines before they are written to outfd_, and its
+    // configuration, written under buffer_mutex_. Appended to under
+    // output_mutex_ when there are several workers.
+    std::mutex output_mutex_;
+    OutputBuffer output_;
+    size_t   flush_threshold_;
+    uint32_t max_latency_us_;
+    OutputSink output_sink_;
+    uint32_t queue_depth_;
+    int      writer_cpu_;
+
+    // Encoding of the log file, written under buffer_mutex_, and the copy
+    // used for the file being written
+    OutputFormat output_format_;
+    OutputFormat active_format_;
+
+    // Format of the line timestamps, written under buffer_mutex_, and
+    // applied by the workers each pass
+    TimestampFormat timestamp_format_;
+
+    // Line layout, compiled by setLogPattern and written under
+    // buffer_mutex_, the workers bind their call sites to a copy
+    LineLayout layout_;
+    uint64_t   layout_version_;
+    uint32_t   pid_;
+
+    // Registry of the call sites of all the loggers, indexed by id, the
+    // workers use a copy without locking
+    static std::mutex callsite_mutex_;
+    static std::vector<Callsite> callsites_;
+
+    // Statistics of the retired StagingBuffers. A worker makes
+    // retire_version_ odd while it moves a buffer from the registry to
+    // them, under retire_mutex_, getStagingStats retries when it changed
+    // under it.
+    std::mutex retire_mutex_;
+    StagingStats retired_stats_;
+    std::atomic<uint64_t> retire_version_;
 private:
     static StaticLogBackend logger_;
+
+    friend class BackendWorker;
 };
 
+inline bool
+BackendWorker::writeLogEntry(const LogEntry* log_entry, uint32_t thread_id,
+                             uint64_t timestamp, const char* args)
+{
+    if (backend_.active_format_ == kBINARY)
+        return writeBinaryEntry(log_entry, thread_id, timestamp, args);
+    return formatLogEntry(log_entry, thread_id, timestamp, args);
+}
+
 } // details
 
 } // static_log
@@ -0,0 +1,74 @@
+#ifndef STATIC_LOG_BINARY_H
+#define STATIC_LOG_BINARY_H
+
+#include <stdint.h>
+
+namespace static_log {
+namespace details {
+
+/**
+ * Layout of the log file written in the kBINARY output mode, decoded
+ * offline by static_log_decode. All integers are in host byte order.
+ *
+ * The file starts with a BinaryFileHeader followed by a sequence of
+ * records, each starting with a BinaryRecordType byte:
+ *  - a BinaryCallsiteRecord describes a call site the first time one of
+ *    its messages is written to the file, it is followed by num_params
+ *    BinaryParam, the format string, the function name and the file name
+ *    (no NULL terminators);
+ *  - a BinaryLogRecord is followed by the arguments exactly as the front
+ *    logger stored them in the StagingBuffer: non-string arguments on the
+ *    size given by their BinaryParam, strings as a varint length followed
+ *    by the bytes.
+ * A new header may appear at any record boundary when the backend starts
+ * appending to an existing file, call site ids restart from there.
+ */
+static const char kBINARY_LOG_MAGIC[8] = {'S', 'T', 'L', 'O', 'G', 'B', 'I', 'N'};
+static const uint32_t kBINARY_LOG_VERSION = 3;
+
+struct BinaryFileHeader {
+    char     magic[8];
+    uint32_t version;
+    // Process that wrote the records up to the next header
+    uint32_t pid;
+};
+
+enum BinaryRecordType : uint8_t {
+    kRECORD_CALLSITE = 1,
+    kRECORD_LOG = 2,
+    // First byte of kBINARY_LOG_MAGIC
+    kRECORD_FILE_HEADER = 'S'
+};
+
+struct __attribute__((packed)) BinaryCallsiteRecord {
+    uint8_t  type;
+    uint32_t id;
+    uint8_t  log_level;
+    uint32_t line;
+    uint16_t num_params;
+    uint32_t format_len;
+    uint32_t function_len;
+    uint32_t file_len;
+};
+
+struct __attribute__((packed)) BinaryParam {
+    // ParamType of the parameter
+    int32_t  type;
+    // Size of a non-string argument, 0 for strings which carry their length
+    uint32_t size;
+};
+
+struct __attribute__((packed)) BinaryLogRecord {
+    uint8_t  type;
+    uint32_t id;
+    // Id of the thread that logged the message
+    uint32_t thread_id;
+    // Wall-clock time in nanoseconds since the epoch
+    int64_t  timestamp;
+    uint32_t args_len;
+};
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_BINARY_H
@@ -0,0 +1,136 @@
+#include "static_log_backend.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "static_log_cycles.h"
+
+namespace static_log {
+namespace details {
+
+#define DEFAULT_RECALIBRATE_INTERVAL_MS 1000
+#define REFERENCE_SAMPLE_ATTEMPTS 8
+// Drift beyond which the wall clock is considered stepped (settimeofday,
+// NTP step) rather than the TSC frequency misestimated: far more than the
+// error of the initial calibration and of crystal oscillators over the
+// elapsed time, with a floor for the jitter of the reference samples
+#define CLOCK_STEP_MAX_PPM 500
+#define CLOCK_STEP_MIN_NS 100000
+
+TscClock::TscClock():
+    base_tsc_(0),
+    base_ns_(0),
+    ns_per_tick_(1.0),
+    first_tsc_(0),
+    first_ns_(0),
+    recalibrate_ms_(DEFAULT_RECALIBRATE_INTERVAL_MS),
+    last_drift_ns_(0),
+    max_drift_ns_(0),
+    num_calibrations_(0),
+    snapshot_mutex_(),
+    published_()
+{
+}
+
+void
+TscClock::sampleReference(uint64_t* tsc, int64_t* ns)
+{
+    uint64_t best_window = UINT64_MAX;
+    for (int i = 0; i < REFERENCE_SAMPLE_ATTEMPTS; ++i) {
+        uint64_t before = __builtin_ia32_rdtsc();
+        int64_t now = get_nanotime();
+        uint64_t after = __builtin_ia32_rdtsc();
+        if (after - before < best_window) {
+            best_window = after - before;
+            *tsc = before + (after - before) / 2;
+            *ns = now;
+        }
+    }
+}
+
+void
+TscClock::calibrate()
+{
+    sampleReference(&first_tsc_, &first_ns_);
+    uint64_t tsc = 0;
+    int64_t ns = 0;
+    do {
+        sampleReference(&tsc, &ns);
+    } while (ns - first_ns_ < kINIT_CALIBRATION_NS);
+
+    ns_per_tick_ = static_cast<double>(ns - first_ns_) / static_cast<double>(tsc - first_tsc_);
+    base_tsc_ = tsc;
+    base_ns_ = ns;
+    num_calibrations_ = 1;
+    publish();
+}
+
+bool
+TscClock::maybeRecalibrate(uint64_t now_tsc)
+{
+    uint64_t interval_ticks = nanosToTicks(recalibrate_ms_.load(std::memory_order_relaxed) * 1000000ULL);
+    if (now_tsc - base_tsc_ < interval_ticks)
+        return false;
+
+    uint64_t tsc = 0;
+    int64_t ns = 0;
+    sampleReference(&tsc, &ns);
+
+    // Error of the current model at the new reference point
+    last_drift_ns_ = ns - toNanos(tsc);
+    if (llabs(last_drift_ns_) > llabs(max_drift_ns_))
+        max_drift_ns_ = last_drift_ns_;
+
+    // Elapsed time by the TSC, which the step does not affect
+    if (isStep(last_drift_ns_, toNanos(tsc) - base_ns_)) {
+        // Averaging across the step would fold it into the frequency, keep
+        // the frequency and start a new baseline from here
+        first_tsc_ = tsc;
+        first_ns_ = ns;
+    } else {
+        ns_per_tick_ = static_cast<double>(ns - first_ns_) / static_cast<double>(tsc - first_tsc_);
+    }
+    base_tsc_ = tsc;
+    base_ns_ = ns;
+    num_calibrations_++;
+    publish();
+    return true;
+}
+
+bool
+TscClock::isStep(int64_t drift_ns, int64_t elapsed_ns)
+{
+    int64_t threshold_ns = elapsed_ns / 1000000 * CLOCK_STEP_MAX_PPM;
+    return llabs(drift_ns) > std::max<int64_t>(threshold_ns, CLOCK_STEP_MIN_NS);
+}
+
+void
+TscClock::setRecalibrationInterval(uint32_t interval_ms)
+{
+    recalibrate_ms_ = interval_ms;
+}
+
+void
+TscClock::publish()
+{
+    std::lock_guard<std::mutex> guard(snapshot_mutex_);
+    published_.ns_per_tick = ns_per_tick_;
+    published_.base_tsc = base_tsc_;
+    published_.base_ns = base_ns_;
+    published_.last_drift_ns = last_drift_ns_;
+    published_.max_drift_ns = max_drift_ns_;
+    published_.num_calibrations = num_calibrations_;
+}
+
+ClockCalibration
+TscClock::snapshot()
+{
+    std::lock_guard<std::mutex> guard(snapshot_mutex_);
+    ClockCalibration calibration = published_;
+    calibration.recalibrate_interval_ms = recalibrate_ms_;
+    return calibration;
+}
+
+} // details
+} // static_log
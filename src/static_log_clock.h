@@ -0,0 +1,135 @@
+#ifndef STATIC_LOG_CLOCK_H
+#define STATIC_LOG_CLOCK_H
+
+#include <stdint.h>
+
+#include <mutex>
+#include <atomic>
+
+#include "static_log.h"
+
+namespace static_log {
+namespace details {
+
+/**
+ * Converts the raw TSC values recorded by the front logger into wall-clock
+ * nanoseconds.
+ *
+ * The conversion is a linear model anchored on a (tsc, ns) reference pair
+ * sampled from get_nanotime() (provided by tscns). The model is owned by the
+ * backend thread: it is the only one calling calibrate()/maybeRecalibrate()
+ * and toNanos(), so the hot conversion path needs no synchronization. Other
+ * threads read the model through snapshot(), which is guarded by a mutex
+ * that is only touched when the model changes.
+ */
+class TscClock {
+public:
+    TscClock();
+
+    /**
+     * Takes the initial reference pairs and estimates the TSC frequency.
+     * Blocks the caller for roughly kINIT_CALIBRATION_NS.
+     */
+    void calibrate();
+
+    /**
+     * Re-anchors the model if the recalibration interval has elapsed since
+     * the last calibration. The TSC frequency is re-estimated over the whole
+     * period since the first reference pair, and the error of the previous
+     * model at the new reference point is recorded as drift. A drift large
+     * enough to be a step of the wall clock restarts that period instead.
+     *
+     * \param now_tsc
+     *      Current TSC value, used to check the interval without a syscall
+     * \return
+     *      true if the model was updated
+     */
+    bool maybeRecalibrate(uint64_t now_tsc);
+
+    /**
+     * Converts a raw TSC value into wall-clock nanoseconds since the epoch.
+     */
+    inline int64_t
+    toNanos(uint64_t tsc) const {
+        return base_ns_ + static_cast<int64_t>(
+                static_cast<double>(static_cast<int64_t>(tsc - base_tsc_)) * ns_per_tick_);
+    }
+
+    /**
+     * Converts a number of nanoseconds into TSC ticks with the current model.
+     */
+    inline uint64_t
+    nanosToTicks(uint64_t ns) const {
+        return static_cast<uint64_t>(static_cast<double>(ns) / ns_per_tick_);
+    }
+
+    /**
+     * toNanos() with a published model, for the threads other than the
+     * one calibrating, see snapshot()
+     */
+    static inline int64_t
+    toNanos(const ClockCalibration& calibration, uint64_t tsc) {
+        return calibration.base_ns + static_cast<int64_t>(
+                static_cast<double>(static_cast<int64_t>(tsc - calibration.base_tsc))
+                * calibration.ns_per_tick);
+    }
+
+    static inline uint64_t
+    nanosToTicks(const ClockCalibration& calibration, uint64_t ns) {
+        return static_cast<uint64_t>(static_cast<double>(ns) / calibration.ns_per_tick);
+    }
+
+    void setRecalibrationInterval(uint32_t interval_ms);
+
+    /**
+     * Tells a step of the wall clock from the drift of the model, which
+     * grows with the time since the last calibration.
+     *
+     * \param drift_ns
+     *      Error of the model at a new reference pair
+     * \param elapsed_ns
+     *      Wall-clock time since the previous reference pair
+     */
+    static bool isStep(int64_t drift_ns, int64_t elapsed_ns);
+
+    // Thread safe copy of the calibration state
+    ClockCalibration snapshot();
+
+private:
+    /**
+     * Samples a (tsc, ns) pair. The TSC is read on both sides of the clock
+     * read and the tightest of several attempts is kept, using the midpoint
+     * of the two TSC reads as the tsc matching the ns value.
+     */
+    static void sampleReference(uint64_t* tsc, int64_t* ns);
+
+    void publish();
+
+    // Duration of the blocking initial calibration
+    static const int64_t kINIT_CALIBRATION_NS = 10000000;
+
+    // Model parameters, only accessed by the backend thread
+    uint64_t base_tsc_;
+    int64_t  base_ns_;
+    double   ns_per_tick_;
+
+    // First reference pair, used as the long baseline for frequency estimation
+    uint64_t first_tsc_;
+    int64_t  first_ns_;
+
+    // Recalibration interval, may be changed from any thread
+    std::atomic<uint32_t> recalibrate_ms_;
+
+    int64_t  last_drift_ns_;
+    int64_t  max_drift_ns_;
+    uint64_t num_calibrations_;
+
+    // Protects published_
+    std::mutex snapshot_mutex_;
+    ClockCalibration published_;
+};
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_CLOCK_H
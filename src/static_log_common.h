@@ -1,6 +1,9 @@
 #ifndef STATIC_LOG_COMMON_H
 #define STATIC_LOG_COMMON_H
 
+#include <stdint.h>
+#include <stddef.h>
+
 namespace static_log
 {
 
@@ -15,7 +18,94 @@ namespace static_log
 
 #define BYTES_PER_CACHE_LINE 64
 
+// Default capacity of the StagingBuffer of each thread, and the smallest
+// one accepted
 static const uint32_t kSTAGING_BUFFER_SIZE = 1048576U;
+static const size_t kMIN_STAGING_BUFFER_SIZE = 4096U;
+
+// Default amount of retired StagingBuffer memory kept for new threads
+static const size_t kSTAGING_POOL_SIZE = 8 * kSTAGING_BUFFER_SIZE;
+
+// Most loggers alive at the same time, the default one included
+static const uint32_t kMAX_LOGGERS = 16;
+
+// Most backend workers sharing the StagingBuffers of a logger, per NUMA
+// node with setNumaWorkers
+static const uint32_t kMAX_BACKEND_WORKERS = 16;
+
+namespace details {
+
+// Longest varint encoding of a 64-bit value
+static const size_t kMAX_VARINT_LEN = 10;
+
+/**
+ * Stores value 7 bits at a time, least significant group first, with the
+ * high bit of each byte set when more bytes follow.
+ *
+ * \return
+ *      Position after the encoded value
+ */
+inline char*
+encodeVarint(char* dst, uint64_t value)
+{
+    while (value >= 0x80) {
+        *dst++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *dst++ = static_cast<char>(value);
+    return dst;
+}
+
+/**
+ * Number of bytes encodeVarint uses for value
+ */
+inline size_t
+varintSize(uint64_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+/**
+ * Reverse of encodeVarint
+ *
+ * \return
+ *      Position after the encoded value
+ */
+inline const char*
+decodeVarint(const char* src, uint64_t* value)
+{
+    uint64_t result = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = static_cast<uint8_t>(*src++);
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && shift < 64);
+    *value = result;
+    return src;
+}
+
+// Maps small negative differences (e.g. after a migration to a core with a
+// slightly late TSC) to small unsigned values
+inline uint64_t
+zigzagEncode(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t
+zigzagDecode(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+} // namespace details
 
 } // namespace static_log
 
@@ -0,0 +1,189 @@
+#include "static_log_decoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "static_log_binary.h"
+#include "static_log_format.h"
+
+namespace static_log {
+namespace details {
+
+BinaryLogDecoder::BinaryLogDecoder():
+    callsites_(),
+    num_messages_(0),
+    pid_(0),
+    timestamp_(),
+    layout_(),
+    log_buffer_(NULL),
+    bufflen_(0)
+{
+    log_buffer_ = (char*)malloc(DEFALT_CACHE_SIZE);
+    if (log_buffer_ == NULL) {
+        fprintf(stderr, "Failed to create log buffer\n");
+        exit(-1);
+    }
+    bufflen_ = DEFALT_CACHE_SIZE;
+}
+
+BinaryLogDecoder::~BinaryLogDecoder()
+{
+    free(log_buffer_);
+}
+
+long
+BinaryLogDecoder::decodeFileHeader(const char* data, size_t len)
+{
+    BinaryFileHeader header;
+    if (len < sizeof(header))
+        return 0;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kBINARY_LOG_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "Not a binary log\n");
+        return -1;
+    }
+    if (header.version != kBINARY_LOG_VERSION) {
+        fprintf(stderr, "Unsupported binary log version %u\n", header.version);
+        return -1;
+    }
+    // Ids restart with every header
+    callsites_.clear();
+    pid_ = header.pid;
+    return sizeof(header);
+}
+
+long
+BinaryLogDecoder::decodeCallsite(const char* data, size_t len)
+{
+    BinaryCallsiteRecord record;
+    if (len < sizeof(record))
+        return 0;
+    memcpy(&record, data, sizeof(record));
+    size_t record_len = sizeof(record) + record.num_params * sizeof(BinaryParam)
+                        + record.format_len + record.function_len + record.file_len;
+    if (len < record_len)
+        return 0;
+    if (record.log_level >= LogLevels::kNUM_LOG_LEVELS) {
+        fprintf(stderr, "Invalid log level %u for call site %u\n", record.log_level, record.id);
+        return -1;
+    }
+
+    std::unique_ptr<Callsite> callsite(new Callsite());
+    const char* pos = data + sizeof(record);
+    for (uint16_t i = 0; i < record.num_params; ++i) {
+        BinaryParam param;
+        memcpy(&param, pos, sizeof(param));
+        pos += sizeof(param);
+        callsite->param_types.push_back((ParamType)param.type);
+        callsite->param_size.push_back(param.size);
+    }
+    callsite->format.assign(pos, record.format_len);
+    pos += record.format_len;
+    callsite->function.assign(pos, record.function_len);
+    pos += record.function_len;
+    callsite->file.assign(pos, record.file_len);
+    callsite->static_info.reset(new StaticInfo(record.num_params,
+            callsite->param_types.data(), callsite->param_size.data(), callsite->format.c_str(),
+            (LogLevels::LogLevel)record.log_level, callsite->function.c_str(),
+            callsite->file.c_str(), record.line));
+    callsite->layout = layout_.bind(callsite->static_info.get(), pid_);
+    callsites_[record.id] = std::move(callsite);
+    return record_len;
+}
+
+long
+BinaryLogDecoder::decodeLog(const char* data, size_t len, FILE* out)
+{
+    BinaryLogRecord record;
+    if (len < sizeof(record))
+        return 0;
+    memcpy(&record, data, sizeof(record));
+    if (len < sizeof(record) + record.args_len)
+        return 0;
+
+    auto it = callsites_.find(record.id);
+    if (it == callsites_.end()) {
+        fprintf(stderr, "Unknown call site %u\n", record.id);
+        return -1;
+    }
+    const Callsite& callsite = *it->second;
+
+    // Check that the arguments stay within the record before formatting
+    const char* args = data + sizeof(record);
+    size_t offset = 0;
+    bool valid = true;
+    for (size_t i = 0; i < callsite.param_types.size() && valid; ++i) {
+        if (callsite.param_types[i] > ParamType::kNON_STRING) {
+            // Decode the length from a copy so a corrupted one cannot make
+            // the decoder read past the record
+            char varint[kMAX_VARINT_LEN] = {};
+            memcpy(varint, args + offset, std::min(kMAX_VARINT_LEN, (size_t)record.args_len - offset));
+            uint64_t string_size;
+            offset += decodeVarint(varint, &string_size) - varint;
+            valid = offset <= record.args_len && string_size <= record.args_len - offset;
+            if (valid)
+                offset += string_size;
+        } else {
+            valid = callsite.param_size[i] <= record.args_len - offset;
+            if (valid)
+                offset += callsite.param_size[i];
+        }
+    }
+    if (!valid || offset != record.args_len) {
+        fprintf(stderr, "Corrupted arguments for call site %u\n", record.id);
+        return -1;
+    }
+
+    int line_len = formatLogLine(callsite.static_info.get(), callsite.layout,
+                                 args, record.timestamp, record.thread_id,
+                                 timestamp_, log_buffer_, bufflen_);
+    if (line_len == -1)
+        return -1;
+    fwrite(log_buffer_, 1, line_len, out);
+    num_messages_++;
+    return sizeof(record) + record.args_len;
+}
+
+bool
+BinaryLogDecoder::decode(const char* data, size_t len, FILE* out)
+{
+    if (len < sizeof(BinaryFileHeader) ||
+            memcmp(data, kBINARY_LOG_MAGIC, sizeof(kBINARY_LOG_MAGIC)) != 0) {
+        fprintf(stderr, "Not a binary log\n");
+        return false;
+    }
+
+    size_t pos = 0;
+    while (pos < len) {
+        long consumed;
+        switch (data[pos]) {
+        case kRECORD_FILE_HEADER:
+            consumed = decodeFileHeader(data + pos, len - pos);
+            break;
+        case kRECORD_CALLSITE:
+            consumed = decodeCallsite(data + pos, len - pos);
+            break;
+        case kRECORD_LOG:
+            consumed = decodeLog(data + pos, len - pos, out);
+            break;
+        default:
+            fprintf(stderr, "Unknown record type %u at offset %lu\n", (uint8_t)data[pos], pos);
+            return false;
+        }
+        if (consumed == -1) {
+            fprintf(stderr, "Failed to decode the record at offset %lu\n", pos);
+            return false;
+        }
+        if (consumed == 0) {
+            fprintf(stderr, "Ignoring the truncated record at offset %lu\n", pos);
+            break;
+        }
+        pos += consumed;
+    }
+    return true;
+}
+
+} // details
+} // static_log
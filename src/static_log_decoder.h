@@ -0,0 +1,92 @@
+#ifndef STATIC_LOG_DECODER_H
+#define STATIC_LOG_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "static_log_internal.h"
+#include "static_log_format.h"
+
+namespace static_log {
+namespace details {
+
+/**
+ * Renders a log file written in the kBINARY output mode (see
+ * static_log_binary.h) into the same text the backend produces in the
+ * kTEXT mode.
+ */
+class BinaryLogDecoder {
+public:
+    BinaryLogDecoder();
+    ~BinaryLogDecoder();
+
+    BinaryLogDecoder(const BinaryLogDecoder&)=delete;
+    BinaryLogDecoder& operator=(const BinaryLogDecoder&)=delete;
+
+    /**
+     * Decodes a whole binary log.
+     *
+     * \param data
+     *      Content of the log file
+     * \param len
+     *      Length of data
+     * \param out
+     *      Where to write the text lines
+     * \return
+     *      false if the file is not a binary log or is corrupted, the lines
+     *      before the error are written. A record truncated at the end of
+     *      the file (e.g. after a crash) is ignored.
+     */
+    bool decode(const char* data, size_t len, FILE* out);
+
+    uint64_t getNumMessages() const { return num_messages_; }
+
+    // Format of the line timestamps, kLOCAL_NANOSECONDS by default
+    void setTimestampFormat(TimestampFormat format) { timestamp_.setFormat(format); }
+
+    // Layout of the lines, see static_log::setLogPattern. Only applies to
+    // the call sites decoded afterwards.
+    bool setLogPattern(const char* pattern) { return layout_.compile(pattern); }
+
+private:
+    // Call site rebuilt from a BinaryCallsiteRecord
+    struct Callsite {
+        std::string format;
+        std::string function;
+        std::string file;
+        std::vector<ParamType> param_types;
+        std::vector<size_t> param_size;
+        std::unique_ptr<StaticInfo> static_info;
+        CallsiteLayout layout;
+    };
+
+    // Each decoder returns the number of bytes consumed, 0 if the record is
+    // truncated and -1 if it is malformed
+    long decodeFileHeader(const char* data, size_t len);
+    long decodeCallsite(const char* data, size_t len);
+    long decodeLog(const char* data, size_t len, FILE* out);
+
+    std::unordered_map<uint32_t, std::unique_ptr<Callsite>> callsites_;
+    uint64_t num_messages_;
+
+    // Process that wrote the records, from the last file header
+    uint32_t pid_;
+
+    TimestampRenderer timestamp_;
+    LineLayout layout_;
+
+    // Stores the formatted log content
+    char*   log_buffer_;
+    size_t  bufflen_;
+};
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_DECODER_H
@@ -0,0 +1,462 @@
+#include "static_log_format.h"
+#include "static_log_formatter.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+namespace static_log {
+
+namespace details {
+
+static int
+resize_log_buffer(char*&  log_buffer, size_t& old_size, size_t new_size)
+{
+    char* buffer = (char*)malloc(new_size);
+    if (buffer == NULL) {
+        fprintf(stderr, "Failed to resize log buffer, wanted to alloc %lu\n", new_size);
+        return -1;
+    }
+    memcpy(buffer, log_buffer, old_size);
+    free(log_buffer);
+    log_buffer = buffer;
+    old_size = new_size;
+    return 0;
+}
+
+bool
+FormatOutput::grow(size_t min_len)
+{
+    return resize_log_buffer(buffer, buflen, std::max(min_len, buflen << 1)) == 0;
+}
+
+#define CHECK_LOG_BUFFER_REALLOC() do { \
+    if (fmt_len >= reserved) {   \
+        int ret = resize_log_buffer(log_buffer, log_buffer_len, (fmt_len << 1) + log_buffer_len - reserved);   \
+        if (ret < 0) return -1; \
+        reserved = log_buffer_len - start_pos;  \
+        goto retry; \
+    }   \
+} while(0)
+
+
+/**
+* Reads an integer parameter of param_size bytes, sign extended to 64 bits
+* if is_signed, see toPrintfInteger.
+*
+* \return
+*   false if the size is not one of an integer type
+*/
+static bool
+readIntegerParam(const char* param, size_t param_size, bool is_signed, uint64_t* bits)
+{
+    switch (param_size) {
+    case sizeof(uint8_t):
+        *bits = is_signed ? (uint64_t)*(int8_t*)param : *(uint8_t*)param;
+        return true;
+    case sizeof(uint16_t):
+        *bits = is_signed ? (uint64_t)*(int16_t*)param : *(uint16_t*)param;
+        return true;
+    case sizeof(uint32_t):
+        *bits = is_signed ? (uint64_t)*(int32_t*)param : *(uint32_t*)param;
+        return true;
+    case sizeof(uint64_t):
+        *bits = *(uint64_t*)param;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+* Encode the non-string parameters of the binary log into strings, 
+*
+* Only support 8 16 32 64-bit parameters, and convert them into corresponding 
+* types according to the format characters during encoding and convert 
+* them to the corresponding strings through the c original format. Integers
+* and most floats are formatted by formatInteger and formatFloat instead of
+* snprintf.
+* 
+* \param log_buffer
+*   Reference to pointer used to store logs.
+* \param log_buffer_len
+*   Reference to length of the log buffer
+* \param reserved
+*   Reference to  reserved space to store message
+* \param start_pos
+*   The position which next to write
+* \param fmt
+* \param param
+*   Binary parameter infomation which generated by front logger
+* \param param_size
+*   Size of the param
+*/
+#pragma GCC diagnostic ignored "-Wformat"
+static int
+decodeNonStringFmt(
+    char*& log_buffer, 
+    size_t& log_buffer_len,
+    size_t& reserved,
+    size_t start_pos,
+    char * fmt, 
+    const char* param, 
+    size_t param_size)
+{
+    size_t fmt_len = 0;
+    char terminal_flag = fmt[strlen(fmt) - 1];
+    FormatSpec spec = parseFormatSpec(fmt, 0);
+    uint64_t bits;
+    if (isIntegerConversion(terminal_flag) && terminal_flag != 'c'
+            && !spec.dynamic_width && !spec.dynamic_precision
+            && readIntegerParam(param, param_size, isSignedConversion(terminal_flag), &bits)) {
+        uint64_t magnitude;
+        bool negative;
+        toPrintfInteger(spec.length, terminal_flag, bits, magnitude, negative);
+retry_integer:
+        fmt_len = formatInteger(log_buffer + start_pos, reserved, spec, spec.width,
+                                spec.precision, magnitude, negative);
+        if (fmt_len >= reserved) {
+            if (resize_log_buffer(log_buffer, log_buffer_len, (fmt_len << 1) + log_buffer_len - reserved) < 0)
+                return -1;
+            reserved = log_buffer_len - start_pos;
+            goto retry_integer;
+        }
+        return fmt_len;
+    }
+    if (isFloatConversion(terminal_flag) && !spec.dynamic_width && !spec.dynamic_precision
+            && (param_size == sizeof(float) || param_size == sizeof(double))) {
+        double value = param_size == sizeof(float) ? *(float*)param : *(double*)param;
+retry_float:
+        fmt_len = formatFloat(log_buffer + start_pos, reserved, spec, spec.width,
+                              spec.precision, value);
+        if (fmt_len != kFORMAT_UNSUPPORTED) {
+            if (fmt_len >= reserved) {
+                if (resize_log_buffer(log_buffer, log_buffer_len, (fmt_len << 1) + log_buffer_len - reserved) < 0)
+                    return -1;
+                reserved = log_buffer_len - start_pos;
+                goto retry_float;
+            }
+            return fmt_len;
+        }
+    }
+retry:
+    switch (param_size) {
+    case sizeof(char):
+        {
+            const char* param8 = param;
+            if (terminal_flag == 'c') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(char*)param8);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else if (terminal_flag == 'd' || terminal_flag == 'i') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(int8_t*)param8);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else if (terminal_flag == 'u' || terminal_flag == 'o' || terminal_flag == 'x' || terminal_flag == 'X') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(uint8_t*)param8);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else 
+                fprintf(stderr, "Failed to parse fmt with a one bytes long param\n");
+            break;
+        }
+    case sizeof(uint16_t):
+        {
+            const uint16_t* param16 = (uint16_t*)param;
+            if (terminal_flag == 'd' || terminal_flag == 'i') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(int16_t*)param16);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else if (terminal_flag == 'u' || terminal_flag == 'o' || terminal_flag == 'x' || terminal_flag == 'X') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(uint16_t*)param16);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else 
+                fprintf(stderr, "Failed to parse fmt with a two bytes long param\n");
+            break;
+        }
+    case sizeof(uint32_t):
+        {
+            const uint32_t* param32 = (uint32_t*)param;
+            if (terminal_flag == 'd' || terminal_flag == 'i') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(int32_t*)param32);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else if (terminal_flag == 'u' || terminal_flag == 'o' || terminal_flag == 'x' || terminal_flag == 'X') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(uint32_t*)param32);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else if (terminal_flag == 'f' || terminal_flag == 'F' || terminal_flag == 'e' ||terminal_flag == 'e' || 
+                terminal_flag == 'E' || terminal_flag == 'g' || terminal_flag == 'G'|| terminal_flag == 'a' ||terminal_flag == 'A') {
+                static_assert(sizeof(float) == sizeof(uint32_t));
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(float*)param32);
+                CHECK_LOG_BUFFER_REALLOC();
+            }            
+            else 
+                fprintf(stderr, "Failed to parse fmt with a two bytes long param\n");
+            break;
+        }
+    case sizeof(uint64_t):
+        {
+            const uint64_t* param64 = (uint64_t*)param;
+            if (terminal_flag == 'd' || terminal_flag == 'i') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(int64_t*)param64);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else if (terminal_flag == 'u' || terminal_flag == 'o' || terminal_flag == 'x' || terminal_flag == 'X') {
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(uint64_t*)param64);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else if (terminal_flag == 'f' || terminal_flag == 'F' || terminal_flag == 'e' ||terminal_flag == 'e' || 
+                terminal_flag == 'E' || terminal_flag == 'g' || terminal_flag == 'G'|| terminal_flag == 'a' ||terminal_flag == 'A') {
+                static_assert(sizeof(double) == sizeof(uint64_t));
+                fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, *(double*)param64);
+                CHECK_LOG_BUFFER_REALLOC();
+            }
+            else
+                fprintf(stderr, "Failed to parse fmt with a two bytes long param\n");
+            break;
+        }
+    default:
+        fprintf(stderr, "Failed to decode fmt param, got size %lu\n", param_size);
+        break;
+    }
+    return fmt_len;
+}
+#pragma GCC diagnostic pop
+
+#define DEFAULT_PARAM_CACHE_SIZE 1024
+static int
+decodeStringFmt(char*& log_buffer, size_t& bufferlen, size_t& reserved, size_t start_pos, const char* param, size_t param_size, const char* fmt)
+{
+    assert(start_pos + reserved == bufferlen);
+    char string_param_cache[DEFAULT_PARAM_CACHE_SIZE];
+    bool dynamic_alloc = false;
+    char* param_buffer = string_param_cache;
+    int ret = 0;
+    if (param_size >= DEFAULT_PARAM_CACHE_SIZE) {
+        param_buffer = (char*)malloc(param_size + 1); // strlen(str) + '\0'
+        if (param_buffer == NULL) {
+            fprintf(stderr, "Failed to alloc param buffer\n");
+            return -1;
+        }
+        dynamic_alloc = true;
+    }
+    memcpy(param_buffer, param, param_size);
+    param_buffer[param_size] = '\0';
+    size_t needed_fmt_len = snprintf(log_buffer + start_pos, reserved, fmt, param_buffer);
+    if (needed_fmt_len >= reserved) {
+        size_t new_log_buflen = needed_fmt_len + 1 + bufferlen - reserved;
+        char* tmp = (char*)malloc(new_log_buflen);
+        if (tmp == NULL) {
+            fprintf(stderr, "Failed to realloc log buffer, needed alloc size %lu\n", needed_fmt_len);
+            ret = -1;
+            goto out;
+        }
+        reserved = new_log_buflen - bufferlen + reserved;
+        bufferlen = new_log_buflen;
+        memcpy(tmp, log_buffer, start_pos);
+        snprintf(tmp + start_pos, needed_fmt_len + 1, fmt, param_buffer);
+        free(log_buffer);
+        log_buffer = tmp;
+    }
+    ret = needed_fmt_len;
+out:
+    if (dynamic_alloc)
+        free(param_buffer);
+    return ret;
+}
+
+/**
+* The binary log content of the front-end is formatted into a readable format and written to disk
+*
+* \param fmt
+*   Pointer to paramter formatter like %s %d
+* \param num_params
+*   The number of parameters
+* \param param_type
+*   Pointer to the type of paramter
+* \param param_size_list
+*   Pointer to size of the paramter
+* \param param_list
+*   Pointer to binary infomation of parameter
+* \param log_buffer
+*   Reference to pointer used to store readable information
+* \param buflen
+*   Reference to the length of buffer
+* \param start_pos
+*   Next position to write in
+*/
+static int
+process_fmt(
+        const char* fmt, 
+        const int num_params, 
+        const ParamType* param_types,
+        const size_t* param_size_list,
+        const char* param_list, 
+        char*& log_buffer, size_t& buflen, size_t start_pos)
+{
+    char* log_pos = log_buffer + start_pos;
+    size_t fmt_list_len = strlen(fmt);
+    size_t reserved = buflen - start_pos;
+    size_t pos = 0;
+    int param_idx = 0;
+    bool success = true;
+    while (pos < fmt_list_len) {
+        if (reserved < 2) {
+            size_t log_offset = log_pos - log_buffer;
+            if (resize_log_buffer(log_buffer, buflen, buflen << 1) < 0)
+                return -1;
+            reserved = buflen - log_offset;
+            log_pos = log_buffer + log_offset;
+        }
+        if (fmt[pos] != '%') {
+            *log_pos++ = fmt[pos++];
+            reserved--;
+            continue;
+        } else {
+            ++pos;
+            int fmt_single_len = 1;
+            if (fmt[pos] == '%') {
+                *log_pos++ = '%';
+                reserved--;
+                ++pos;
+                continue;
+            } else {
+                int fmt_start_pos = pos - 1;
+                while (!isTerminal(fmt[pos])) {
+                    fmt_single_len++;
+                    pos++;
+                }
+                fmt_single_len++;
+                pos++;
+                char* fmt_single;
+                char static_fmt_cache[100];
+                bool dynamic_fmt = false;
+                if (fmt_single_len < 100) {
+                    memset(static_fmt_cache, 0, 100);
+                    fmt_single = static_fmt_cache;
+                } else {
+                    fmt_single = (char*)malloc(fmt_single_len);
+                    dynamic_fmt = true;
+                }
+                memcpy(fmt_single, fmt + fmt_start_pos, fmt_single_len);
+                int log_fmt_len = 0;
+
+                if (param_idx < num_params) {
+                    // The decoders may reallocate log_buffer
+                    size_t log_offset = log_pos - log_buffer;
+                    if (param_types[param_idx] > ParamType::kNON_STRING) {
+                        uint64_t string_size;
+                        param_list = decodeVarint(param_list, &string_size);
+                        log_fmt_len = decodeStringFmt(log_buffer, buflen, reserved, log_pos - log_buffer, param_list, string_size, fmt_single);
+                        param_list = param_list + string_size;
+                    }
+                    else {
+                        log_fmt_len = decodeNonStringFmt(log_buffer, buflen, reserved, log_pos - log_buffer, fmt_single, param_list, param_size_list[param_idx]);
+                        if (log_fmt_len == -1)  {
+                            success = false;
+                            break;
+                        }
+                        param_list += param_size_list[param_idx];
+                    }
+                    if (log_fmt_len == -1) {
+                        success = false;
+                        if (dynamic_fmt)
+                            free(fmt_single);
+                        break;
+                    }
+                    log_pos = log_buffer + log_offset + log_fmt_len;
+                    reserved -= log_fmt_len;
+                    param_idx++;
+                } else {
+                    fprintf(stderr, "Failed to fmt log\n");
+                    success = false;
+                    if (dynamic_fmt) 
+                        free(fmt_single);
+                    break;
+                }
+                if (dynamic_fmt) 
+                    free(fmt_single);
+            }
+        }
+    }
+    return success? buflen - reserved: -1;
+}
+
+
+int
+formatLogLine(const StaticInfo* static_info,
+              const CallsiteLayout& layout,
+              const char* args,
+              int64_t timestamp_ns,
+              uint32_t thread_id,
+              TimestampRenderer& timestamp,
+              char*& log_buffer,
+              size_t& buflen)
+{
+    // Room for all the fields but the message, and for the newline
+    if (layout.max_prefix_len >= buflen
+            && resize_log_buffer(log_buffer, buflen, layout.max_prefix_len << 1) < 0)
+        return -1;
+
+    size_t pos = 0;
+    for (const LayoutOp& op : layout.ops) {
+        switch (op.type) {
+        case LayoutOp::kLITERAL:
+            memcpy(log_buffer + pos, layout.text.data() + op.offset, op.length);
+            pos += op.length;
+            break;
+        case LayoutOp::kTIMESTAMP:
+            pos += timestamp.render(timestamp_ns, log_buffer + pos);
+            break;
+        case LayoutOp::kTHREAD_ID: {
+            char digits[10];
+            char* first = digits + sizeof(digits);
+            uint32_t value = thread_id;
+            do {
+                *--first = '0' + value % 10;
+                value /= 10;
+            } while (value != 0);
+            memcpy(log_buffer + pos, first, digits + sizeof(digits) - first);
+            pos += digits + sizeof(digits) - first;
+            break;
+        }
+        case LayoutOp::kMESSAGE: {
+            // The formatters return the end position of the message within
+            // log_buffer
+            int len;
+            if (static_info->format_function != nullptr) {
+                len = static_info->format_function(args, log_buffer, buflen, pos);
+            } else {
+                len = process_fmt(static_info->format,
+                        static_info->num_params,
+                        static_info->param_types,
+                        static_info->arg_sizes,
+                        args,
+                        log_buffer, buflen, pos);
+            }
+            if (len == -1)
+                return -1;
+            pos = len;
+            if (pos + layout.max_prefix_len >= buflen
+                    && resize_log_buffer(log_buffer, buflen, (pos + layout.max_prefix_len) << 1) < 0)
+                return -1;
+            break;
+        }
+        default:
+            // Rendered by LineLayout::bind
+            break;
+        }
+    }
+    log_buffer[pos] = '\n';
+    return pos + 1;
+}
+
+} // details
+
+} // static_log
@@ -0,0 +1,56 @@
+#ifndef STATIC_LOG_FORMAT_H
+#define STATIC_LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "static_log_internal.h"
+#include "static_log_layout.h"
+#include "static_log_timestamp.h"
+
+namespace static_log {
+namespace details {
+
+// Initial size of the buffer messages are rendered into, grown on demand
+#define DEFALT_CACHE_SIZE 1024 * 1024
+
+/**
+* Renders a log message as a line of text, shared by the backend in the
+* text output mode and by the offline decoder of binary logs. The line
+* follows the layout of the call site, by default
+*   [xxxx-xx-xx-hh:mm:ss.xxxxxxxxx][LEVEL][FUNCTION][LINE]message\n
+*
+* \param static_info
+*   Static information of the call site
+* \param layout
+*   Layout of the call site, see LineLayout::bind
+* \param args
+*   Arguments as stored by the front logger
+* \param timestamp_ns
+*   Wall-clock time of the message, in nanoseconds since the epoch
+* \param thread_id
+*   Id of the thread that logged the message
+* \param timestamp
+*   Renders timestamp_ns in the configured format
+* \param log_buffer
+*   Reference to the buffer to render into, at least DEFALT_CACHE_SIZE
+*   bytes long, reallocated if the message does not fit
+* \param buflen
+*   Reference to the length of log_buffer
+* \return
+*   Length of the line including the newline, -1 if it could not be
+*   formatted
+*/
+int formatLogLine(const StaticInfo* static_info,
+                  const CallsiteLayout& layout,
+                  const char* args,
+                  int64_t timestamp_ns,
+                  uint32_t thread_id,
+                  TimestampRenderer& timestamp,
+                  char*& log_buffer,
+                  size_t& buflen);
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_FORMAT_H
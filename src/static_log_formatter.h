@@ -0,0 +1,474 @@
+#ifndef STATIC_LOG_FORMATTER_H
+#define STATIC_LOG_FORMATTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <type_traits>
+#include <utility>
+
+#include "static_log_internal.h"
+#include "static_log_number.h"
+
+namespace static_log {
+
+namespace details {
+
+// Longest printf specifier, NUL included, handled by the generated
+// formatters. Call sites with a longer one are formatted at runtime.
+static const int kMAX_SPEC_LEN = 24;
+
+/**
+ * Parses a printf conversion specification. The format string has already
+ * been validated by getParamInfo.
+ *
+ * \param fmt
+ *      Format string
+ * \param pos
+ *      Position of the '%' starting the specification
+ * \return
+ *      The specification
+ */
+constexpr inline FormatSpec
+parseFormatSpec(const char* fmt, int pos)
+{
+    FormatSpec spec;
+    ++pos;
+    while (isFlag(fmt[pos])) {
+        switch (fmt[pos]) {
+        case '-': spec.left_align = true; break;
+        case '+': spec.plus_sign = true; break;
+        case ' ': spec.space_sign = true; break;
+        case '#': spec.alternate = true; break;
+        default: spec.zero_pad = true; break;
+        }
+        ++pos;
+    }
+
+    if (fmt[pos] == '*') {
+        spec.dynamic_width = true;
+        ++pos;
+    } else {
+        while (isDigit(fmt[pos]))
+            spec.width = 10 * spec.width + (fmt[pos++] - '0');
+    }
+
+    if (fmt[pos] == '.') {
+        ++pos;
+        spec.precision = 0;
+        if (fmt[pos] == '*') {
+            spec.dynamic_precision = true;
+            ++pos;
+        } else {
+            while (isDigit(fmt[pos]))
+                spec.precision = 10 * spec.precision + (fmt[pos++] - '0');
+        }
+    }
+
+    if (fmt[pos] == 'h' && fmt[pos + 1] == 'h') {
+        spec.length = 'H';
+        pos += 2;
+    } else if (fmt[pos] == 'l' && fmt[pos + 1] == 'l') {
+        spec.length = 'q';
+        pos += 2;
+    } else if (isLength(fmt[pos])) {
+        spec.length = fmt[pos++];
+    }
+
+    spec.conversion = fmt[pos];
+    return spec;
+}
+
+/**
+ * Compile-time parse of a format string, laid out so that the formatter
+ * generated for a call site only reads constants: the literal text printed
+ * before each parameter and, for the parameter completing a conversion, the
+ * printf specifier it is rendered with.
+ *
+ * \tparam NParams
+ *      Number of parameters of the format string
+ * \tparam N
+ *      Length of the format string
+ */
+template<int NParams, int N>
+struct FormatLayout {
+    int num_params = NParams;
+
+    // Literal text of the format string with "%%" unescaped. Parameter i is
+    // preceded by literal_lengths[i] bytes at literal_offsets[i], the entry
+    // at NParams is the text after the last conversion.
+    char literals[N] = {};
+    int literal_offsets[NParams + 1] = {};
+    int literal_lengths[NParams + 1] = {};
+
+    ParamType param_types[NParams + 1] = {};
+
+    // Conversion a parameter completes
+    FormatSpec format_specs[NParams + 1] = {};
+
+    // NUL terminated specifier of the conversion a parameter completes. The
+    // precision of string conversions is replaced by ".*" since the stored
+    // bytes are already truncated and have no terminator.
+    char specs[NParams + 1][kMAX_SPEC_LEN] = {};
+
+    // For a dynamic width or precision parameter, its index within the
+    // conversion, for the last parameter of a conversion, the number of
+    // dynamic parameters before it
+    int num_dynamic[NParams + 1] = {};
+    bool dynamic_width[NParams + 1] = {};
+
+    // The conversion is exactly "%s", the string is copied as is
+    bool plain_string[NParams + 1] = {};
+
+    // False if a specifier does not fit in kMAX_SPEC_LEN
+    bool valid = true;
+};
+
+/**
+ * Parses a printf format string into a FormatLayout. The string has already
+ * been validated by getParamInfo when counting its parameters.
+ *
+ * \tparam NParams
+ *      Number of parameters of the format string, see countFmtParams
+ * \tparam N
+ *      Length of the format string (automatically deduced)
+ * \param fmt
+ *      Format string to parse
+ */
+template<int NParams, int N>
+constexpr FormatLayout<NParams, N>
+analyzeFormatLayout(const char (&fmt)[N])
+{
+    FormatLayout<NParams, N> layout;
+    int pos = 0;
+    int lit = 0;
+    int param = 0;
+    while (pos < N - 1) {
+        if (fmt[pos] != '%' || fmt[pos + 1] == '%') {
+            layout.literals[lit++] = fmt[pos];
+            pos += fmt[pos] == '%' ? 2 : 1;
+        } else {
+            int start = pos++;
+            while (isFlag(fmt[pos]))
+                ++pos;
+
+            bool dynamic_width = fmt[pos] == '*';
+            if (dynamic_width) {
+                ++pos;
+            } else {
+                while (isDigit(fmt[pos]))
+                    ++pos;
+            }
+
+            int precision_start = pos;
+            bool dynamic_precision = false;
+            if (fmt[pos] == '.') {
+                ++pos;
+                if (fmt[pos] == '*') {
+                    dynamic_precision = true;
+                    ++pos;
+                } else {
+                    while (isDigit(fmt[pos]))
+                        ++pos;
+                }
+            }
+            int precision_end = pos;
+
+            while (isLength(fmt[pos]))
+                ++pos;
+            bool is_string = fmt[pos] == 's';
+            int end = pos + 1;
+
+            // The literal text so far goes before the first parameter of the
+            // conversion, the dynamic ones get none
+            layout.literal_lengths[param] = lit - layout.literal_offsets[param];
+            int num_dynamic = dynamic_width + dynamic_precision;
+            for (int i = 0; i < num_dynamic; ++i) {
+                layout.num_dynamic[param] = i;
+                ++param;
+                layout.literal_offsets[param] = lit;
+            }
+
+            char* spec = layout.specs[param];
+            int spec_len = is_string ? (precision_start - start) + 2 + (end - precision_end)
+                                     : end - start;
+            if (spec_len >= kMAX_SPEC_LEN) {
+                layout.valid = false;
+            } else if (is_string) {
+                for (int i = start; i < precision_start; ++i)
+                    *spec++ = fmt[i];
+                *spec++ = '.';
+                *spec++ = '*';
+                for (int i = precision_end; i < end; ++i)
+                    *spec++ = fmt[i];
+            } else {
+                for (int i = start; i < end; ++i)
+                    *spec++ = fmt[i];
+            }
+            layout.format_specs[param] = parseFormatSpec(fmt, start);
+            layout.num_dynamic[param] = num_dynamic;
+            layout.dynamic_width[param] = dynamic_width;
+            layout.plain_string[param] = is_string && end - start == 2;
+
+            ++param;
+            layout.literal_offsets[param] = lit;
+            pos = end;
+        }
+    }
+    layout.literal_lengths[param] = lit - layout.literal_offsets[param];
+
+    for (int i = 0; i < NParams; ++i)
+        layout.param_types[i] = getParamInfo(fmt, i);
+    return layout;
+}
+
+/**
+ * Destination of a generated formatter: the log buffer, grown on demand, and
+ * the dynamic width and precision of the conversion being rendered.
+ */
+struct FormatOutput {
+    char*&  buffer;
+    size_t& buflen;
+    size_t  pos;
+    int     dynamic_args[2];
+
+    // Reallocates buffer to hold at least min_len bytes, defined in
+    // static_log_format.cc
+    bool grow(size_t min_len);
+
+    bool append(const char* data, size_t len)
+    {
+        if (pos + len > buflen && !grow(pos + len))
+            return false;
+        memcpy(buffer + pos, data, len);
+        pos += len;
+        return true;
+    }
+
+    bool printInteger(const FormatSpec& spec, int width, int precision,
+                      uint64_t magnitude, bool negative)
+    {
+        size_t len = formatInteger(buffer + pos, buflen - pos, spec, width, precision,
+                                   magnitude, negative);
+        if (pos + len > buflen) {
+            if (!grow(pos + len))
+                return false;
+            formatInteger(buffer + pos, buflen - pos, spec, width, precision,
+                          magnitude, negative);
+        }
+        pos += len;
+        return true;
+    }
+
+    // Sets supported to false, writing nothing, for the values formatFloat
+    // leaves to snprintf
+    bool printFloat(const FormatSpec& spec, int width, int precision, double value,
+                    bool& supported)
+    {
+        size_t len = formatFloat(buffer + pos, buflen - pos, spec, width, precision, value);
+        supported = len != kFORMAT_UNSUPPORTED;
+        if (!supported)
+            return true;
+        if (pos + len > buflen) {
+            if (!grow(pos + len))
+                return false;
+            formatFloat(buffer + pos, buflen - pos, spec, width, precision, value);
+        }
+        pos += len;
+        return true;
+    }
+
+    template<typename... Ts>
+    bool print(const char* spec, Ts... values)
+    {
+        size_t available = buflen - pos;
+        int len = snprintf(buffer + pos, available, spec, values...);
+        if (len < 0)
+            return false;
+        if (static_cast<size_t>(len) >= available) {
+            if (!grow(pos + len + 1))
+                return false;
+            snprintf(buffer + pos, len + 1, spec, values...);
+        }
+        pos += len;
+        return true;
+    }
+};
+
+/**
+ * Sign or zero extends an integer or enum argument to 64 bits, see
+ * toPrintfInteger.
+ */
+template<typename T>
+inline uint64_t
+integerBits(T value)
+{
+    if constexpr (std::is_enum<T>::value) {
+        return integerBits(static_cast<typename std::underlying_type<T>::type>(value));
+    } else if constexpr (std::is_signed<T>::value) {
+        return static_cast<uint64_t>(static_cast<int64_t>(value));
+    } else {
+        return static_cast<uint64_t>(value);
+    }
+}
+
+/**
+ * Renders the I-th argument, stored by storeArgument, preceded by the
+ * literal text before it. Everything but the argument value is known at
+ * compile time.
+ *
+ * \tparam Layout
+ *      FormatLayout of the call site
+ * \tparam I
+ *      Index of the parameter
+ * \tparam T
+ *      Type of the argument passed to the log invocation
+ * \param out
+ *      Where to render
+ * \param[in/out] args
+ *      Stored argument, moved past it
+ */
+template<const auto& Layout, size_t I, typename T>
+inline bool
+formatParam(FormatOutput& out, const char*& args)
+{
+    if constexpr (Layout.literal_lengths[I] > 0) {
+        if (!out.append(Layout.literals + Layout.literal_offsets[I], Layout.literal_lengths[I]))
+            return false;
+    }
+
+    constexpr ParamType type = Layout.param_types[I];
+    if constexpr (type == ParamType::kDYNAMIC_WIDTH || type == ParamType::kDYNAMIC_PRECISION) {
+        T value;
+        memcpy(&value, args, sizeof(T));
+        args += sizeof(T);
+        out.dynamic_args[Layout.num_dynamic[I]] = static_cast<int>(value);
+        return true;
+    } else if constexpr (type > ParamType::kNON_STRING) {
+        uint64_t len;
+        args = decodeVarint(args, &len);
+        const char* str = args;
+        args += len;
+        if constexpr (Layout.plain_string[I])
+            return out.append(str, len);
+        else if constexpr (Layout.dynamic_width[I])
+            return out.print(Layout.specs[I], out.dynamic_args[0], static_cast<int>(len), str);
+        else
+            return out.print(Layout.specs[I], static_cast<int>(len), str);
+    } else {
+        // Strings printed with %p are stored as void pointers
+        using Stored = typename std::conditional<std::is_pointer<T>::value, const void*, T>::type;
+        Stored value;
+        memcpy(&value, args, sizeof(Stored));
+        args += sizeof(Stored);
+
+        constexpr FormatSpec spec = Layout.format_specs[I];
+        if constexpr ((std::is_integral<T>::value || std::is_enum<T>::value)
+                      && isIntegerConversion(spec.conversion)
+                      && !(spec.conversion == 'c' && spec.length != 0)) {
+            uint64_t magnitude;
+            bool negative;
+            toPrintfInteger(spec.length, spec.conversion, integerBits(value), magnitude, negative);
+            int width = spec.dynamic_width ? out.dynamic_args[0] : spec.width;
+            int precision = spec.dynamic_precision ? out.dynamic_args[Layout.num_dynamic[I] - 1]
+                                                   : spec.precision;
+            return out.printInteger(spec, width, precision, magnitude, negative);
+        }
+
+        if constexpr ((std::is_same<T, double>::value || std::is_same<T, float>::value)
+                      && isFloatConversion(spec.conversion)) {
+            int width = spec.dynamic_width ? out.dynamic_args[0] : spec.width;
+            int precision = spec.dynamic_precision ? out.dynamic_args[Layout.num_dynamic[I] - 1]
+                                                   : spec.precision;
+            bool supported;
+            if (!out.printFloat(spec, width, precision, value, supported))
+                return false;
+            if (supported)
+                return true;
+        }
+
+        if constexpr (Layout.num_dynamic[I] == 0)
+            return out.print(Layout.specs[I], value);
+        else if constexpr (Layout.num_dynamic[I] == 1)
+            return out.print(Layout.specs[I], out.dynamic_args[0], value);
+        else
+            return out.print(Layout.specs[I], out.dynamic_args[0], out.dynamic_args[1], value);
+    }
+}
+
+template<const auto& Layout, typename... Ts, size_t... I>
+inline bool
+formatParams(FormatOutput& out, const char* args, ArgTypeList<Ts...>, std::index_sequence<I...>)
+{
+    return (formatParam<Layout, I, Ts>(out, args) && ...);
+}
+
+/**
+ * Formatter of a call site, see FormatFunction. Instantiated by STATIC_LOG
+ * for each call site so the backend renders a message with straight-line
+ * code instead of parsing the format string.
+ */
+template<const auto& Layout, typename... Ts>
+int
+formatArguments(const char* args, char*& log_buffer, size_t& buflen, size_t start_pos)
+{
+    FormatOutput out{log_buffer, buflen, start_pos, {0, 0}};
+    if (!formatParams<Layout>(out, args, ArgTypeList<Ts...>{}, std::index_sequence_for<Ts...>{}))
+        return -1;
+    constexpr int tail = Layout.num_params;
+    if (!out.append(Layout.literals + Layout.literal_offsets[tail], Layout.literal_lengths[tail]))
+        return -1;
+    return static_cast<int>(out.pos);
+}
+
+/**
+ * Whether an argument of type T is stored the way formatParam reads it for
+ * a parameter of the given type.
+ */
+template<typename T>
+constexpr bool
+argMatchesParam(ParamType type)
+{
+    if (type == ParamType::kDYNAMIC_WIDTH || type == ParamType::kDYNAMIC_PRECISION)
+        return std::is_integral<T>::value;
+    if (type > ParamType::kNON_STRING)
+        return std::is_same<T, const char*>::value || std::is_same<T, char*>::value;
+    return std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value;
+}
+
+template<const auto& Layout, typename... Ts, size_t... I>
+constexpr bool
+argsMatchLayout(ArgTypeList<Ts...>, std::index_sequence<I...>)
+{
+    return (argMatchesParam<Ts>(Layout.param_types[I]) && ...);
+}
+
+/**
+ * Returns the formatter generated for a call site, or nullptr when the
+ * arguments do not match the format string (reported by the printf format
+ * checker) or a specifier is too long, in which case the message is
+ * formatted by parsing the format string at runtime.
+ *
+ * \tparam Layout
+ *      FormatLayout of the call site, must have static storage duration
+ * \tparam Ts
+ *      Types of the arguments, see argTypeList
+ */
+template<const auto& Layout, typename... Ts>
+constexpr FormatFunction
+getFormatFunction(ArgTypeList<Ts...>)
+{
+    if constexpr (Layout.valid && sizeof...(Ts) == Layout.num_params
+                  && argsMatchLayout<Layout>(ArgTypeList<Ts...>{}, std::index_sequence_for<Ts...>{}))
+        return &formatArguments<Layout, Ts...>;
+    else
+        return nullptr;
+}
+
+} // details
+
+} // static_log
+
+#endif // STATIC_LOG_FORMATTER_H
@@ -53,6 +53,14 @@ enum ParamType:  int32_t {
     kSTRING = 0
 };
 
+/**
+ * Renders the arguments of a log message after the prefix already written to
+ * log_buffer[0, start_pos), growing log_buffer if needed. Returns the end of
+ * the message within log_buffer, or -1 on failure.
+ */
+typedef int (*FormatFunction)(const char* args, char*& log_buffer,
+                              size_t& buflen, size_t start_pos);
+
 /**
  * Describes the type of static information that will be printed in log
  * 
@@ -61,16 +69,22 @@ struct StaticInfo {
     constexpr StaticInfo(
         const int num_params,
         const ParamType* param_types,
+        const size_t* arg_sizes,
         const char* format,
         const static_log::LogLevels::LogLevel log_level,
         const char* function_name,
-        const uint64_t line
+        const char* file_name,
+        const uint64_t line,
+        FormatFunction format_function = nullptr
     ):num_params(num_params),
     param_types(param_types),
+    arg_sizes(arg_sizes),
     format(format),
     log_level(log_level),
     function_name(function_name),
-    line(line)
+    file_name(file_name),
+    line(line),
+    format_function(format_function)
     {}
     // Number of arguments required for the log invocation
     const int num_params;
@@ -80,6 +94,10 @@ struct StaticInfo {
     // printf log message invocation
     const ParamType* param_types;
 
+    // Size of each argument as passed to the log invocation, known at
+    // compile time. Unused for strings, which are stored with their length.
+    const size_t* arg_sizes;
+
     // printf format string associated with the log invocation
     const char* format;
 
@@ -89,29 +107,51 @@ struct StaticInfo {
     // function name
     const char* function_name;
 
+    // Source file, as given to the compiler
+    const char* file_name;
+
     // Log print line number
     const uint64_t line;
+
+    // Formatter generated for the call site at compile time, see
+    // getFormatFunction. Null when the arguments have to be formatted by
+    // parsing the format string at runtime, e.g. in the offline decoder.
+    const FormatFunction format_function;
 };
 
+/**
+ * Header of a log message in a StagingBuffer. It is followed by the
+ * timestamp, encoded as the zigzag varint difference with the timestamp
+ * of the previous entry of the same StagingBuffer (the raw TSC value read
+ * at the call site, converted to wall-clock time by the backend, see
+ * TscClock), and then by the arguments.
+ */
 struct LogEntry {
-    LogEntry(const StaticInfo* static_info, const size_t* param_size): 
-        static_info(static_info),
-        param_size(param_size)
-    {}
+    // Id assigned to the call site at its first use, see
+    // StaticLogBackend::registerCallsite
+    uint32_t callsite_id;
+    // Size of the whole entry, header included
+    uint32_t entry_size;
+};
 
-    // The time at which the log was recorded
-    //  Since it is an asynchronous log, this 
-    // time is not the call log time, but the 
-    // time of background processing
-    uint64_t timestamp;
-    // log buffer size
-    uint64_t entry_size;
-
-    const StaticInfo* static_info;
-    // parameter size array
-    const size_t* param_size;
+/**
+ * Types of the arguments of a log invocation, so that their sizes and the
+ * formatter of the call site can be derived at compile time from the
+ * argument expressions without evaluating them, see argTypeList.
+ */
+template<typename... Ts>
+struct ArgTypeList {
+    // One extra element so that the array is never empty
+    static constexpr size_t sizes[sizeof...(Ts) + 1] = {sizeof(Ts)..., 0};
 };
 
+/**
+ * Only used in decltype(argTypeList(args...)), the arguments are taken by
+ * value like getArgSize and storeArgument do so arrays decay to pointers.
+ */
+template<typename... Ts>
+ArgTypeList<Ts...> argTypeList(Ts...);
+
 /**
  * No-Op function that triggers the GNU preprocessor's format checker for
  * printf format strings and argument parameters.
@@ -506,7 +546,7 @@ getArgSize(const ParamType fmt_type,
  * String specialization for getArgSize. Returns the number of bytes needed
  * to represent a string (with consideration for any 'precision' specifiers
  * in the original format string and) without a NULL terminator and with a
- * uint32_t length.
+ * varint length.
  *
  * \param fmt_type
  *      Type of the argument according to the original printf-like format
@@ -520,7 +560,7 @@ getArgSize(const ParamType fmt_type,
  * \param str
  *      String to compute the length for
  * \return
- *      Length of the string str with a uint32_t length and no NULL terminator
+ *      Length of the string str with a varint length and no NULL terminator
  */
 inline size_t
 getArgSize(const ParamType fmt_type,
@@ -532,7 +572,7 @@ getArgSize(const ParamType fmt_type,
         return sizeof(void*);
     
     string_size = strlen(str);
-    uint32_t fmt_length = static_cast<uint32_t>(string_size);
+    uint32_t fmt_length = static_cast<uint32_t>(fmt_type);
 
     // Strings with static length specifiers (ex %.10s), have non-negative
     // ParamTypes equal to the static length. Thus, we use that value to
@@ -546,7 +586,7 @@ getArgSize(const ParamType fmt_type,
                 string_size > previous_precision)
         string_size = previous_precision;
 
-    return string_size + sizeof(uint32_t);
+    return string_size + varintSize(string_size);
 }
 
 /**
@@ -555,7 +595,7 @@ getArgSize(const ParamType fmt_type,
  * store all the arguments.
  *
  * For the most part, all non-string arguments will be calculated as full
- * width and the all string arguments will have a 32-bit length descriptor
+ * width and the all string arguments will have a varint length descriptor
  * and no NULL terminator.
  *
  * \tparam arg_num
@@ -578,7 +618,7 @@ getArgSize(const ParamType fmt_type,
  *      argument encountered (as dictated by argFmtTypes).
  * \param[out] string_sizes
  *      Stores the lengths of string arguments without a NULL terminator
- *      and with a 32-bit length descriptor
+ *      and with their varint length
  * \param head
  *      First of the argument pack
  * \param rest
@@ -616,7 +656,7 @@ getArgSizes(const std::array<ParamType, N>&, uint64_t &, size_t(&)[M])
  * Stores a single printf argument into a buffer and bumps the buffer pointer.
  *
  * Non-string types are stored (full-width) and string types are stored
- * with a uint32_t header describing the string length in bytes followed
+ * with a varint header describing the string length in bytes followed
  * by the string itself with no NULL terminator.
  *
  * Note: This is the non-string specialization of the function
@@ -685,9 +725,7 @@ storeArgument(char **storage,
     {
         throw std::invalid_argument("Strings larger than std::numeric_limits<uint32_t>::max() are unsupported");
     }
-    auto size = static_cast<uint32_t>(string_size);
-    memcpy(*storage, &size, sizeof(uint32_t));
-    *storage += sizeof(uint32_t);
+    *storage = encodeVarint(*storage, string_size);
 
 #ifdef ENABLE_DEBUG_PRINTING
 #pragma GCC diagnostic push
@@ -782,4 +820,7 @@ downCast(const Large& large)
 
 } // namespace static_log
 
+// The formatters generated for the call sites build on everything above
+#include "static_log_formatter.h"
+
 #endif // STATIC_LOG_INTERNAL_H
\ No newline at end of file
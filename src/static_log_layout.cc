@@ -0,0 +1,141 @@
+#include "static_log_layout.h"
+#include "static_log_internal.h"
+#include "static_log_timestamp.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace static_log {
+
+namespace details {
+
+static const char* log_level_str[] = {
+    "non",
+    "error",
+    "warn",
+    "notice",
+    "debug"
+};
+
+// Longest rendering of a 32-bit id
+#define MAX_ID_LEN 10
+
+LineLayout::LineLayout():
+    pattern_(),
+    ops_(),
+    literals_()
+{
+    compile(DEFAULT_LOG_PATTERN);
+}
+
+bool
+LineLayout::compile(const char* pattern)
+{
+    std::vector<LayoutOp> ops;
+    std::string literals;
+    auto appendLiteral = [&](const char* text, size_t len) {
+        // Adjacent text is merged into one op
+        if (!ops.empty() && ops.back().type == LayoutOp::kLITERAL)
+            ops.back().length += len;
+        else
+            ops.push_back(LayoutOp{LayoutOp::kLITERAL, (uint32_t)literals.size(), (uint32_t)len});
+        literals.append(text, len);
+    };
+
+    for (const char* pos = pattern; *pos != '\0'; ++pos) {
+        if (*pos != '%') {
+            appendLiteral(pos, 1);
+            continue;
+        }
+        LayoutOp::Type type;
+        switch (*++pos) {
+        case '%': appendLiteral(pos, 1); continue;
+        case 'T': type = LayoutOp::kTIMESTAMP; break;
+        case 'l': type = LayoutOp::kLEVEL; break;
+        case 't': type = LayoutOp::kTHREAD_ID; break;
+        case 'P': type = LayoutOp::kPID; break;
+        case 'f': type = LayoutOp::kFILE; break;
+        case 's': type = LayoutOp::kFILE_BASENAME; break;
+        case 'F': type = LayoutOp::kFUNCTION; break;
+        case 'L': type = LayoutOp::kLINE; break;
+        case 'v': type = LayoutOp::kMESSAGE; break;
+        default:
+            fprintf(stderr, "Unknown field '%%%.1s' in log pattern \"%s\"\n", pos, pattern);
+            return false;
+        }
+        ops.push_back(LayoutOp{type, 0, 0});
+    }
+
+    pattern_ = pattern;
+    ops_ = std::move(ops);
+    literals_ = std::move(literals);
+    return true;
+}
+
+CallsiteLayout
+LineLayout::bind(const StaticInfo* static_info, uint32_t pid) const
+{
+    CallsiteLayout layout;
+    auto appendText = [&](const char* text, size_t len) {
+        if (!layout.ops.empty() && layout.ops.back().type == LayoutOp::kLITERAL)
+            layout.ops.back().length += len;
+        else
+            layout.ops.push_back(LayoutOp{LayoutOp::kLITERAL, (uint32_t)layout.text.size(), (uint32_t)len});
+        layout.text.append(text, len);
+        layout.max_prefix_len += len;
+    };
+    auto appendNumber = [&](uint64_t value) {
+        char number[24];
+        int len = snprintf(number, sizeof(number), "%lu", value);
+        appendText(number, len);
+    };
+
+    for (const LayoutOp& op : ops_) {
+        switch (op.type) {
+        case LayoutOp::kLITERAL:
+            appendText(literals_.data() + op.offset, op.length);
+            break;
+        case LayoutOp::kLEVEL: {
+            const char* level = log_level_str[(uint32_t)static_info->log_level];
+            appendText(level, strlen(level));
+            break;
+        }
+        case LayoutOp::kPID:
+            appendNumber(pid);
+            break;
+        case LayoutOp::kFILE:
+            appendText(static_info->file_name, strlen(static_info->file_name));
+            break;
+        case LayoutOp::kFILE_BASENAME: {
+            const char* base = strrchr(static_info->file_name, '/');
+            base = base == NULL ? static_info->file_name : base + 1;
+            appendText(base, strlen(base));
+            break;
+        }
+        case LayoutOp::kFUNCTION:
+            appendText(static_info->function_name, strlen(static_info->function_name));
+            break;
+        case LayoutOp::kLINE:
+            appendNumber(static_info->line);
+            break;
+        case LayoutOp::kTIMESTAMP:
+            layout.ops.push_back(op);
+            layout.max_prefix_len += MAX_TIMESTAMP_LEN;
+            break;
+        case LayoutOp::kTHREAD_ID:
+            layout.ops.push_back(op);
+            layout.max_prefix_len += MAX_ID_LEN;
+            break;
+        case LayoutOp::kMESSAGE:
+            layout.ops.push_back(op);
+            break;
+        }
+    }
+    return layout;
+}
+
+} // details
+
+} // static_log
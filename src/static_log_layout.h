@@ -0,0 +1,105 @@
+#ifndef STATIC_LOG_LAYOUT_H
+#define STATIC_LOG_LAYOUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+namespace static_log {
+namespace details {
+
+struct StaticInfo;
+
+// Pattern of the lines written before setLogPattern is called,
+// [2026-10-16-14:07:57.581963213][notice][main][42]message
+#define DEFAULT_LOG_PATTERN "[%T][%l][%F][%L]%v"
+
+/**
+* Operation of a compiled line layout, see LineLayout
+*/
+struct LayoutOp {
+    enum Type : uint8_t {
+        // Copies length bytes of text at offset
+        kLITERAL = 0,
+        kTIMESTAMP,
+        kLEVEL,
+        kTHREAD_ID,
+        kPID,
+        kFILE,
+        kFILE_BASENAME,
+        kFUNCTION,
+        kLINE,
+        kMESSAGE
+    };
+
+    Type     type;
+    uint32_t offset;
+    uint32_t length;
+};
+
+/**
+* Layout of the lines of one call site, produced by LineLayout::bind. The
+* fields that are the same for all its lines are already rendered into
+* text, only kLITERAL, kTIMESTAMP, kTHREAD_ID and kMESSAGE ops are left.
+*/
+struct CallsiteLayout {
+    std::vector<LayoutOp> ops;
+    std::string text;
+    // Longest rendering of the ops other than kMESSAGE
+    size_t max_prefix_len = 0;
+};
+
+/**
+* Line layout compiled from a pattern in which each field is a '%' followed
+* by a letter, everything else is copied as is:
+*   %T  timestamp, see TimestampFormat
+*   %l  level name
+*   %t  id of the logging thread
+*   %P  process id
+*   %f  source file, as given to the compiler
+*   %s  source file without its directories
+*   %F  function
+*   %L  line
+*   %v  message
+*   %%  '%'
+* The pattern is parsed once by compile(), the backend then only runs the
+* ops of each call site, see bind.
+*/
+class LineLayout {
+public:
+    LineLayout();
+
+    /**
+    * Parses a pattern into ops
+    *
+    * \return
+    *   false if the pattern holds an unknown field, the layout is left
+    *   unchanged
+    */
+    bool compile(const char* pattern);
+
+    const std::string& getPattern() const { return pattern_; }
+
+    /**
+    * Renders the fields of the layout that are constant for a call site
+    *
+    * \param static_info
+    *   Static information of the call site
+    * \param pid
+    *   Process that logged the messages
+    */
+    CallsiteLayout bind(const StaticInfo* static_info, uint32_t pid) const;
+
+private:
+    std::string pattern_;
+    std::vector<LayoutOp> ops_;
+    // Text of the kLITERAL ops
+    std::string literals_;
+};
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_LAYOUT_H
@@ -0,0 +1,95 @@
+#include "static_log_memory.h"
+#include "static_log.h"
+#include "static_log_numa.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <atomic>
+
+namespace static_log {
+namespace details {
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+/**
+ * Size of the mapping of a store, a whole number of huge pages when they
+ * were requested, even if the mapping fell back to regular pages, so that
+ * freeStagingMemory unmaps the same length
+ */
+static size_t
+mappingLength(size_t capacity, uint32_t flags)
+{
+    size_t page_size = (flags & kSTAGING_HUGEPAGES) ? HUGE_PAGE_SIZE : (size_t)sysconf(_SC_PAGESIZE);
+    return (capacity + page_size - 1) / page_size * page_size;
+}
+
+StagingMemory
+allocateStagingMemory(size_t capacity, uint32_t flags, int node)
+{
+    StagingMemory memory{nullptr, capacity, flags, node};
+    if (flags == kSTAGING_MALLOC) {
+        memory.data = (char*)malloc(capacity);
+        return memory;
+    }
+
+    // The pages are faulted in after the node preference is set
+    bool numa = getNumaNodes().size() > 1;
+    int populate = (flags & kSTAGING_PREFAULT) && !numa ? MAP_POPULATE : 0;
+    bool touch = (flags & kSTAGING_PREFAULT) && !populate;
+    size_t length = mappingLength(capacity, flags);
+    void* storage = MAP_FAILED;
+    if (flags & kSTAGING_HUGEPAGES) {
+        // Reserved huge pages first, the mapping fails when there are none
+        storage = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+        if (storage == MAP_FAILED) {
+            // Transparent huge pages, they are only used for the pages
+            // faulted in after the madvise()
+            storage = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (storage == MAP_FAILED)
+                return memory;
+            madvise(storage, length, MADV_HUGEPAGE);
+            touch = flags & kSTAGING_PREFAULT;
+        }
+    } else {
+        storage = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | populate, -1, 0);
+        if (storage == MAP_FAILED)
+            return memory;
+    }
+
+    if (numa)
+        preferNumaNode(storage, length, node);
+    if (touch) {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < length; offset += page_size)
+            ((volatile char*)storage)[offset] = 0;
+    }
+
+    if ((flags & kSTAGING_MLOCK) && mlock(storage, length) != 0) {
+        // Usually RLIMIT_MEMLOCK, the store is still usable
+        static std::atomic<bool> warned{false};
+        if (!warned.exchange(true))
+            perror("Failed to lock a staging buffer in memory");
+    }
+    memory.data = (char*)storage;
+    return memory;
+}
+
+void
+freeStagingMemory(const StagingMemory& memory)
+{
+    if (memory.data == nullptr)
+        return;
+    if (memory.flags == kSTAGING_MALLOC)
+        free(memory.data);
+    else
+        munmap(memory.data, mappingLength(memory.capacity, memory.flags));
+}
+
+} // details
+} // static_log
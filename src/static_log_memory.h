@@ -0,0 +1,47 @@
+#ifndef STATIC_LOG_MEMORY_H
+#define STATIC_LOG_MEMORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace static_log {
+namespace details {
+
+/**
+ * Backing store of a StagingBuffer
+ */
+struct StagingMemory {
+    char*    data;
+    size_t   capacity;
+    // StagingMemoryFlags it was allocated with
+    uint32_t flags;
+    // NUMA node it was allocated for
+    int      node;
+};
+
+/**
+ * Allocates the backing store of a StagingBuffer
+ *
+ * \param capacity
+ *      Size of the store in bytes
+ * \param flags
+ *      StagingMemoryFlags, kSTAGING_MALLOC uses malloc(), anything else
+ *      maps the store with mmap()
+ * \param node
+ *      NUMA node of the logging thread. A mapped store prefers it, the
+ *      pages of a malloc()ed one go to the node of the thread that first
+ *      writes them, which is the logging thread as well.
+ * \return
+ *      A store whose data is nullptr if the allocation failed
+ */
+StagingMemory allocateStagingMemory(size_t capacity, uint32_t flags, int node);
+
+/**
+ * Releases a store returned by allocateStagingMemory
+ */
+void freeStagingMemory(const StagingMemory& memory);
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_MEMORY_H
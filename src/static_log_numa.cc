@@ -0,0 +1,127 @@
+#include "static_log_numa.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+
+namespace static_log {
+namespace details {
+
+#define NUMA_SYSFS_DIR "/sys/devices/system/node"
+
+// From <numaif.h>, which comes with libnuma
+#define STATIC_LOG_MPOL_PREFERRED 1
+
+/**
+ * Parses a sysfs CPU list, e.g. "0-3,8-11"
+ */
+static std::vector<int>
+parseCpuList(const char* list)
+{
+    std::vector<int> cpus;
+    const char* pos = list;
+    while (*pos != '\0' && *pos != '\n') {
+        char* end;
+        long first = strtol(pos, &end, 10);
+        if (end == pos)
+            break;
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back((int)cpu);
+        pos = *end == ',' ? end + 1 : end;
+    }
+    return cpus;
+}
+
+static std::vector<NumaNode>
+readNumaNodes()
+{
+    std::vector<NumaNode> nodes;
+    DIR* dir = opendir(NUMA_SYSFS_DIR);
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            int id;
+            if (sscanf(entry->d_name, "node%d", &id) != 1)
+                continue;
+            char path[128];
+            snprintf(path, sizeof(path), NUMA_SYSFS_DIR "/node%d/cpulist", id);
+            FILE* file = fopen(path, "r");
+            if (file == NULL)
+                continue;
+            char list[4096] = {0};
+            if (fgets(list, sizeof(list), file) != NULL) {
+                std::vector<int> cpus = parseCpuList(list);
+                // Memory-only nodes run no thread
+                if (!cpus.empty())
+                    nodes.push_back(NumaNode{id, cpus});
+            }
+            fclose(file);
+        }
+        closedir(dir);
+    }
+    std::sort(nodes.begin(), nodes.end(),
+              [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+
+    if (nodes.empty()) {
+        NumaNode node{0, {}};
+        long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+        for (long cpu = 0; cpu < num_cpus; ++cpu)
+            node.cpus.push_back((int)cpu);
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+const std::vector<NumaNode>&
+getNumaNodes()
+{
+    static const std::vector<NumaNode> nodes = readNumaNodes();
+    return nodes;
+}
+
+int
+currentNumaNode()
+{
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+        return 0;
+    return (int)node;
+}
+
+bool
+preferNumaNode(void* addr, size_t length, int node)
+{
+    if (node < 0 || node >= (int)(sizeof(unsigned long) * 8))
+        return false;
+    unsigned long mask = 1UL << node;
+    return syscall(SYS_mbind, addr, length, STATIC_LOG_MPOL_PREFERRED,
+                   &mask, sizeof(mask) * 8, 0) == 0;
+}
+
+bool
+bindThreadToNumaNode(int node)
+{
+    for (const NumaNode& numa_node : getNumaNodes()) {
+        if (numa_node.id != node)
+            continue;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (int cpu : numa_node.cpus)
+            CPU_SET(cpu, &mask);
+        return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+    }
+    return false;
+}
+
+} // details
+} // static_log
@@ -0,0 +1,53 @@
+#ifndef STATIC_LOG_NUMA_H
+#define STATIC_LOG_NUMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+namespace static_log {
+namespace details {
+
+/**
+ * A NUMA node and its CPUs
+ */
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+/**
+ * Nodes of the machine, read from sysfs once. A machine without NUMA
+ * support is reported as node 0 holding all the CPUs.
+ */
+const std::vector<NumaNode>& getNumaNodes();
+
+/**
+ * Node of the CPU the calling thread runs on
+ */
+int currentNumaNode();
+
+/**
+ * Makes the pages of a mapping not yet faulted in prefer a node, the
+ * kernel falls back to the other nodes when it is full
+ *
+ * \param addr
+ *      Start of the mapping, page aligned
+ * \return
+ *      false if the policy could not be set
+ */
+bool preferNumaNode(void* addr, size_t length, int node);
+
+/**
+ * Restricts the calling thread to the CPUs of a node
+ *
+ * \return
+ *      false if the affinity could not be set
+ */
+bool bindThreadToNumaNode(int node);
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_NUMA_H
@@ -0,0 +1,582 @@
+#include "static_log_number.h"
+
+#include <string.h>
+
+#include <array>
+#include <cmath>
+
+namespace static_log {
+
+namespace details {
+
+// Longest digit string of a 64-bit value, in octal
+#define MAX_INTEGER_DIGITS 22
+
+// Longest formatFloat output without the sign and the padding: 39 integer
+// digits, the point, 38 decimals and an exponent
+#define MAX_FLOAT_BODY 96
+
+// Largest precision formatFloat handles, 10^(precision + 1) has to fit in
+// 128 bits
+#define MAX_FLOAT_PRECISION 37
+
+typedef unsigned __int128 uint128_t;
+
+static const char kDECIMAL_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Two hex digits for each byte value
+static constexpr std::array<char, 512>
+makeHexPairs(const char* digits)
+{
+    std::array<char, 512> pairs{};
+    for (int i = 0; i < 256; ++i) {
+        pairs[2 * i] = digits[i >> 4];
+        pairs[2 * i + 1] = digits[i & 15];
+    }
+    return pairs;
+}
+
+static constexpr std::array<char, 512> kHEX_PAIRS = makeHexPairs("0123456789abcdef");
+static constexpr std::array<char, 512> kUPPER_HEX_PAIRS = makeHexPairs("0123456789ABCDEF");
+
+static constexpr std::array<uint128_t, 39>
+makePowersOf10()
+{
+    std::array<uint128_t, 39> powers{};
+    uint128_t power = 1;
+    for (auto& p : powers) {
+        p = power;
+        power *= 10;
+    }
+    return powers;
+}
+
+// All the powers of 10 that fit in 128 bits
+static constexpr std::array<uint128_t, 39> kPOW10 = makePowersOf10();
+
+// The functions below write the digits of value right to left ending at end
+// and return the first digit
+
+static inline char*
+writeDecimal(char* end, uint64_t value)
+{
+    while (value >= 100) {
+        uint64_t pair = value % 100;
+        value /= 100;
+        end -= 2;
+        memcpy(end, kDECIMAL_PAIRS + 2 * pair, 2);
+    }
+    if (value >= 10) {
+        end -= 2;
+        memcpy(end, kDECIMAL_PAIRS + 2 * value, 2);
+    } else {
+        *--end = static_cast<char>('0' + value);
+    }
+    return end;
+}
+
+static inline char*
+writeHex(char* end, uint64_t value, const char* pairs)
+{
+    while (value >= 256) {
+        end -= 2;
+        memcpy(end, pairs + 2 * (value & 0xff), 2);
+        value >>= 8;
+    }
+    if (value >= 16) {
+        end -= 2;
+        memcpy(end, pairs + 2 * value, 2);
+    } else {
+        *--end = pairs[2 * value + 1];
+    }
+    return end;
+}
+
+static inline char*
+writeDecimal128(char* end, uint128_t value)
+{
+    // 19 digits at a time
+    while (value > UINT64_MAX) {
+        uint64_t low = static_cast<uint64_t>(value % kPOW10[19]);
+        value /= kPOW10[19];
+        char* begin = writeDecimal(end, low);
+        while (end - begin < 19)
+            *--begin = '0';
+        end = begin;
+    }
+    return writeDecimal(end, static_cast<uint64_t>(value));
+}
+
+static inline char*
+writeOctal(char* end, uint64_t value)
+{
+    do {
+        *--end = static_cast<char>('0' + (value & 7));
+        value >>= 3;
+    } while (value != 0);
+    return end;
+}
+
+/**
+ * Writes sign, prefix, zeros and digits padded with spaces to width, or
+ * with zeros between the prefix and the digits if zero_pad is set.
+ *
+ * \return
+ *      Length of the field, nothing is written if it exceeds capacity
+ */
+static size_t
+writeField(char* dst, size_t capacity, int width, bool left_align, bool zero_pad,
+           char sign, const char* prefix, size_t zeros, const char* digits, size_t num_digits)
+{
+    size_t prefix_len = prefix != NULL ? strlen(prefix) : 0;
+    size_t len = (sign != 0) + prefix_len + zeros + num_digits;
+    size_t padding = static_cast<size_t>(width) > len ? width - len : 0;
+    size_t total = len + padding;
+    if (total > capacity)
+        return total;
+
+    if (zero_pad && !left_align) {
+        zeros += padding;
+        padding = 0;
+    }
+
+    if (!left_align) {
+        memset(dst, ' ', padding);
+        dst += padding;
+    }
+    if (sign != 0)
+        *dst++ = sign;
+    if (prefix != NULL) {
+        memcpy(dst, prefix, prefix_len);
+        dst += prefix_len;
+    }
+    memset(dst, '0', zeros);
+    dst += zeros;
+    memcpy(dst, digits, num_digits);
+    dst += num_digits;
+    if (left_align)
+        memset(dst, ' ', padding);
+    return total;
+}
+
+size_t
+formatInteger(char* dst, size_t capacity, const FormatSpec& spec,
+              int width, int precision, uint64_t magnitude, bool negative)
+{
+    bool left_align = spec.left_align;
+    if (width < 0) {
+        left_align = true;
+        width = -width;
+    }
+
+    char digits[MAX_INTEGER_DIGITS];
+    char* end = digits + MAX_INTEGER_DIGITS;
+    char* begin = end;
+    char sign = 0;
+    const char* prefix = NULL;
+    size_t zeros = 0;
+
+    if (spec.conversion == 'c') {
+        *--begin = static_cast<char>(magnitude);
+    } else {
+        // A zero precision prints no digit for 0
+        if (magnitude != 0 || precision != 0) {
+            switch (spec.conversion) {
+            case 'x':
+                begin = writeHex(end, magnitude, kHEX_PAIRS.data());
+                break;
+            case 'X':
+                begin = writeHex(end, magnitude, kUPPER_HEX_PAIRS.data());
+                break;
+            case 'o':
+                begin = writeOctal(end, magnitude);
+                break;
+            default:
+                begin = writeDecimal(end, magnitude);
+                break;
+            }
+        }
+
+        size_t num_digits = end - begin;
+        if (precision > 0 && static_cast<size_t>(precision) > num_digits)
+            zeros = precision - num_digits;
+
+        if (isSignedConversion(spec.conversion)) {
+            if (negative)
+                sign = '-';
+            else if (spec.plus_sign)
+                sign = '+';
+            else if (spec.space_sign)
+                sign = ' ';
+        }
+
+        if (spec.alternate) {
+            // The first digit of an alternate octal is always a 0
+            if (spec.conversion == 'o' && zeros == 0 && (begin == end || *begin != '0'))
+                zeros = 1;
+            else if (spec.conversion == 'x' && magnitude != 0)
+                prefix = "0x";
+            else if (spec.conversion == 'X' && magnitude != 0)
+                prefix = "0X";
+        }
+    }
+
+    // The '0' flag is ignored with a precision
+    bool zero_pad = spec.zero_pad && precision < 0 && spec.conversion != 'c';
+    return writeField(dst, capacity, width, left_align, zero_pad, sign, prefix,
+                      zeros, begin, end - begin);
+}
+
+static inline int
+bitLength(uint128_t value)
+{
+    uint64_t high = static_cast<uint64_t>(value >> 64);
+    uint64_t low = static_cast<uint64_t>(value);
+    if (high != 0)
+        return 128 - __builtin_clzll(high);
+    return low != 0 ? 64 - __builtin_clzll(low) : 0;
+}
+
+/**
+ * Computes mantissa * 2^exponent * 10^scale rounded to the nearest integer,
+ * ties to even like printf, or truncated.
+ *
+ * \return
+ *      false if an intermediate value does not fit in 128 bits
+ */
+static bool
+scaleRounded(uint64_t mantissa, int exponent, int scale, uint128_t* result,
+             bool round = true)
+{
+    uint128_t num = mantissa;
+    if (exponent > 0) {
+        if (bitLength(num) + exponent > 127)
+            return false;
+        num <<= exponent;
+    }
+    if (scale > 0 && (scale >= static_cast<int>(kPOW10.size())
+                      || __builtin_mul_overflow(num, kPOW10[scale], &num)))
+        return false;
+
+    if (scale >= 0) {
+        if (exponent >= 0) {
+            *result = num;
+            return true;
+        }
+        // Below half of the divisor
+        if (-exponent >= 128) {
+            *result = 0;
+            return true;
+        }
+        int shift = -exponent;
+        uint128_t quotient = num >> shift;
+        uint128_t remainder = num & ((static_cast<uint128_t>(1) << shift) - 1);
+        uint128_t half = static_cast<uint128_t>(1) << (shift - 1);
+        if (round && (remainder > half || (remainder == half && (quotient & 1))))
+            quotient++;
+        *result = quotient;
+        return true;
+    }
+
+    if (-scale >= static_cast<int>(kPOW10.size()))
+        return false;
+    uint128_t den = kPOW10[-scale];
+    if (exponent < 0) {
+        if (bitLength(den) - exponent > 127)
+            return false;
+        den <<= -exponent;
+    }
+    uint128_t quotient = num / den;
+    uint128_t remainder = num - quotient * den;
+    if (round && (remainder > den - remainder
+                  || (remainder == den - remainder && (quotient & 1))))
+        quotient++;
+    *result = quotient;
+    return true;
+}
+
+/**
+ * Writes the %f representation of mantissa * 2^exponent with precision
+ * decimals.
+ *
+ * \return
+ *      Length written to body, 0 if the value is left to snprintf
+ */
+static size_t
+writeFixed(char* body, uint64_t mantissa, int exponent, int precision, bool alternate)
+{
+    uint128_t scaled;
+    if (!scaleRounded(mantissa, exponent, precision, &scaled))
+        return 0;
+
+    char digits[40];
+    char* end = digits + sizeof(digits);
+    char* begin = writeDecimal128(end, scaled);
+    // At least one integer digit
+    while (end - begin < precision + 1)
+        *--begin = '0';
+
+    size_t int_len = end - begin - precision;
+    char* pos = body;
+    memcpy(pos, begin, int_len);
+    pos += int_len;
+    if (precision > 0 || alternate)
+        *pos++ = '.';
+    memcpy(pos, begin + int_len, precision);
+    pos += precision;
+    return pos - body;
+}
+
+/**
+ * Rounds mantissa * 2^exponent to precision + 1 significant digits.
+ *
+ * \param[out] digits
+ *      The significant digits
+ * \param[out] decimal_exponent
+ *      Exponent of the first digit
+ * \param[out] carried
+ *      Whether rounding incremented the exponent, as in 9.99 -> 1.0e+01
+ * \return
+ *      false if the value is left to snprintf
+ */
+static bool
+roundSignificant(uint64_t mantissa, int exponent, int precision,
+                 uint128_t* digits, int* decimal_exponent, bool* carried)
+{
+    *carried = false;
+    if (mantissa == 0) {
+        *digits = 0;
+        *decimal_exponent = 0;
+        return true;
+    }
+
+    // floor(log10(2^n)), the actual exponent is the same or one more, or
+    // one more again after rounding
+    int estimate = ((63 - __builtin_clzll(mantissa) + exponent) * 78913) >> 18;
+    for (int i = 0; i < 4; ++i) {
+        if (!scaleRounded(mantissa, exponent, precision - estimate, digits))
+            return false;
+        if (*digits >= kPOW10[precision + 1]) {
+            estimate++;
+        } else if (*digits < kPOW10[precision]) {
+            estimate--;
+        } else {
+            *decimal_exponent = estimate;
+            uint128_t truncated;
+            if (*digits == kPOW10[precision]
+                    && scaleRounded(mantissa, exponent, precision - estimate, &truncated, false))
+                *carried = truncated < kPOW10[precision];
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Writes the %e representation of significant digits, see roundSignificant.
+ *
+ * \return
+ *      Length written to body
+ */
+static size_t
+writeExponent(char* body, uint128_t significant, int decimal_exponent, int precision,
+              bool alternate, char exponent_char)
+{
+    char digits[40];
+    char* end = digits + sizeof(digits);
+    char* begin = writeDecimal128(end, significant);
+    while (end - begin < precision + 1)
+        *--begin = '0';
+
+    char* pos = body;
+    *pos++ = *begin;
+    if (precision > 0 || alternate)
+        *pos++ = '.';
+    memcpy(pos, begin + 1, precision);
+    pos += precision;
+
+    *pos++ = exponent_char;
+    *pos++ = decimal_exponent < 0 ? '-' : '+';
+    uint64_t magnitude = decimal_exponent < 0 ? -decimal_exponent : decimal_exponent;
+    // At least two digits
+    if (magnitude < 10)
+        *pos++ = '0';
+    char exp_digits[4];
+    char* exp_end = exp_digits + sizeof(exp_digits);
+    char* exp_begin = writeDecimal(exp_end, magnitude);
+    memcpy(pos, exp_begin, exp_end - exp_begin);
+    pos += exp_end - exp_begin;
+    return pos - body;
+}
+
+// Drops the trailing zeros of the fraction of body[0, len), and the point if
+// nothing is left after it, as %g does without the '#' flag
+static size_t
+stripTrailingZeros(char* body, size_t len)
+{
+    char* point = static_cast<char*>(memchr(body, '.', len));
+    if (point == NULL)
+        return len;
+    char* fraction_end = body + len;
+    char* exp = point;
+    while (exp < fraction_end && *exp != 'e' && *exp != 'E')
+        ++exp;
+    char* last = exp;
+    while (last > point + 1 && last[-1] == '0')
+        --last;
+    if (last == point + 1)
+        --last;
+    memmove(last, exp, fraction_end - exp);
+    return len - (exp - last);
+}
+
+/**
+ * Writes the %a representation of a normal or zero double without
+ * precision, the "0x" prefix excluded.
+ */
+static size_t
+writeHexFloat(char* body, uint64_t fraction, int biased_exponent, bool alternate, bool upper)
+{
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char* pos = body;
+    *pos++ = biased_exponent == 0 ? '0' : '1';
+    int num_digits = 13;
+    while (num_digits > 0 && (fraction & 0xf) == 0) {
+        fraction >>= 4;
+        num_digits--;
+    }
+    if (num_digits > 0 || alternate)
+        *pos++ = '.';
+    for (int i = num_digits - 1; i >= 0; --i)
+        *pos++ = digits[(fraction >> (4 * i)) & 0xf];
+
+    int exponent = biased_exponent == 0 ? 0 : biased_exponent - 1023;
+    *pos++ = upper ? 'P' : 'p';
+    *pos++ = exponent < 0 ? '-' : '+';
+    char exp_digits[4];
+    char* exp_end = exp_digits + sizeof(exp_digits);
+    char* exp_begin = writeDecimal(exp_end, exponent < 0 ? -exponent : exponent);
+    memcpy(pos, exp_begin, exp_end - exp_begin);
+    pos += exp_end - exp_begin;
+    return pos - body;
+}
+
+size_t
+formatFloat(char* dst, size_t capacity, const FormatSpec& spec,
+            int width, int precision, double value)
+{
+    if (!std::isfinite(value) || spec.length == 'L' || precision > MAX_FLOAT_PRECISION)
+        return kFORMAT_UNSUPPORTED;
+
+    bool left_align = spec.left_align;
+    if (width < 0) {
+        left_align = true;
+        width = -width;
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bool negative = bits >> 63;
+    int biased_exponent = (bits >> 52) & 0x7ff;
+    uint64_t fraction = bits & ((1ULL << 52) - 1);
+    uint64_t mantissa = fraction;
+    int exponent = -1074;
+    if (biased_exponent != 0) {
+        mantissa |= 1ULL << 52;
+        exponent = biased_exponent - 1075;
+    }
+    // Smaller operands extend the range of scaleRounded
+    if (mantissa != 0) {
+        int trailing_zeros = __builtin_ctzll(mantissa);
+        mantissa >>= trailing_zeros;
+        exponent += trailing_zeros;
+    }
+
+    char sign = 0;
+    if (negative)
+        sign = '-';
+    else if (spec.plus_sign)
+        sign = '+';
+    else if (spec.space_sign)
+        sign = ' ';
+
+    char body[MAX_FLOAT_BODY];
+    size_t body_len = 0;
+    const char* prefix = NULL;
+    bool upper = spec.conversion >= 'A' && spec.conversion <= 'Z';
+    switch (spec.conversion) {
+    case 'f':
+    case 'F':
+        body_len = writeFixed(body, mantissa, exponent, precision < 0 ? 6 : precision, spec.alternate);
+        break;
+    case 'e':
+    case 'E': {
+        if (precision < 0)
+            precision = 6;
+        uint128_t significant;
+        int decimal_exponent;
+        bool carried;
+        if (roundSignificant(mantissa, exponent, precision, &significant, &decimal_exponent,
+                             &carried))
+            body_len = writeExponent(body, significant, decimal_exponent, precision,
+                                     spec.alternate, upper ? 'E' : 'e');
+        break;
+    }
+    case 'g':
+    case 'G': {
+        // precision is the number of significant digits, the style depends on
+        // the exponent after rounding
+        if (precision < 0)
+            precision = 6;
+        else if (precision == 0)
+            precision = 1;
+        uint128_t significant;
+        int decimal_exponent;
+        bool carried;
+        if (!roundSignificant(mantissa, exponent, precision - 1, &significant, &decimal_exponent,
+                              &carried))
+            break;
+        if (decimal_exponent < precision && decimal_exponent >= -4)
+            body_len = writeFixed(body, mantissa, exponent, precision - 1 - decimal_exponent,
+                                  spec.alternate);
+        else if (carried && decimal_exponent == precision && spec.alternate)
+            // glibc prints no decimals when rounding switches to the
+            // exponent style, e.g. "%#g" of 999999.5 is "1.e+06"
+            body_len = writeExponent(body, 1, decimal_exponent, 0, true, upper ? 'E' : 'e');
+        else
+            body_len = writeExponent(body, significant, decimal_exponent, precision - 1,
+                                     spec.alternate, upper ? 'E' : 'e');
+        if (body_len > 0 && !spec.alternate)
+            body_len = stripTrailingZeros(body, body_len);
+        break;
+    }
+    case 'a':
+    case 'A':
+        if (precision >= 0 || (biased_exponent == 0 && fraction != 0))
+            break;
+        prefix = upper ? "0X" : "0x";
+        body_len = writeHexFloat(body, fraction, biased_exponent, spec.alternate, upper);
+        break;
+    default:
+        break;
+    }
+
+    if (body_len == 0)
+        return kFORMAT_UNSUPPORTED;
+    return writeField(dst, capacity, width, left_align, spec.zero_pad, sign, prefix,
+                      0, body, body_len);
+}
+
+} // details
+
+} // static_log
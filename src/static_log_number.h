@@ -0,0 +1,126 @@
+#ifndef STATIC_LOG_NUMBER_H
+#define STATIC_LOG_NUMBER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace static_log {
+
+namespace details {
+
+/**
+ * A printf conversion specification, %[flags][width][.precision][length]
+ * conversion, see parseFormatSpec.
+ */
+struct FormatSpec {
+    // Flags
+    bool left_align = false;    // '-'
+    bool plus_sign = false;     // '+'
+    bool space_sign = false;    // ' '
+    bool alternate = false;     // '#'
+    bool zero_pad = false;      // '0'
+
+    // Width and precision given as '*' are passed as arguments
+    bool dynamic_width = false;
+    bool dynamic_precision = false;
+    int  width = 0;
+    // -1 when not specified
+    int  precision = -1;
+
+    // Length modifier, 'H' for hh and 'q' for ll, 0 if none
+    char length = 0;
+    char conversion = 0;
+};
+
+// Conversions handled by formatInteger
+constexpr inline bool
+isIntegerConversion(char c)
+{
+    return c == 'd' || c == 'i' || c == 'u' || c == 'o'
+            || c == 'x' || c == 'X' || c == 'c';
+}
+
+// Conversions handled by formatFloat
+constexpr inline bool
+isFloatConversion(char c)
+{
+    return c == 'f' || c == 'F' || c == 'e' || c == 'E'
+            || c == 'g' || c == 'G' || c == 'a' || c == 'A';
+}
+
+constexpr inline bool
+isSignedConversion(char c)
+{
+    return c == 'd' || c == 'i';
+}
+
+/**
+ * Converts an integer argument, sign or zero extended to 64 bits, to the
+ * type printf reads for the length modifier and conversion, i.e. int for
+ * "%d" and unsigned char for "%hhu", and splits it into sign and magnitude.
+ */
+inline void
+toPrintfInteger(char length, char conversion, uint64_t bits,
+                uint64_t& magnitude, bool& negative)
+{
+    int size = conversion == 'c' || length == 'H' ? 1
+                : length == 'h' ? 2
+                : length == 0 ? sizeof(int) : 8;
+    bool is_signed = isSignedConversion(conversion);
+    if (size < 8) {
+        int shift = 64 - 8 * size;
+        bits = is_signed ? static_cast<uint64_t>(static_cast<int64_t>(bits << shift) >> shift)
+                         : (bits << shift) >> shift;
+    }
+    negative = is_signed && static_cast<int64_t>(bits) < 0;
+    magnitude = negative ? 0 - bits : bits;
+}
+
+/**
+ * Formats an integer exactly like printf does for a d, i, u, o, x, X or c
+ * conversion, flags, width and precision included. Unlike snprintf, nothing
+ * is written unless the whole result fits, and no NUL is appended.
+ *
+ * \param dst
+ *      Where to write
+ * \param capacity
+ *      Bytes available at dst
+ * \param spec
+ *      Conversion specification
+ * \param width
+ *      Field width, a negative value left aligns like a negative '*'
+ *      argument does
+ * \param precision
+ *      Minimum number of digits, negative if not specified
+ * \param magnitude
+ *      Absolute value of the argument, see toPrintfInteger
+ * \param negative
+ *      Sign of the argument
+ * \return
+ *      Length of the formatted integer
+ */
+size_t formatInteger(char* dst, size_t capacity, const FormatSpec& spec,
+                     int width, int precision, uint64_t magnitude, bool negative);
+
+// Returned by formatFloat for the values and specs left to snprintf
+static const size_t kFORMAT_UNSUPPORTED = SIZE_MAX;
+
+/**
+ * Formats a double exactly like printf does for an f, F, e, E, g, G, a or
+ * A conversion. The decimal conversions are computed exactly with 128-bit
+ * integers, correctly rounded to the requested precision; values whose
+ * scaled representation does not fit, non-finite values, long doubles,
+ * precisions over 37 digits and %a with a precision or a subnormal value
+ * are left to snprintf.
+ *
+ * The parameters and the result are those of formatInteger, or
+ * kFORMAT_UNSUPPORTED if the value has to be formatted with snprintf.
+ */
+size_t formatFloat(char* dst, size_t capacity, const FormatSpec& spec,
+                   int width, int precision, double value);
+
+} // details
+
+} // static_log
+
+#endif // STATIC_LOG_NUMBER_H
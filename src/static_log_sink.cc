@@ -0,0 +1,421 @@
+#include "static_log_backend.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace static_log {
+namespace details {
+
+#define PAGE_ALIGNMENT 4096
+
+OutputBuffer::OutputBuffer():
+    fd_(-1),
+    offset_(0),
+    chunks_(),
+    iov_(),
+    fill_index_(0),
+    pending_index_(0),
+    pending_bytes_(0),
+    num_in_flight_(0),
+    flush_threshold_(0),
+    max_latency_us_(kDEFAULT_MAX_LATENCY_US),
+    sink_(kSYNC_WRITE),
+    queue_depth_(0),
+    writer_cpu_(-1),
+    uring_(nullptr),
+    writer_(nullptr),
+    writer_syscalls_(0),
+    oldest_pending_ns_(0),
+    bytes_written_(0),
+    num_flushes_(0),
+    num_syscalls_(0),
+    last_flush_bytes_(0),
+    last_flush_syscalls_(0),
+    max_flush_bytes_(0),
+    active_sink_(kSYNC_WRITE)
+{
+    configure(kDEFAULT_FLUSH_THRESHOLD, kDEFAULT_MAX_LATENCY_US, kSYNC_WRITE, kDEFAULT_QUEUE_DEPTH);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    flush();
+    waitIdle();
+    delete uring_;
+    delete writer_;
+    releaseChunks();
+}
+
+void
+OutputBuffer::releaseChunks()
+{
+    for (auto& chunk : chunks_)
+        free(chunk.data);
+    chunks_.clear();
+}
+
+void
+OutputBuffer::configure(size_t flush_threshold, uint32_t max_latency_us,
+                        OutputSink sink, uint32_t queue_depth, int writer_cpu)
+{
+    max_latency_us_ = max_latency_us;
+    if (flush_threshold == 0)
+        flush_threshold = 1;
+    if (queue_depth == 0)
+        queue_depth = 1;
+    if (flush_threshold == flush_threshold_ && sink == sink_ && queue_depth == queue_depth_
+            && writer_cpu == writer_cpu_)
+        return;
+
+    flush();
+    waitIdle();
+    delete uring_;
+    uring_ = nullptr;
+    delete writer_;
+    writer_ = nullptr;
+    releaseChunks();
+
+    size_t chunks_per_flush = std::min<size_t>((flush_threshold + kCHUNK_SIZE - 1) / kCHUNK_SIZE, IOV_MAX);
+    size_t num_chunks = chunks_per_flush * (sink == kSYNC_WRITE ? 1 : queue_depth);
+    std::vector<struct iovec> buffers;
+    for (size_t i = 0; i < num_chunks; ++i) {
+        void* data = NULL;
+        if (posix_memalign(&data, PAGE_ALIGNMENT, kCHUNK_SIZE) != 0) {
+            fprintf(stderr, "Failed to allocate output chunk\n");
+            exit(-1);
+        }
+        chunks_.push_back(Chunk{(char *)data, 0, 0, 0, false});
+        buffers.push_back(iovec{data, kCHUNK_SIZE});
+    }
+    iov_.resize(chunks_per_flush);
+    flush_threshold_ = std::min(flush_threshold, chunks_per_flush * kCHUNK_SIZE);
+    sink_ = sink;
+    queue_depth_ = queue_depth;
+    writer_cpu_ = writer_cpu;
+    fill_index_ = 0;
+    pending_index_ = 0;
+    pending_bytes_ = 0;
+
+    if (sink == kIO_URING) {
+        uring_ = UringWriter::create(num_chunks, buffers);
+        if (uring_ != nullptr && fd_ != -1 && !uring_->setFd(fd_)) {
+            delete uring_;
+            uring_ = nullptr;
+        }
+        if (uring_ == nullptr)
+            fprintf(stderr, "io_uring is not available, falling back to synchronous writes\n");
+    } else if (sink == kWRITER_THREAD) {
+        writer_ = new ThreadWriter(num_chunks, writer_cpu);
+        writer_syscalls_ = 0;
+        writer_->setFd(fd_);
+    }
+    if (uring_ != nullptr)
+        active_sink_ = kIO_URING;
+    else
+        active_sink_ = writer_ != nullptr ? kWRITER_THREAD : kSYNC_WRITE;
+}
+
+void
+OutputBuffer::setFd(int fd)
+{
+    flush();
+    waitIdle();
+    // pwritev leaves the offset of the fd alone, move it past what was
+    // written for whoever writes to it next
+    if (fd_ != -1)
+        lseek(fd_, offset_, SEEK_SET);
+    fd_ = fd;
+    offset_ = 0;
+    if (fd_ != -1) {
+        off_t offset = lseek(fd_, 0, SEEK_CUR);
+        if (offset > 0)
+            offset_ = offset;
+    }
+    if (uring_ != nullptr && !uring_->setFd(fd_)) {
+        fprintf(stderr, "Falling back to synchronous writes\n");
+        delete uring_;
+        uring_ = nullptr;
+        active_sink_ = kSYNC_WRITE;
+    }
+    if (writer_ != nullptr)
+        writer_->setFd(fd_);
+}
+
+void
+OutputBuffer::nextChunk()
+{
+    fill_index_ = (fill_index_ + 1) % chunks_.size();
+    while (chunks_[fill_index_].in_flight)
+        reapWrites(1);
+    chunks_[fill_index_].len = 0;
+}
+
+void
+OutputBuffer::append(const char* data, size_t len, int64_t now_ns)
+{
+    if (pending_bytes_ == 0)
+        oldest_pending_ns_ = now_ns;
+
+    while (len > 0) {
+        Chunk& chunk = chunks_[fill_index_];
+        if (chunk.len == kCHUNK_SIZE) {
+            nextChunk();
+            continue;
+        }
+        size_t copy = std::min(len, kCHUNK_SIZE - chunk.len);
+        memcpy(chunk.data + chunk.len, data, copy);
+        chunk.len += copy;
+        pending_bytes_ += copy;
+        data += copy;
+        len -= copy;
+        if (pending_bytes_ >= flush_threshold_)
+            flush();
+    }
+}
+
+void
+OutputBuffer::flush()
+{
+    if (pending_bytes_ == 0)
+        return;
+
+    size_t num_chunks = (fill_index_ + chunks_.size() - pending_index_) % chunks_.size() + 1;
+    if (chunks_[fill_index_].len == 0)
+        num_chunks--;
+
+    if (uring_ != nullptr || writer_ != nullptr) {
+        if (uring_ != nullptr)
+            flushUring(num_chunks);
+        else
+            flushWriter(num_chunks);
+        if (chunks_[fill_index_].len != 0)
+            nextChunk();
+    } else {
+        flushSync(num_chunks);
+        fill_index_ = 0;
+        chunks_[0].len = 0;
+    }
+    pending_index_ = fill_index_;
+    pending_bytes_ = 0;
+}
+
+void
+OutputBuffer::flushSync(size_t num_chunks)
+{
+    for (size_t i = 0; i < num_chunks; ++i) {
+        Chunk& chunk = chunks_[(pending_index_ + i) % chunks_.size()];
+        iov_[i].iov_base = chunk.data;
+        iov_[i].iov_len = chunk.len;
+    }
+
+    uint64_t syscalls = 0;
+    size_t written = 0;
+    size_t num_iov = num_chunks;
+    struct iovec* iov = &iov_[0];
+    while (fd_ != -1 && written < pending_bytes_) {
+        ssize_t ret = pwritev(fd_, iov, num_iov, offset_);
+        syscalls++;
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Failed to write log file: %s\n", strerror(errno));
+            break;
+        }
+        if (ret == 0) {
+            // No progress (e.g. a full device), retrying would spin
+            fprintf(stderr, "Failed to write log file: nothing written\n");
+            break;
+        }
+        written += ret;
+        offset_ += ret;
+
+        // Short write, skip what made it to the file
+        while (num_iov > 0 && (size_t)ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            num_iov--;
+        }
+        if (num_iov > 0) {
+            iov->iov_base = (char *)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    bytes_written_.fetch_add(written, std::memory_order_relaxed);
+    num_syscalls_.fetch_add(syscalls, std::memory_order_relaxed);
+    recordFlush(written, syscalls);
+}
+
+void
+OutputBuffer::flushUring(size_t num_chunks)
+{
+    uint64_t syscalls = uring_->num_syscalls_;
+    for (size_t i = 0; i < num_chunks; ++i) {
+        size_t index = (pending_index_ + i) % chunks_.size();
+        Chunk& chunk = chunks_[index];
+        chunk.offset = offset_;
+        chunk.written = 0;
+        chunk.in_flight = true;
+        offset_ += chunk.len;
+        num_in_flight_++;
+        while (!uring_->queueWrite(index, chunk.data, chunk.len, chunk.offset, index))
+            reapUring(1);
+    }
+    uring_->submit(0);
+    syscalls = uring_->num_syscalls_ - syscalls;
+    num_syscalls_.fetch_add(syscalls, std::memory_order_relaxed);
+    recordFlush(pending_bytes_, syscalls);
+}
+
+void
+OutputBuffer::flushWriter(size_t num_chunks)
+{
+    for (size_t i = 0; i < num_chunks; ++i) {
+        size_t index = (pending_index_ + i) % chunks_.size();
+        Chunk& chunk = chunks_[index];
+        chunk.offset = offset_;
+        chunk.written = 0;
+        chunk.in_flight = true;
+        offset_ += chunk.len;
+        num_in_flight_++;
+        while (!writer_->queueWrite(chunk.data, chunk.len, chunk.offset, index))
+            reapWriter(1);
+    }
+    writer_->submit();
+    // The backend issues no write, those of the writer thread are counted
+    // as their completions are reaped
+    recordFlush(pending_bytes_, 0);
+}
+
+void
+OutputBuffer::reapWrites(uint32_t wait_nr)
+{
+    if (uring_ != nullptr)
+        reapUring(wait_nr);
+    else
+        reapWriter(wait_nr);
+}
+
+void
+OutputBuffer::reapWriter(uint32_t wait_nr)
+{
+    if (writer_ == nullptr || num_in_flight_ == 0)
+        return;
+
+    writer_->reap(wait_nr);
+    uint64_t syscalls = writer_->num_syscalls_.load(std::memory_order_relaxed);
+    num_syscalls_.fetch_add(syscalls - writer_syscalls_, std::memory_order_relaxed);
+    writer_syscalls_ = syscalls;
+    for (auto& completion : writer_->completions_) {
+        Chunk& chunk = chunks_[completion.user_data];
+        if (completion.res < 0) {
+            fprintf(stderr, "Failed to write log file: %s\n", strerror(-completion.res));
+        } else {
+            bytes_written_.fetch_add(completion.res, std::memory_order_relaxed);
+        }
+        chunk.written = chunk.len;
+        chunk.in_flight = false;
+        num_in_flight_--;
+    }
+}
+
+void
+OutputBuffer::reapUring(uint32_t wait_nr)
+{
+    if (uring_ == nullptr || num_in_flight_ == 0)
+        return;
+
+    uint64_t syscalls = uring_->num_syscalls_;
+    if (wait_nr > 0)
+        uring_->submit(wait_nr);
+    uring_->reap();
+    for (auto& completion : uring_->completions_) {
+        Chunk& chunk = chunks_[completion.user_data];
+        if (completion.res < 0 && completion.res != -EAGAIN && completion.res != -EINTR) {
+            fprintf(stderr, "Failed to write log file: %s\n", strerror(-completion.res));
+            chunk.written = chunk.len;
+        } else if (completion.res == 0) {
+            // No progress (e.g. a full device), requeueing would spin
+            fprintf(stderr, "Failed to write log file: nothing written\n");
+            chunk.written = chunk.len;
+        } else if (completion.res > 0) {
+            chunk.written += completion.res;
+            bytes_written_.fetch_add(completion.res, std::memory_order_relaxed);
+        }
+
+        if (chunk.written < chunk.len) {
+            // Short write, queue the rest. The submission queue may be full
+            // of the writes queued meanwhile, submitting them makes room.
+            bool queued = false;
+            for (int attempt = 0; attempt < 2 && !queued; ++attempt) {
+                queued = uring_->queueWrite(completion.user_data, chunk.data + chunk.written,
+                                            chunk.len - chunk.written, chunk.offset + chunk.written,
+                                            completion.user_data);
+                uring_->submit(0);
+            }
+            if (queued)
+                continue;
+            fprintf(stderr, "Failed to queue the rest of a log file write\n");
+            chunk.written = chunk.len;
+        }
+        chunk.in_flight = false;
+        num_in_flight_--;
+    }
+    num_syscalls_.fetch_add(uring_->num_syscalls_ - syscalls, std::memory_order_relaxed);
+}
+
+void
+OutputBuffer::waitIdle()
+{
+    while (num_in_flight_ > 0)
+        reapWrites(1);
+}
+
+void
+OutputBuffer::recordFlush(uint64_t bytes, uint64_t syscalls)
+{
+    num_flushes_.fetch_add(1, std::memory_order_relaxed);
+    last_flush_bytes_.store(bytes, std::memory_order_relaxed);
+    last_flush_syscalls_.store(syscalls, std::memory_order_relaxed);
+    if (bytes > max_flush_bytes_.load(std::memory_order_relaxed))
+        max_flush_bytes_.store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t
+OutputBuffer::flushIfStale(int64_t now_ns)
+{
+    // Recycle the chunks whose writes completed in the meantime
+    reapWrites(0);
+
+    if (pending_bytes_ == 0)
+        return UINT64_MAX;
+
+    int64_t deadline_ns = oldest_pending_ns_ + max_latency_us_ * 1000LL;
+    if (now_ns >= deadline_ns) {
+        flush();
+        return UINT64_MAX;
+    }
+    return (deadline_ns - now_ns) / 1000 + 1;
+}
+
+OutputStats
+OutputBuffer::getStats() const
+{
+    OutputStats stats{};
+    stats.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+    stats.num_flushes = num_flushes_.load(std::memory_order_relaxed);
+    stats.num_syscalls = num_syscalls_.load(std::memory_order_relaxed);
+    stats.last_flush_bytes = last_flush_bytes_.load(std::memory_order_relaxed);
+    stats.last_flush_syscalls = last_flush_syscalls_.load(std::memory_order_relaxed);
+    stats.max_flush_bytes = max_flush_bytes_.load(std::memory_order_relaxed);
+    stats.active_sink = (OutputSink)active_sink_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // details
+} // static_log
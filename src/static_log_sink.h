@@ -0,0 +1,180 @@
+#ifndef STATIC_LOG_SINK_H
+#define STATIC_LOG_SINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <vector>
+
+#include "static_log.h"
+#include "static_log_uring.h"
+#include "static_log_writer.h"
+
+namespace static_log {
+namespace details {
+
+/**
+ * Accumulates formatted log lines into large page-aligned chunks and writes
+ * them to the log file once enough data is pending or the oldest pending
+ * byte has waited for the configured latency.
+ *
+ * The chunks form a ring. With the synchronous sink a flush writes the
+ * pending chunks with a single pwritev() and they are immediately reusable.
+ * With the io_uring sink each pending chunk becomes a write to the fixed
+ * file and up to queue_depth flushes stay in flight while the following
+ * chunks are filled; append() only waits when it catches up with a chunk
+ * that is still being written. The writer thread sink works the same way,
+ * with the chunks queued to a ThreadWriter instead of the kernel.
+ *
+ * Only the backend worker appends and flushes; the statistics can be read
+ * from any thread.
+ */
+class OutputBuffer {
+public:
+    static const size_t   kDEFAULT_FLUSH_THRESHOLD = 1024 * 1024;
+    static const uint32_t kDEFAULT_MAX_LATENCY_US = 1000;
+    static const uint32_t kDEFAULT_QUEUE_DEPTH = 4;
+
+    OutputBuffer();
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&)=delete;
+    OutputBuffer& operator=(const OutputBuffer&)=delete;
+
+    /**
+     * Changes the buffering parameters, writing what is pending first.
+     *
+     * \param flush_threshold
+     *      Number of pending bytes that triggers a flush
+     * \param max_latency_us
+     *      Longest time data may stay buffered, 0 flushes after every pass
+     *      of the backend
+     * \param sink
+     *      How flushes are written, falls back to kSYNC_WRITE if io_uring
+     *      cannot be set up
+     * \param queue_depth
+     *      Number of flushes the asynchronous sinks keep in flight
+     * \param writer_cpu
+     *      CPU the thread of kWRITER_THREAD is pinned to, -1 for none
+     */
+    void configure(size_t flush_threshold, uint32_t max_latency_us,
+                   OutputSink sink, uint32_t queue_depth, int writer_cpu = -1);
+
+    /**
+     * Sets the file to write to, completing the writes to the old one and
+     * leaving its offset after them. Writes continue from the current
+     * offset of the fd, -1 detaches the buffer from any file.
+     */
+    void setFd(int fd);
+
+    /**
+     * Copies data at the end of the pending output, flushing when the size
+     * threshold is reached.
+     *
+     * \param now_ns
+     *      Current time, used to track the age of the pending data
+     */
+    void append(const char* data, size_t len, int64_t now_ns);
+
+    /**
+     * Hands all pending data to the sink. With io_uring the writes may
+     * still be in flight on return, see waitIdle().
+     */
+    void flush();
+
+    /**
+     * Waits until every write handed to the sink has completed.
+     */
+    void waitIdle();
+
+    /**
+     * Flushes if the oldest pending byte has been buffered for longer than
+     * the max latency.
+     *
+     * \return
+     *      Microseconds until the pending data has to be flushed, UINT64_MAX
+     *      if nothing is pending
+     */
+    uint64_t flushIfStale(int64_t now_ns);
+
+    OutputStats getStats() const;
+
+private:
+    // Size of each page-aligned chunk
+    static const size_t kCHUNK_SIZE = 64 * 1024;
+
+    struct Chunk {
+        char*  data;
+        // Bytes filled, and already written while the chunk is in flight
+        size_t len;
+        size_t written;
+        // File offset of the first byte
+        off_t  offset;
+        bool   in_flight;
+    };
+
+    void releaseChunks();
+
+    // Moves to the next chunk of the ring, waiting for it to be written
+    void nextChunk();
+
+    void flushSync(size_t num_chunks);
+    void flushUring(size_t num_chunks);
+    void flushWriter(size_t num_chunks);
+
+    // Handles the completions of the asynchronous sinks, blocking until at
+    // least wait_nr of them arrived
+    void reapWrites(uint32_t wait_nr);
+    void reapUring(uint32_t wait_nr);
+    void reapWriter(uint32_t wait_nr);
+
+    // Accounts a flush of bytes handed to the sink with syscalls calls,
+    // bytes_written_ is updated as the writes complete
+    void recordFlush(uint64_t bytes, uint64_t syscalls);
+
+    // The log file and the offset of the next write
+    int     fd_;
+    off_t   offset_;
+
+    std::vector<Chunk> chunks_;
+    std::vector<struct iovec> iov_;
+
+    // Chunk being filled, and first chunk not yet handed to the sink
+    size_t  fill_index_;
+    size_t  pending_index_;
+    size_t  pending_bytes_;
+    size_t  num_in_flight_;
+
+    size_t   flush_threshold_;
+    uint32_t max_latency_us_;
+    OutputSink sink_;
+    uint32_t queue_depth_;
+    int      writer_cpu_;
+
+    // Set when the io_uring sink is active
+    UringWriter* uring_;
+
+    // Set when the writer thread sink is active, and the syscalls of its
+    // thread already added to num_syscalls_
+    ThreadWriter* writer_;
+    uint64_t writer_syscalls_;
+
+    // Time at which the oldest pending byte was appended
+    int64_t oldest_pending_ns_;
+
+    std::atomic<uint64_t> bytes_written_;
+    std::atomic<uint64_t> num_flushes_;
+    std::atomic<uint64_t> num_syscalls_;
+    std::atomic<uint64_t> last_flush_bytes_;
+    std::atomic<uint64_t> last_flush_syscalls_;
+    std::atomic<uint64_t> max_flush_bytes_;
+    std::atomic<uint32_t> active_sink_;
+};
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_SINK_H
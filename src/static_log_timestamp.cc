@@ -0,0 +1,105 @@
+#include "static_log_backend.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "static_log_number.h"
+
+namespace static_log {
+
+namespace details {
+
+TimestampRenderer::TimestampRenderer(TimestampFormat format):
+    format_(format),
+    cached_second_(INT64_MIN),
+    prefix_(),
+    prefix_len_(0)
+{
+    // localtime_r() does not read TZ by itself
+    tzset();
+}
+
+void
+TimestampRenderer::setFormat(TimestampFormat format)
+{
+    if (format != format_) {
+        format_ = format;
+        cached_second_ = INT64_MIN;
+    }
+}
+
+void
+TimestampRenderer::cacheSecond(int64_t seconds)
+{
+    time_t t = seconds;
+    struct tm tm_now;
+    bool converted = format_ == kISO8601_UTC ? gmtime_r(&t, &tm_now) != NULL
+                                             : localtime_r(&t, &tm_now) != NULL;
+    int len;
+    if (!converted) {
+        len = snprintf(prefix_, sizeof(prefix_), "%lld.", (long long)seconds);
+    } else {
+        len = snprintf(prefix_, sizeof(prefix_), "%04d-%02d-%02d%c%02d:%02d:%02d.",
+                       tm_now.tm_year + 1900, tm_now.tm_mon + 1, tm_now.tm_mday,
+                       format_ == kISO8601_UTC ? 'T' : '-',
+                       tm_now.tm_hour, tm_now.tm_min, tm_now.tm_sec);
+    }
+    prefix_len_ = std::min((size_t)len, sizeof(prefix_) - 1);
+    cached_second_ = seconds;
+}
+
+/**
+* Writes the digits of value left padded with zeros to a fixed width
+*/
+static inline void
+writeFixedDigits(char* dst, uint32_t value, int digits)
+{
+    for (int i = digits - 1; i >= 0; --i) {
+        dst[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+size_t
+TimestampRenderer::render(int64_t timestamp_ns, char* dst)
+{
+    if (format_ == kEPOCH_NANOSECONDS) {
+        FormatSpec spec;
+        spec.length = 'q';
+        spec.conversion = 'd';
+        return formatInteger(dst, MAX_TIMESTAMP_LEN, spec, 0, -1,
+                timestamp_ns < 0 ? 0 - (uint64_t)timestamp_ns : timestamp_ns,
+                timestamp_ns < 0);
+    }
+
+    // Floor division, so that times before the epoch keep positive
+    // sub-second digits
+    int64_t seconds = timestamp_ns / 1000000000;
+    int64_t nanos = timestamp_ns % 1000000000;
+    if (nanos < 0) {
+        seconds -= 1;
+        nanos += 1000000000;
+    }
+    if (seconds != cached_second_)
+        cacheSecond(seconds);
+
+    memcpy(dst, prefix_, prefix_len_);
+    size_t len = prefix_len_;
+    if (format_ == kLOCAL_MICROSECONDS) {
+        writeFixedDigits(dst + len, nanos / 1000, 6);
+        len += 6;
+    } else {
+        writeFixedDigits(dst + len, nanos, 9);
+        len += 9;
+    }
+    if (format_ == kISO8601_UTC)
+        dst[len++] = 'Z';
+    return len;
+}
+
+} // details
+
+} // static_log
@@ -0,0 +1,56 @@
+#ifndef STATIC_LOG_TIMESTAMP_H
+#define STATIC_LOG_TIMESTAMP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "static_log.h"
+
+namespace static_log {
+namespace details {
+
+// Longest timestamp rendered by TimestampRenderer
+#define MAX_TIMESTAMP_LEN 48
+
+/**
+* Renders the timestamp at the start of each line. The local date and time
+* are only converted with localtime_r() (gmtime_r() for UTC) when the second
+* changes, which follows timezone and DST transitions since the conversion
+* is redone for every new second, and only the sub-second digits are
+* rendered per line.
+*/
+class TimestampRenderer {
+public:
+    explicit TimestampRenderer(TimestampFormat format = kLOCAL_NANOSECONDS);
+
+    void setFormat(TimestampFormat format);
+    TimestampFormat getFormat() const { return format_; }
+
+    /**
+    * Writes the timestamp, without NUL terminator
+    *
+    * \param timestamp_ns
+    *   Wall-clock time in nanoseconds since the epoch
+    * \param dst
+    *   Where to write, at least MAX_TIMESTAMP_LEN bytes long
+    * \return
+    *   Length of the timestamp
+    */
+    size_t render(int64_t timestamp_ns, char* dst);
+
+private:
+    // Renders the part of the timestamp shared by a whole second
+    void cacheSecond(int64_t seconds);
+
+    TimestampFormat format_;
+
+    // Second whose date and time are in prefix_, INT64_MIN if none
+    int64_t cached_second_;
+    char    prefix_[MAX_TIMESTAMP_LEN];
+    size_t  prefix_len_;
+};
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_TIMESTAMP_H
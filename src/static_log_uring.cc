@@ -0,0 +1,230 @@
+#include "static_log_uring.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define STATICLOG_HAS_IO_URING 1
+#endif
+
+namespace static_log {
+namespace details {
+
+#ifdef STATICLOG_HAS_IO_URING
+
+static int
+sysIoUringSetup(unsigned entries, struct io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int
+sysIoUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int
+sysIoUringRegister(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+UringWriter::UringWriter():
+    completions_(),
+    num_syscalls_(0),
+    ring_fd_(-1),
+    file_registered_(false),
+    sq_ring_(MAP_FAILED),
+    sq_ring_size_(0),
+    cq_ring_(MAP_FAILED),
+    cq_ring_size_(0),
+    sqes_((struct io_uring_sqe *)MAP_FAILED),
+    sqes_size_(0),
+    sq_head_(NULL),
+    sq_tail_(NULL),
+    sq_mask_(NULL),
+    sq_array_(NULL),
+    sq_entries_(0),
+    cq_head_(NULL),
+    cq_tail_(NULL),
+    cq_mask_(NULL),
+    cqes_(NULL),
+    to_submit_(0)
+{
+}
+
+UringWriter*
+UringWriter::create(uint32_t entries, const std::vector<struct iovec>& buffers)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = sysIoUringSetup(entries, &params);
+    if (fd < 0)
+        return nullptr;
+
+    UringWriter* writer = new UringWriter();
+    writer->ring_fd_ = fd;
+
+    writer->sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    writer->cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (writer->cq_ring_size_ > writer->sq_ring_size_)
+            writer->sq_ring_size_ = writer->cq_ring_size_;
+        writer->cq_ring_size_ = 0;
+    }
+    writer->sq_ring_ = mmap(NULL, writer->sq_ring_size_, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (writer->sq_ring_ == MAP_FAILED) {
+        delete writer;
+        return nullptr;
+    }
+    if (writer->cq_ring_size_ == 0) {
+        writer->cq_ring_ = writer->sq_ring_;
+    } else {
+        writer->cq_ring_ = mmap(NULL, writer->cq_ring_size_, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (writer->cq_ring_ == MAP_FAILED) {
+            delete writer;
+            return nullptr;
+        }
+    }
+    writer->sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    writer->sqes_ = (struct io_uring_sqe *)mmap(NULL, writer->sqes_size_, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (writer->sqes_ == MAP_FAILED) {
+        delete writer;
+        return nullptr;
+    }
+
+    char* sq = (char *)writer->sq_ring_;
+    char* cq = (char *)writer->cq_ring_;
+    writer->sq_head_ = (unsigned *)(sq + params.sq_off.head);
+    writer->sq_tail_ = (unsigned *)(sq + params.sq_off.tail);
+    writer->sq_mask_ = (unsigned *)(sq + params.sq_off.ring_mask);
+    writer->sq_array_ = (unsigned *)(sq + params.sq_off.array);
+    writer->sq_entries_ = params.sq_entries;
+    writer->cq_head_ = (unsigned *)(cq + params.cq_off.head);
+    writer->cq_tail_ = (unsigned *)(cq + params.cq_off.tail);
+    writer->cq_mask_ = (unsigned *)(cq + params.cq_off.ring_mask);
+    writer->cqes_ = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    if (sysIoUringRegister(fd, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) < 0) {
+        fprintf(stderr, "Failed to register io_uring buffers: %s\n", strerror(errno));
+        delete writer;
+        return nullptr;
+    }
+    return writer;
+}
+
+UringWriter::~UringWriter()
+{
+    if (sqes_ != MAP_FAILED)
+        munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+        munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED)
+        munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ != -1)
+        close(ring_fd_);
+}
+
+bool
+UringWriter::setFd(int fd)
+{
+    if (file_registered_) {
+        sysIoUringRegister(ring_fd_, IORING_UNREGISTER_FILES, NULL, 0);
+        file_registered_ = false;
+    }
+    if (fd == -1)
+        return true;
+    if (sysIoUringRegister(ring_fd_, IORING_REGISTER_FILES, &fd, 1) < 0) {
+        fprintf(stderr, "Failed to register log file with io_uring: %s\n", strerror(errno));
+        return false;
+    }
+    file_registered_ = true;
+    return true;
+}
+
+bool
+UringWriter::queueWrite(uint32_t buf_index, const char* data, size_t len,
+                        off_t offset, uint64_t user_data)
+{
+    unsigned tail = *sq_tail_;
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (tail - head >= sq_entries_)
+        return false;
+
+    unsigned index = tail & *sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = 0;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->buf_index = buf_index;
+    sqe->user_data = user_data;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    to_submit_++;
+    return true;
+}
+
+bool
+UringWriter::submit(uint32_t wait_nr)
+{
+    while (to_submit_ > 0 || wait_nr > 0) {
+        int ret = sysIoUringEnter(ring_fd_, to_submit_, wait_nr,
+                                  wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+        num_syscalls_++;
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            fprintf(stderr, "io_uring_enter failed: %s\n", strerror(errno));
+            return false;
+        }
+        to_submit_ -= ret;
+        wait_nr = 0;
+    }
+    return true;
+}
+
+void
+UringWriter::reap()
+{
+    completions_.clear();
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+        completions_.push_back(Completion{cqe->user_data, cqe->res});
+        head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+#else // STATICLOG_HAS_IO_URING
+
+UringWriter*
+UringWriter::create(uint32_t, const std::vector<struct iovec>&)
+{
+    return nullptr;
+}
+
+UringWriter::~UringWriter() {}
+bool UringWriter::setFd(int) { return false; }
+bool UringWriter::queueWrite(uint32_t, const char*, size_t, off_t, uint64_t) { return false; }
+bool UringWriter::submit(uint32_t) { return false; }
+void UringWriter::reap() {}
+
+#endif // STATICLOG_HAS_IO_URING
+
+} // details
+} // static_log
@@ -0,0 +1,123 @@
+#ifndef STATIC_LOG_URING_H
+#define STATIC_LOG_URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace static_log {
+namespace details {
+
+/**
+ * Minimal io_uring instance driven through the raw syscalls, used by the
+ * OutputBuffer to keep several chunks of formatted output in flight.
+ *
+ * The output chunks are registered once as fixed buffers and the log file
+ * as fixed file 0, so each write is an IORING_OP_WRITE_FIXED that avoids
+ * pinning pages and looking up the fd per request.
+ *
+ * Not thread safe, owned by the backend worker.
+ */
+class UringWriter {
+public:
+    struct Completion {
+        uint64_t user_data;
+        int32_t  res;
+    };
+
+    /**
+     * Sets up a ring and registers the buffers.
+     *
+     * \param entries
+     *      Maximum number of writes in flight
+     * \param buffers
+     *      Memory regions that will be written from, referenced by index
+     * \return
+     *      nullptr if io_uring is not available on this kernel/sandbox or
+     *      the buffers could not be registered
+     */
+    static UringWriter* create(uint32_t entries, const std::vector<struct iovec>& buffers);
+
+    ~UringWriter();
+
+    UringWriter(const UringWriter&)=delete;
+    UringWriter& operator=(const UringWriter&)=delete;
+
+    /**
+     * Registers fd as the fixed file writes go to. There must be no write
+     * in flight.
+     *
+     * \return
+     *      false if the file could not be registered
+     */
+    bool setFd(int fd);
+
+    /**
+     * Queues a write of a region of registered buffer buf_index, it is
+     * handed to the kernel by the next submit().
+     *
+     * \return
+     *      false if the submission queue is full
+     */
+    bool queueWrite(uint32_t buf_index, const char* data, size_t len,
+                    off_t offset, uint64_t user_data);
+
+    /**
+     * Submits the queued writes and optionally waits for completions.
+     *
+     * \param wait_nr
+     *      Number of completions to wait for
+     * \return
+     *      false on failure
+     */
+    bool submit(uint32_t wait_nr);
+
+    /**
+     * Moves the available completions into completions_.
+     */
+    void reap();
+
+    // Completions collected by the last reap()
+    std::vector<Completion> completions_;
+
+    // Number of io_uring_enter syscalls issued
+    uint64_t num_syscalls_;
+
+private:
+    UringWriter();
+
+    int ring_fd_;
+    bool file_registered_;
+
+    // Mapped rings
+    void*    sq_ring_;
+    size_t   sq_ring_size_;
+    void*    cq_ring_;
+    size_t   cq_ring_size_;
+    struct io_uring_sqe* sqes_;
+    size_t   sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned  sq_entries_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    // Number of sqes queued since the last submit
+    unsigned to_submit_;
+};
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_URING_H
@@ -0,0 +1,666 @@
+#include "static_log_backend.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#include <chrono>
+#include <algorithm>
+
+#include "static_log_internal.h"
+#include "static_log_format.h"
+#include "static_log_binary.h"
+
+namespace static_log {
+
+namespace details {
+
+#define DROPPED_FORMAT "%lu messages dropped"
+
+// Call site of the lines written by reportDroppedMessages
+static constexpr auto dropped_param_types = analyzeFormatString<1>(DROPPED_FORMAT);
+static constexpr auto dropped_layout = analyzeFormatLayout<1>(DROPPED_FORMAT);
+static constexpr StaticInfo dropped_info(1, dropped_param_types.data(), ArgTypeList<uint64_t>::sizes,
+                                         DROPPED_FORMAT, LogLevels::kWARNING, "reportDroppedMessages",
+                                         __FILE__, __LINE__,
+                                         getFormatFunction<dropped_layout>(ArgTypeList<uint64_t>{}));
+
+BackendWorker::BackendWorker(StaticLogBackend& backend, uint32_t index, std::vector<size_t> registries,
+                             int node, OutputBuffer& output, bool batched):
+    backend_(backend),
+    index_(index),
+    registries_(std::move(registries)),
+    node_(node),
+    thread_(),
+    clock_(),
+    pass_start_ns_(0),
+    output_(output),
+    batched_(batched),
+    batch_(),
+    timestamp_(),
+    active_layout_(),
+    active_layout_version_(0),
+    callsite_cache_(),
+    callsite_described_(),
+    last_merged_tsc_(0),
+    merge_heap_(),
+    backoff_us_(0),
+    wakeup_seq_(0),
+    retired_segments_(),
+    log_buffer_(NULL),
+    bufflen_(0)
+{
+    log_buffer_ = (char*)malloc(DEFALT_CACHE_SIZE);
+    if (log_buffer_ == NULL) {
+        fprintf(stderr, "Failed to create log buffer\n");
+        exit(-1);
+    }
+    bufflen_ = DEFALT_CACHE_SIZE;
+}
+
+BackendWorker::~BackendWorker()
+{
+    join();
+    for (auto segment : retired_segments_)
+        delete segment;
+    if (log_buffer_)
+        free(log_buffer_);
+    bufflen_ = 0;
+}
+
+void
+BackendWorker::start()
+{
+    thread_ = std::thread(&BackendWorker::run, this);
+}
+
+void
+BackendWorker::join()
+{
+    if (thread_.joinable())
+        thread_.join();
+}
+
+template<typename Fn>
+void
+BackendWorker::forEachSlot(Fn fn)
+{
+    for (size_t i : registries_) {
+        StagingRegistry& registry = backend_.registries_[i];
+        // Most registries are empty, no thread ever ran on their shard
+        if (registry.size() == 0)
+            continue;
+        registry.forEachSlot([&](std::atomic<StagingBuffer*>& slot) { fn(registry, slot); });
+    }
+}
+
+size_t
+BackendWorker::numBuffers()
+{
+    size_t num_buffers = 0;
+    for (size_t i : registries_)
+        num_buffers += backend_.registries_[i].size();
+    return num_buffers;
+}
+
+void
+BackendWorker::refreshCallsites()
+{
+    std::unique_lock<std::mutex> lock(backend_.callsite_mutex_);
+    size_t first = callsite_cache_.size();
+    callsite_cache_.insert(callsite_cache_.end(), backend_.callsites_.begin() + first,
+                           backend_.callsites_.end());
+    lock.unlock();
+    for (size_t i = first; i < callsite_cache_.size(); ++i)
+        callsite_cache_[i].layout = active_layout_.bind(callsite_cache_[i].static_info, backend_.pid_);
+}
+
+void
+BackendWorker::appendOutput(const char* data, size_t len)
+{
+    if (batched_)
+        batch_.append(data, len);
+    else
+        output_.append(data, len, pass_start_ns_);
+}
+
+bool
+BackendWorker::formatLogEntry(const LogEntry* log_entry, uint32_t thread_id,
+                              uint64_t timestamp, const char* args)
+{
+    const Callsite& callsite = lookupCallsite(log_entry->callsite_id);
+    int len = formatLogLine(callsite.static_info,
+                callsite.layout,
+                args,
+                TscClock::toNanos(clock_, timestamp),
+                thread_id,
+                timestamp_,
+                log_buffer_, bufflen_);
+    if (len == -1)
+        return false;
+    appendOutput(log_buffer_, len);
+    return true;
+}
+
+bool
+BackendWorker::writeBinaryEntry(const LogEntry* log_entry, uint32_t thread_id,
+                                uint64_t timestamp, const char* args)
+{
+    // The file header is written by StaticLogBackend::startWorkers, and
+    // describing a call site again in another worker's batch is harmless
+    uint32_t id = log_entry->callsite_id;
+    if (id >= callsite_described_.size())
+        callsite_described_.resize(id + 1, false);
+    if (!callsite_described_[id]) {
+        const Callsite& callsite = lookupCallsite(id);
+        const StaticInfo* static_info = callsite.static_info;
+        size_t format_len = strlen(static_info->format);
+        size_t function_len = strlen(static_info->function_name);
+        size_t file_len = strlen(static_info->file_name);
+        size_t record_len = sizeof(BinaryCallsiteRecord)
+                + static_info->num_params * sizeof(BinaryParam) + format_len + function_len + file_len;
+        if (record_len > bufflen_)
+            return false;
+
+        BinaryCallsiteRecord record{kRECORD_CALLSITE, id,
+                (uint8_t)static_info->log_level, (uint32_t)static_info->line,
+                (uint16_t)static_info->num_params, (uint32_t)format_len, (uint32_t)function_len,
+                (uint32_t)file_len};
+        char* pos = log_buffer_;
+        memcpy(pos, &record, sizeof(record));
+        pos += sizeof(record);
+        for (int i = 0; i < static_info->num_params; ++i) {
+            ParamType type = static_info->param_types[i];
+            BinaryParam param{type, type > ParamType::kNON_STRING ? 0 : (uint32_t)static_info->arg_sizes[i]};
+            memcpy(pos, &param, sizeof(param));
+            pos += sizeof(param);
+        }
+        memcpy(pos, static_info->format, format_len);
+        pos += format_len;
+        memcpy(pos, static_info->function_name, function_len);
+        pos += function_len;
+        memcpy(pos, static_info->file_name, file_len);
+        pos += file_len;
+        appendOutput(log_buffer_, pos - log_buffer_);
+        callsite_described_[id] = true;
+    }
+
+    // The arguments are copied as is, the decoder walks them with the
+    // call site description
+    uint32_t args_len = log_entry->entry_size - (args - (const char*)log_entry);
+    BinaryLogRecord record{kRECORD_LOG, id, thread_id, TscClock::toNanos(clock_, timestamp), args_len};
+    appendOutput((char*)&record, sizeof(record));
+    appendOutput(args, args_len);
+    return true;
+}
+
+/**
+ * Decodes the timestamp of an entry given the timestamp of the entry before
+ * it in the same StagingBuffer, see StagingBuffer::encodeTimestamp
+ *
+ * \param[out] args
+ *      Start of the arguments of the entry
+ */
+static inline uint64_t
+decodeTimestamp(const LogEntry* log_entry, uint64_t previous_tsc, const char** args)
+{
+    uint64_t delta;
+    *args = decodeVarint((const char*)log_entry + sizeof(LogEntry), &delta);
+    return previous_tsc + static_cast<uint64_t>(zigzagDecode(delta));
+}
+
+void
+BackendWorker::processLogBuffer(StagingBuffer* stagingbuffer)
+{
+    uint64_t bytes_available = 0;
+    stagingbuffer->claim();
+    char* raw_data = stagingbuffer->peek(&bytes_available);
+    if (bytes_available > 0) {
+        LogEntry *log_entry = (LogEntry *)raw_data;
+        const char* args;
+        uint64_t timestamp = decodeTimestamp(log_entry, stagingbuffer->last_consumer_tsc_, &args);
+        if (writeLogEntry(log_entry, stagingbuffer->getId(), timestamp, args)) {
+            stagingbuffer->last_consumer_tsc_ = timestamp;
+            stagingbuffer->consume(log_entry->entry_size);
+        }
+    }
+    stagingbuffer->unclaim();
+}
+
+uint32_t
+BackendWorker::drainLogBuffer(StagingBuffer* stagingbuffer, uint32_t budget)
+{
+    uint32_t num_entries = 0;
+    while (budget == 0 || num_entries < budget) {
+        uint64_t bytes_available = 0;
+        // Loaded first, the full segment gets no more entries once it is set
+        StagingBuffer* next = stagingbuffer->next_.load(std::memory_order_acquire);
+        stagingbuffer->claim();
+        char* raw_data = stagingbuffer->peek(&bytes_available);
+        if (bytes_available == 0) {
+            stagingbuffer->unclaim();
+            // The producer moved on to the next segment, the drained one is
+            // released by releaseDrainedSegments
+            if (next == nullptr)
+                break;
+            stagingbuffer = next;
+            continue;
+        }
+
+        // Everything up to bytes_available is contiguous, format it
+        // entry by entry and release it to the producer in one go
+        uint64_t bytes_consumed = 0;
+        while (bytes_consumed < bytes_available && (budget == 0 || num_entries < budget)) {
+            LogEntry *log_entry = (LogEntry *)(raw_data + bytes_consumed);
+            const char* args;
+            uint64_t timestamp = decodeTimestamp(log_entry, stagingbuffer->last_consumer_tsc_, &args);
+            if (!writeLogEntry(log_entry, stagingbuffer->getId(), timestamp, args))
+                break;
+            stagingbuffer->last_consumer_tsc_ = timestamp;
+            bytes_consumed += log_entry->entry_size;
+            num_entries++;
+        }
+        stagingbuffer->consume(bytes_consumed);
+        stagingbuffer->unclaim();
+        if (bytes_consumed == 0)
+            break;
+    }
+    return num_entries;
+}
+
+/**
+ * Orders MergeCursors so that std::push_heap/pop_heap build a min-heap on
+ * the timestamp of the head entry
+ */
+static inline bool
+laterHead(const BackendWorker::MergeCursor& a, const BackendWorker::MergeCursor& b)
+{
+    return a.timestamp > b.timestamp;
+}
+
+bool
+BackendWorker::refillCursor(MergeCursor& cursor)
+{
+    for (;;) {
+        StagingBuffer* next = cursor.buffer->next_.load(std::memory_order_acquire);
+        // Held until the region is consumed
+        cursor.buffer->claim();
+        cursor.data = cursor.buffer->peek(&cursor.bytes_available);
+        cursor.bytes_consumed = 0;
+        if (cursor.bytes_available != 0)
+            break;
+        cursor.buffer->unclaim();
+        if (next == nullptr)
+            return false;
+        cursor.buffer = next;
+    }
+    cursor.timestamp = decodeTimestamp((LogEntry *)cursor.data,
+                                       cursor.buffer->last_consumer_tsc_, &cursor.args);
+    return true;
+}
+
+uint32_t
+BackendWorker::mergeLogBuffers(const std::vector<StagingBuffer *>& buffers,
+                               uint64_t limit_tsc,
+                               uint32_t budget,
+                               uint64_t* next_tsc)
+{
+    merge_heap_.clear();
+    for (auto thread_buffer : buffers) {
+        MergeCursor cursor{0, nullptr, thread_buffer, nullptr, 0, 0};
+        if (refillCursor(cursor)) {
+            merge_heap_.push_back(cursor);
+            std::push_heap(merge_heap_.begin(), merge_heap_.end(), laterHead);
+        }
+    }
+
+    uint32_t num_entries = 0;
+    while (!merge_heap_.empty() && (budget == 0 || num_entries < budget)) {
+        MergeCursor& head = merge_heap_.front();
+        if (head.timestamp > limit_tsc)
+            break;
+
+        LogEntry *log_entry = (LogEntry *)(head.data + head.bytes_consumed);
+        if (!writeLogEntry(log_entry, head.buffer->getId(), head.timestamp, head.args))
+            break;
+        if (head.timestamp < last_merged_tsc_)
+            backend_.num_late_entries_.fetch_add(1, std::memory_order_relaxed);
+        else
+            last_merged_tsc_ = head.timestamp;
+        head.buffer->last_consumer_tsc_ = head.timestamp;
+        head.bytes_consumed += log_entry->entry_size;
+        num_entries++;
+
+        std::pop_heap(merge_heap_.begin(), merge_heap_.end(), laterHead);
+        MergeCursor& cursor = merge_heap_.back();
+        if (cursor.bytes_consumed < cursor.bytes_available) {
+            cursor.timestamp = decodeTimestamp((LogEntry *)(cursor.data + cursor.bytes_consumed),
+                                    cursor.timestamp, &cursor.args);
+        } else {
+            // Region exhausted, hand it back and look for more (e.g. after
+            // a roll over)
+            cursor.buffer->consume(cursor.bytes_consumed);
+            cursor.buffer->unclaim();
+            if (!refillCursor(cursor)) {
+                merge_heap_.pop_back();
+                continue;
+            }
+        }
+        std::push_heap(merge_heap_.begin(), merge_heap_.end(), laterHead);
+    }
+
+    *next_tsc = merge_heap_.empty() ? UINT64_MAX : merge_heap_.front().timestamp;
+    for (auto& cursor : merge_heap_) {
+        cursor.buffer->consume(cursor.bytes_consumed);
+        cursor.buffer->unclaim();
+    }
+    return num_entries;
+}
+
+static int
+threadBindCore(int i)
+{
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+
+    CPU_SET(i,&mask);
+
+    if(-1 == pthread_setaffinity_np(pthread_self() ,sizeof(mask),&mask))
+    {
+        fprintf(stderr, "pthread_setaffinity_np erro\n");
+        return -1;
+    }
+    return 0;
+}
+
+static bool
+hasWaitpkg()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ecx & bit_WAITPKG) != 0;
+}
+
+__attribute__((target("waitpkg")))
+static void
+tpauseUntil(uint64_t deadline_tsc)
+{
+    // The kernel caps each tpause, see IA32_UMWAIT_CONTROL
+    while (__builtin_ia32_rdtsc() < deadline_tsc)
+        _tpause(1, deadline_tsc);
+}
+
+static void
+pauseUntil(uint64_t deadline_tsc)
+{
+    while (__builtin_ia32_rdtsc() < deadline_tsc)
+        _mm_pause();
+}
+
+void
+BackendWorker::waitIdle(std::unique_lock<std::mutex>& guard, WaitStrategy strategy,
+                        uint32_t max_backoff_us, uint64_t wait_us)
+{
+    static const bool has_waitpkg = hasWaitpkg();
+    switch (strategy) {
+    case kWAIT_BUSY_SPIN:
+        break;
+    case kWAIT_BACKOFF:
+    case kWAIT_TPAUSE: {
+        // From 1us, doubling while the worker stays idle
+        backoff_us_ = std::min<uint64_t>(std::max<uint64_t>(backoff_us_ * 2, 1), max_backoff_us);
+        uint64_t spin_us = std::min<uint64_t>(backoff_us_, wait_us);
+        guard.unlock();
+        uint64_t deadline_tsc = __builtin_ia32_rdtsc() + TscClock::nanosToTicks(clock_, spin_us * 1000);
+        if (strategy == kWAIT_TPAUSE && has_waitpkg)
+            tpauseUntil(deadline_tsc);
+        else
+            pauseUntil(deadline_tsc);
+        guard.lock();
+        break;
+    }
+    default:
+        // Counted first, so that a producer crossing a watermark from now on
+        // notifies, and one that crossed during the pass is not missed
+        backend_.num_sleeping_.fetch_add(1);
+        if (backend_.wakeup_seq_.load() == wakeup_seq_)
+            backend_.wake_up_cond_.wait_for(guard, std::chrono::microseconds(wait_us));
+        backend_.num_sleeping_.fetch_sub(1);
+        break;
+    }
+}
+
+void
+BackendWorker::applyThreadConfig()
+{
+    const std::vector<int>& cpus = backend_.worker_cpus_;
+    if (!cpus.empty())
+        threadBindCore(cpus[index_ % cpus.size()]);
+    else if (node_ >= 0)
+        bindThreadToNumaNode(node_);
+    else
+        threadBindCore((1 + index_) % std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L));
+
+    if (backend_.sched_policy_ != SCHED_OTHER || backend_.sched_priority_ != 0) {
+        struct sched_param param{};
+        param.sched_priority = backend_.sched_priority_;
+        int ret = pthread_setschedparam(pthread_self(), backend_.sched_policy_, &param);
+        if (ret != 0)
+            fprintf(stderr, "Failed to set the scheduling policy of the backend: %s\n", strerror(ret));
+    }
+}
+
+void
+BackendWorker::run()
+{
+    applyThreadConfig();
+
+    // The workers are restarted by setLogFile, only calibrate once
+    if (index_ == 0) {
+        if (backend_.clock_.snapshot().num_calibrations == 0)
+            backend_.clock_.calibrate();
+    } else {
+        while (backend_.clock_.snapshot().num_calibrations == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    clock_ = backend_.clock_.snapshot();
+
+    // Buffers visited in the current pass. Only this thread deletes the
+    // StagingBuffers of its registries, so they stay valid for the whole
+    // pass.
+    std::vector<StagingBuffer *> buffers;
+    std::unique_lock<std::mutex> guard(backend_.buffer_mutex_);
+    while(!backend_.is_stop_ || numBuffers() != 0) {
+        // setLogFile is switching files, write out what was logged before
+        // it was called in a last pass
+        bool exiting = backend_.is_exit_;
+        guard.unlock();
+        // Crossings of the watermarks from now on are seen by this pass or
+        // keep the worker from sleeping after it
+        wakeup_seq_ = backend_.wakeup_seq_.load();
+        uint64_t pass_start_tsc = __builtin_ia32_rdtsc();
+        if (index_ == 0) {
+            if (backend_.clock_.maybeRecalibrate(pass_start_tsc))
+                clock_ = backend_.clock_.snapshot();
+        } else {
+            clock_ = backend_.clock_.snapshot();
+        }
+        pass_start_ns_ = TscClock::toNanos(clock_, pass_start_tsc);
+
+        // The registries are walked unlocked, threads keep registering
+        buffers.clear();
+        forEachSlot([&](StagingRegistry& registry, std::atomic<StagingBuffer*>& slot) {
+            if (slot.load(std::memory_order_acquire) == nullptr)
+                return;
+            StagingBuffer* thread_buffer = releaseDrainedSegments(slot);
+            if (!thread_buffer->checkCanDelete()) {
+                buffers.push_back(thread_buffer);
+                return;
+            }
+            reportDroppedMessages(thread_buffer);
+            std::unique_lock<std::mutex> retire_lock(backend_.retire_mutex_);
+            backend_.retire_version_.fetch_add(1);
+            registry.remove(slot);
+            retireStagingBuffer(thread_buffer, true);
+            backend_.retire_version_.fetch_add(1);
+        });
+        reclaimSegments();
+
+        guard.lock();
+        OutputOrdering ordering = backend_.ordering_;
+        uint32_t reorder_window_us = backend_.reorder_window_us_;
+        WaitStrategy wait_strategy = backend_.wait_strategy_;
+        uint32_t max_backoff_us = backend_.max_backoff_us_;
+        if (index_ == 0 || !batched_) {
+            std::unique_lock<std::mutex> output_lock(backend_.output_mutex_, std::defer_lock);
+            if (batched_)
+                output_lock.lock();
+            output_.configure(backend_.flush_threshold_, backend_.max_latency_us_,
+                              backend_.output_sink_, backend_.queue_depth_,
+                              backend_.writer_cpu_);
+        }
+        timestamp_.setFormat(backend_.timestamp_format_);
+        bool layout_changed = backend_.layout_version_ != active_layout_version_;
+        if (layout_changed) {
+            active_layout_ = backend_.layout_;
+            active_layout_version_ = backend_.layout_version_;
+        }
+        guard.unlock();
+        if (layout_changed) {
+            for (auto& callsite : callsite_cache_)
+                callsite.layout = active_layout_.bind(callsite.static_info, backend_.pid_);
+        }
+
+        bool has_work = false;
+        uint32_t budget = exiting ? 0 : backend_.drain_batch_size_.load();
+        uint64_t wait_us = io_internal;
+        if (ordering == kTIME_ORDERED) {
+            // Entries are only released once they are older than the reorder
+            // window, everything goes out when the worker is stopping
+            uint64_t now_tsc = __builtin_ia32_rdtsc();
+            uint64_t window_ticks = TscClock::nanosToTicks(clock_, reorder_window_us * 1000ULL);
+            uint64_t limit_tsc = backend_.is_stop_ ? UINT64_MAX : now_tsc - window_ticks;
+            uint64_t next_tsc = UINT64_MAX;
+            has_work = mergeLogBuffers(buffers, limit_tsc, budget, &next_tsc) > 0;
+            if (next_tsc != UINT64_MAX) {
+                uint64_t next_us = TscClock::toNanos(clock_, next_tsc + window_ticks) / 1000
+                                    - TscClock::toNanos(clock_, now_tsc) / 1000 + 1;
+                if (next_us < wait_us)
+                    wait_us = next_us;
+            }
+        } else {
+            for (auto thread_buffer : buffers)
+                has_work |= drainLogBuffer(thread_buffer, budget) > 0;
+        }
+        for (auto thread_buffer : buffers)
+            reportDroppedMessages(thread_buffer);
+
+        // The pass goes to the shared output in one piece
+        uint64_t flush_us;
+        int64_t now_ns = TscClock::toNanos(clock_, __builtin_ia32_rdtsc());
+        if (batched_) {
+            std::unique_lock<std::mutex> output_lock(backend_.output_mutex_);
+            if (!batch_.empty())
+                output_.append(batch_.data(), batch_.size(), pass_start_ns_);
+            flush_us = output_.flushIfStale(now_ns);
+            output_lock.unlock();
+            batch_.clear();
+        } else {
+            flush_us = output_.flushIfStale(now_ns);
+        }
+        if (flush_us < wait_us)
+            wait_us = flush_us;
+
+        guard.lock();
+        if (exiting)
+            break;
+        if (!has_work)
+            waitIdle(guard, wait_strategy, max_backoff_us, wait_us);
+        else
+            backoff_us_ = 0;
+    }
+}
+
+void
+BackendWorker::retireStagingBuffer(StagingBuffer* segment, bool last)
+{
+    StagingStats& retired_stats = backend_.retired_stats_;
+    retired_stats.num_messages += segment->num_allocations_;
+    retired_stats.bytes_logged += segment->num_bytes_logged_;
+    retired_stats.num_times_producer_blocked += segment->num_times_producer_blocked_;
+    retired_stats.cycles_producer_blocked += segment->cycles_producer_blocked_;
+    if (last)
+        retired_stats.num_dropped += segment->chain_->num_dropped.load(std::memory_order_relaxed);
+    retired_segments_.push_back(segment);
+}
+
+void
+BackendWorker::reportDroppedMessages(StagingBuffer* thread_buffer)
+{
+    StagingChain* chain = thread_buffer->chain_.get();
+    uint64_t num_dropped = chain->num_dropped.load(std::memory_order_relaxed);
+    if (num_dropped == chain->num_dropped_reported)
+        return;
+
+    // Registered at the first report of any worker
+    static const uint32_t dropped_callsite_id = StaticLogBackend::registerCallsite(&dropped_info);
+    // Written like an entry of the thread, so that the binary output needs
+    // nothing special either
+    char entry[sizeof(LogEntry) + sizeof(uint64_t)];
+    LogEntry* log_entry = (LogEntry*)entry;
+    log_entry->callsite_id = dropped_callsite_id;
+    log_entry->entry_size = sizeof(entry);
+    uint64_t count = num_dropped - chain->num_dropped_reported;
+    memcpy(entry + sizeof(LogEntry), &count, sizeof(count));
+    if (writeLogEntry(log_entry, thread_buffer->getId(), __builtin_ia32_rdtsc(),
+                      entry + sizeof(LogEntry)))
+        chain->num_dropped_reported = num_dropped;
+}
+
+StagingBuffer*
+BackendWorker::releaseDrainedSegments(std::atomic<StagingBuffer*>& slot)
+{
+    StagingBuffer* thread_buffer = slot.load(std::memory_order_relaxed);
+    StagingBuffer* next;
+    while ((next = thread_buffer->next_.load(std::memory_order_acquire)) != nullptr) {
+        uint64_t bytes_available;
+        thread_buffer->peek(&bytes_available);
+        if (bytes_available != 0)
+            break;
+        std::unique_lock<std::mutex> retire_lock(backend_.retire_mutex_);
+        backend_.retire_version_.fetch_add(1);
+        slot.store(next);
+        retireStagingBuffer(thread_buffer, false);
+        backend_.retire_version_.fetch_add(1);
+        thread_buffer = next;
+    }
+    return thread_buffer;
+}
+
+void
+BackendWorker::reclaimSegments()
+{
+    if (retired_segments_.empty())
+        return;
+    // A reader that starts from now on cannot reach them anymore
+    for (size_t i : registries_) {
+        if (backend_.registries_[i].hasReaders())
+            return;
+    }
+    for (auto segment : retired_segments_) {
+        if (backend_.pool_.release(segment->getMemory()))
+            segment->releaseStorage();
+        delete segment;
+    }
+    retired_segments_.clear();
+}
+
+} // details
+
+} // static_log
@@ -0,0 +1,181 @@
+#include "static_log_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/uio.h>
+
+namespace static_log {
+namespace details {
+
+ThreadWriter::ThreadWriter(uint32_t entries, int cpu):
+    completions_(),
+    num_syscalls_(0),
+    fd_(-1),
+    cpu_(cpu),
+    entries_(entries),
+    requests_(new Request[entries]),
+    completions_ring_(new Completion[entries]),
+    request_head_(0),
+    request_tail_(0),
+    completion_head_(0),
+    completion_tail_(0),
+    queued_(0),
+    mutex_(),
+    request_cond_(),
+    completion_cond_(),
+    stop_(false),
+    thread_()
+{
+    thread_ = std::thread(&ThreadWriter::run, this);
+}
+
+ThreadWriter::~ThreadWriter()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    request_cond_.notify_one();
+    lock.unlock();
+    thread_.join();
+}
+
+void
+ThreadWriter::setFd(int fd)
+{
+    // Published to the writer thread by the next submit()
+    fd_ = fd;
+}
+
+bool
+ThreadWriter::queueWrite(const char* data, size_t len, off_t offset, uint64_t user_data)
+{
+    if (queued_ - completion_head_.load(std::memory_order_relaxed) >= entries_)
+        return false;
+    requests_[queued_ % entries_] = Request{data, len, offset, user_data};
+    queued_++;
+    return true;
+}
+
+void
+ThreadWriter::submit()
+{
+    if (request_tail_.load(std::memory_order_relaxed) == queued_)
+        return;
+    request_tail_.store(queued_, std::memory_order_release);
+    std::unique_lock<std::mutex> lock(mutex_);
+    request_cond_.notify_one();
+}
+
+void
+ThreadWriter::reap(uint32_t wait_nr)
+{
+    completions_.clear();
+    uint64_t head = completion_head_.load(std::memory_order_relaxed);
+    if (wait_nr > 0 && completion_tail_.load(std::memory_order_acquire) - head < wait_nr) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        completion_cond_.wait(lock, [&]() {
+            return completion_tail_.load(std::memory_order_acquire) - head >= wait_nr;
+        });
+    }
+
+    uint64_t tail = completion_tail_.load(std::memory_order_acquire);
+    for (; head != tail; ++head)
+        completions_.push_back(completions_ring_[head % entries_]);
+    completion_head_.store(head, std::memory_order_relaxed);
+}
+
+void
+ThreadWriter::run()
+{
+    if (cpu_ >= 0) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu_, &mask);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) != 0)
+            fprintf(stderr, "Failed to pin the log writer thread to cpu %d\n", cpu_);
+    }
+
+    struct iovec iov[IOV_MAX];
+    uint64_t head = request_head_.load(std::memory_order_relaxed);
+    for (;;) {
+        uint64_t tail = request_tail_.load(std::memory_order_acquire);
+        if (head == tail) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            request_cond_.wait(lock, [&]() {
+                return stop_ || request_tail_.load(std::memory_order_acquire) != head;
+            });
+            if (request_tail_.load(std::memory_order_acquire) == head)
+                break;
+            continue;
+        }
+
+        // The chunks of a flush follow each other in the file, they go out
+        // with one pwritev like with the synchronous sink
+        uint64_t end = head;
+        size_t num_iov = 0;
+        off_t offset = requests_[head % entries_].offset;
+        size_t len = 0;
+        while (end != tail && num_iov < IOV_MAX) {
+            const Request& request = requests_[end % entries_];
+            if (request.offset != offset + (off_t)len)
+                break;
+            iov[num_iov].iov_base = (void *)request.data;
+            iov[num_iov].iov_len = request.len;
+            len += request.len;
+            num_iov++;
+            end++;
+        }
+
+        size_t written = 0;
+        int error = 0;
+        struct iovec* first = iov;
+        while (written < len) {
+            ssize_t ret = pwritev(fd_, first, num_iov, offset + written);
+            num_syscalls_.fetch_add(1, std::memory_order_relaxed);
+            if (ret < 0) {
+                if (errno == EINTR)
+                    continue;
+                error = errno;
+                break;
+            }
+            if (ret == 0) {
+                // No progress, retrying would spin
+                error = EIO;
+                break;
+            }
+            written += ret;
+            // Short write, skip what made it to the file
+            while (num_iov > 0 && (size_t)ret >= first->iov_len) {
+                ret -= first->iov_len;
+                first++;
+                num_iov--;
+            }
+            if (num_iov > 0) {
+                first->iov_base = (char *)first->iov_base + ret;
+                first->iov_len -= ret;
+            }
+        }
+
+        // Completions in request order, the ones not entirely written
+        // carry the error
+        uint64_t completion_tail = completion_tail_.load(std::memory_order_relaxed);
+        size_t done = 0;
+        for (; head != end; ++head) {
+            const Request& request = requests_[head % entries_];
+            done += request.len;
+            int64_t res = done <= written ? (int64_t)request.len : -error;
+            completions_ring_[completion_tail++ % entries_] = Completion{request.user_data, res};
+        }
+        request_head_.store(head, std::memory_order_relaxed);
+        completion_tail_.store(completion_tail, std::memory_order_release);
+        std::unique_lock<std::mutex> lock(mutex_);
+        completion_cond_.notify_one();
+    }
+}
+
+} // details
+} // static_log
@@ -0,0 +1,125 @@
+#ifndef STATIC_LOG_WRITER_H
+#define STATIC_LOG_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace static_log {
+namespace details {
+
+/**
+ * Thread writing the output chunks of an OutputBuffer to the log file, so
+ * that the backend worker keeps formatting, and freeing StagingBuffer
+ * space, while a write is stuck on slow storage.
+ *
+ * The writes go through a bounded single-producer single-consumer queue
+ * and come back through another one as completions, the backend worker
+ * being the only producer of the first and consumer of the second. The
+ * writer thread sleeps when there is nothing to write, and the worker
+ * only when it waits for a chunk to be written.
+ */
+class ThreadWriter {
+public:
+    struct Completion {
+        uint64_t user_data;
+        // Bytes written, or -errno
+        int64_t  res;
+    };
+
+    /**
+     * Starts the writer thread.
+     *
+     * \param entries
+     *      Maximum number of writes in flight
+     * \param cpu
+     *      CPU to pin the writer thread to, -1 to leave it unpinned
+     */
+    ThreadWriter(uint32_t entries, int cpu);
+    ~ThreadWriter();
+
+    ThreadWriter(const ThreadWriter&)=delete;
+    ThreadWriter& operator=(const ThreadWriter&)=delete;
+
+    /**
+     * Sets the file writes go to. There must be no write in flight.
+     */
+    void setFd(int fd);
+
+    /**
+     * Queues a write, the writer thread starts on it after the next
+     * submit().
+     *
+     * \return
+     *      false if the queue is full
+     */
+    bool queueWrite(const char* data, size_t len, off_t offset, uint64_t user_data);
+
+    /**
+     * Wakes up the writer thread for the queued writes.
+     */
+    void submit();
+
+    /**
+     * Moves the available completions into completions_.
+     *
+     * \param wait_nr
+     *      Number of completions to wait for
+     */
+    void reap(uint32_t wait_nr);
+
+    // Completions collected by the last reap()
+    std::vector<Completion> completions_;
+
+    // Number of write syscalls issued by the writer thread
+    std::atomic<uint64_t> num_syscalls_;
+
+private:
+    struct Request {
+        const char* data;
+        size_t   len;
+        off_t    offset;
+        uint64_t user_data;
+    };
+
+    void run();
+
+    int fd_;
+    int cpu_;
+
+    // Queue of the writes, and of their completions, of entries_ slots
+    // each. A write is only queued when fewer than entries_ are waiting
+    // to be reaped, so that the completions never overflow. The positions
+    // only grow, the slot is the position modulo entries_.
+    uint32_t entries_;
+    std::unique_ptr<Request[]> requests_;
+    std::unique_ptr<Completion[]> completions_ring_;
+    std::atomic<uint64_t> request_head_;
+    std::atomic<uint64_t> request_tail_;
+    std::atomic<uint64_t> completion_head_;
+    std::atomic<uint64_t> completion_tail_;
+
+    // Position after the last request queued, published by submit()
+    uint64_t queued_;
+
+    // Sleeps of the writer thread on an empty queue, and of the worker on
+    // missing completions
+    std::mutex mutex_;
+    std::condition_variable request_cond_;
+    std::condition_variable completion_cond_;
+    bool stop_;
+
+    std::thread thread_;
+};
+
+} // details
+} // static_log
+
+#endif // STATIC_LOG_WRITER_H
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "static_log_decoder.h"
+
+/**
+ * Renders a log written in the binary output mode (see
+ * static_log::setOutputFormat) as text.
+ *
+ * usage: static_log_decode [-t local_ns|local_us|epoch_ns|iso8601] [-p pattern]
+ *                          <binary log> [output file]
+ */
+
+static bool
+parseTimestampFormat(const char* name, static_log::TimestampFormat* format)
+{
+    static const struct {
+        const char* name;
+        static_log::TimestampFormat format;
+    } formats[] = {
+        {"local_ns", static_log::kLOCAL_NANOSECONDS},
+        {"local_us", static_log::kLOCAL_MICROSECONDS},
+        {"epoch_ns", static_log::kEPOCH_NANOSECONDS},
+        {"iso8601", static_log::kISO8601_UTC},
+    };
+    for (auto& f : formats) {
+        if (strcmp(name, f.name) == 0) {
+            *format = f.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    static_log::TimestampFormat timestamp_format = static_log::kLOCAL_NANOSECONDS;
+    const char* pattern = NULL;
+    while (argc > 2 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-t") == 0) {
+            if (!parseTimestampFormat(argv[2], &timestamp_format)) {
+                fprintf(stderr, "Unknown timestamp format %s\n", argv[2]);
+                return 1;
+            }
+        } else if (strcmp(argv[1], "-p") == 0) {
+            pattern = argv[2];
+        } else {
+            break;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: static_log_decode [-t local_ns|local_us|epoch_ns|iso8601] "
+                        "[-p pattern] <binary log> [output file]\n");
+        return 1;
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Failed to stat %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    char* data = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    FILE* out = stdout;
+    if (argc == 3) {
+        out = fopen(argv[2], "w");
+        if (out == NULL) {
+            fprintf(stderr, "Failed to open %s: %s\n", argv[2], strerror(errno));
+            return 1;
+        }
+    }
+
+    static_log::details::BinaryLogDecoder decoder;
+    decoder.setTimestampFormat(timestamp_format);
+    if (pattern != NULL && !decoder.setLogPattern(pattern))
+        return 1;
+    bool ok = decoder.decode(data, st.st_size, out);
+
+    if (out != stdout)
+        fclose(out);
+    munmap(data, st.st_size);
+    close(fd);
+    return ok ? 0 : 1;
+}
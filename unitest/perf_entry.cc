@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "static_log.h"
+
+/**
+ * Measures the footprint of log entries in the StagingBuffer and the
+ * latency of the STATIC_LOG call for a few message shapes, and compares the
+ * footprint with the former 32 byte entry header (64-bit timestamp, 64-bit
+ * size, StaticInfo and param_size pointers).
+ *
+ * usage: perf_entry [num_messages]
+ */
+
+#define LEGACY_HEADER_SIZE 32
+#define BURST 1000
+
+template<typename Log>
+static void
+perf_entry(const char* name, size_t payload, int num_messages, Log log)
+{
+    std::vector<uint64_t> latencies;
+    latencies.reserve(num_messages);
+    static_log::StagingStats before = static_log::getStagingStats();
+    for (int i = 0; i < num_messages; ++i) {
+        uint64_t start = __builtin_ia32_rdtsc();
+        log(i);
+        latencies.push_back(__builtin_ia32_rdtsc() - start);
+        // Let the backend keep up so that the producer does not block
+        if (i % BURST == BURST - 1)
+            usleep(1000);
+    }
+    static_log::StagingStats after = static_log::getStagingStats();
+
+    double ns_per_tick = static_log::getClockCalibration().ns_per_tick;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[(size_t)(p * (latencies.size() - 1))] * ns_per_tick;
+    };
+
+    double entry_size = (double)(after.bytes_logged - before.bytes_logged)
+                            / (after.num_messages - before.num_messages);
+    double header_size = entry_size - payload;
+    double legacy_size = LEGACY_HEADER_SIZE + payload;
+    printf("%-14s entry %5.1f B (header %4.1f B)  legacy %5.1f B  msgs/buffer %7.0f vs %7.0f (x%.2f)  "
+           "latency p50 %5.1f ns  p99 %6.1f ns  p99.9 %7.1f ns\n",
+           name, entry_size, header_size, legacy_size,
+           static_log::kSTAGING_BUFFER_SIZE / entry_size, static_log::kSTAGING_BUFFER_SIZE / legacy_size,
+           legacy_size / entry_size, percentile(0.5), percentile(0.99), percentile(0.999));
+}
+
+int main(int argc, char** argv)
+{
+    int num_messages = argc > 1 ? atoi(argv[1]) : 100000;
+    static_log::preallocate();
+    static_log::setLogFile("/dev/null");
+    // Let the backend calibrate the clock
+    usleep(50000);
+
+    perf_entry("no argument", 0, num_messages, [](int) {
+        STATIC_LOG(static_log::LogLevels::kNOTICE, "no argument");
+    });
+    perf_entry("%d", sizeof(int), num_messages, [](int i) {
+        STATIC_LOG(static_log::LogLevels::kNOTICE, "%d", i);
+    });
+    perf_entry("%d %d %d", 3 * sizeof(int), num_messages, [](int i) {
+        STATIC_LOG(static_log::LogLevels::kNOTICE, "%d %d %d", i, i + 1, i + 2);
+    });
+    perf_entry("%lu %lf", sizeof(uint64_t) + sizeof(double), num_messages, [](int i) {
+        STATIC_LOG(static_log::LogLevels::kNOTICE, "%lu %lf", (uint64_t)i, i / 3.0);
+    });
+    perf_entry("%s", 1 + 11, num_messages, [](int) {
+        STATIC_LOG(static_log::LogLevels::kNOTICE, "%s", "hello world");
+    });
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "static_log.h"
+
+/**
+ * Latency of the first logging calls of a new thread, right after
+ * preallocate(), for each way of allocating the StagingBuffer. With
+ * malloc() these calls fault in the pages of the buffer.
+ *
+ * usage: perf_first_calls [num_calls]
+ */
+
+struct Mode {
+    const char* name;
+    uint32_t flags;
+};
+
+static const Mode modes[] = {
+    {"malloc", static_log::kSTAGING_MALLOC},
+    {"prefault", static_log::kSTAGING_PREFAULT},
+    {"prefault+hugepages", static_log::kSTAGING_PREFAULT | static_log::kSTAGING_HUGEPAGES},
+    {"prefault+mlock", static_log::kSTAGING_PREFAULT | static_log::kSTAGING_MLOCK},
+};
+
+static void
+perf_first_calls(const Mode& mode, int num_calls, double ns_per_tick)
+{
+    static_log::setStagingMemory(mode.flags);
+    std::vector<uint64_t> ticks(num_calls);
+    long page_faults = 0;
+
+    std::thread thread([&]() {
+        static_log::preallocate();
+        struct rusage before{}, after{};
+        getrusage(RUSAGE_THREAD, &before);
+        for (int i = 0; i < num_calls; ++i) {
+            uint64_t start = __builtin_ia32_rdtsc();
+            STATIC_LOG(static_log::LogLevels::kNOTICE, "order %d filled %s at %lf", i, "all", 3.14);
+            ticks[i] = __builtin_ia32_rdtsc() - start;
+        }
+        getrusage(RUSAGE_THREAD, &after);
+        page_faults = after.ru_minflt - before.ru_minflt;
+    });
+    thread.join();
+
+    std::sort(ticks.begin(), ticks.end());
+    auto percentile = [&](double p) {
+        return ticks[std::min((size_t)(p * num_calls), ticks.size() - 1)] * ns_per_tick;
+    };
+    printf("%-20s p50 %6.0fns p99 %6.0fns p99.9 %7.0fns max %8.0fns page faults %ld\n",
+           mode.name, percentile(0.5), percentile(0.99), percentile(0.999),
+           ticks.back() * ns_per_tick, page_faults);
+}
+
+int main(int argc, char** argv)
+{
+    int num_calls = argc > 1 ? atoi(argv[1]) : 20000;
+
+    // Every thread gets fresh memory
+    static_log::setStagingPoolSize(0);
+    // Waits for the backend to calibrate the clock
+    static_log::setLogFile("perf_first_calls.log");
+    double ns_per_tick = static_log::getClockCalibration().ns_per_tick;
+
+    for (const Mode& mode : modes)
+        perf_first_calls(mode, num_calls, ns_per_tick);
+    static_log::setStagingMemory(static_log::kSTAGING_MALLOC);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "static_log.h"
+#include "static_log_format.h"
+
+/**
+ * Measures the backend cost of rendering a line with formatLogLine, in TSC
+ * ticks per line, for a few line layouts.
+ *
+ * usage: perf_format [iterations]
+ */
+
+using namespace static_log;
+using namespace static_log::details;
+
+static volatile size_t sink;
+
+static const char* patterns[] = {
+    "%v",
+    DEFAULT_LOG_PATTERN,
+    "%T [%l] %t %s:%L %v",
+    "%T %P %t [%l] %f:%L %F() %v",
+};
+
+static void
+perf_format(const char* name, const StaticInfo* static_info, const char* args, int iterations)
+{
+    size_t buflen = DEFALT_CACHE_SIZE;
+    char* buffer = (char*)malloc(buflen);
+    TimestampRenderer timestamp;
+    int64_t now_ns = 1792159677LL * 1000000000;
+
+    for (const char* pattern : patterns) {
+        LineLayout line_layout;
+        line_layout.compile(pattern);
+        CallsiteLayout layout = line_layout.bind(static_info, getpid());
+
+        uint64_t start = __builtin_ia32_rdtsc();
+        for (int i = 0; i < iterations; ++i)
+            sink = sink + formatLogLine(static_info, layout, args, now_ns + i * 100, 7,
+                                        timestamp, buffer, buflen);
+        uint64_t ticks = __builtin_ia32_rdtsc() - start;
+        printf("%-8s %-28s %6.1f ticks/line\n", name, pattern, (double)ticks / iterations);
+    }
+    free(buffer);
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    // As generated by STATIC_LOG
+    static constexpr auto no_types = analyzeFormatString<0>("no parameter");
+    static constexpr auto no_layout = analyzeFormatLayout<0>("no parameter");
+    StaticInfo no_args(0, no_types.data(), ArgTypeList<>::sizes, "no parameter",
+                       LogLevels::kNOTICE, "handleRequest", __FILE__, 1234,
+                       getFormatFunction<no_layout>(ArgTypeList<>{}));
+    perf_format("no args", &no_args, NULL, iterations);
+
+    static constexpr auto int_types = analyzeFormatString<2>("order %d filled %ld");
+    static constexpr auto int_layout = analyzeFormatLayout<2>("order %d filled %ld");
+    StaticInfo int_args(2, int_types.data(), ArgTypeList<int, long>::sizes, "order %d filled %ld",
+                        LogLevels::kWARNING, "processOrderBookUpdate", __FILE__, 56789,
+                        getFormatFunction<int_layout>(ArgTypeList<int, long>{}));
+    char args[sizeof(int) + sizeof(long)];
+    int order = 42;
+    long filled = 1000000007L;
+    memcpy(args, &order, sizeof(order));
+    memcpy(args + sizeof(order), &filled, sizeof(filled));
+    perf_format("int args", &int_args, args, iterations);
+    return 0;
+}
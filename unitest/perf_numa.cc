@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "static_log.h"
+#include "static_log_numa.h"
+
+/**
+ * Throughput of producers spread over the NUMA nodes, with the single
+ * backend worker and with a worker per node. The producers of a node are
+ * pinned to it, so that their StagingBuffers are allocated there.
+ *
+ * usage: perf_numa [threads_per_node] [messages_per_thread]
+ */
+
+using namespace static_log;
+using namespace static_log::details;
+
+#define LOG_FILE "perf_numa.log"
+
+static void
+perf_numa(const char* name, bool numa_workers, int threads_per_node, int num_messages)
+{
+    const std::vector<NumaNode>& nodes = getNumaNodes();
+    setNumaWorkers(numa_workers);
+    unlink(LOG_FILE);
+    setLogFile(LOG_FILE);
+    StagingStats before = getStagingStats();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (const NumaNode& node : nodes) {
+        for (int t = 0; t < threads_per_node; ++t) {
+            threads.emplace_back([&node, t, num_messages]() {
+                bindThreadToNumaNode(node.id);
+                preallocate();
+                for (int i = 0; i < num_messages; ++i)
+                    STATIC_LOG(LogLevels::kNOTICE, "node %d thread %d order %d filled %lf",
+                               node.id, t, i, 3.14);
+            });
+        }
+    }
+    for (auto& thread : threads)
+        thread.join();
+    // Switching files writes out everything logged before
+    setLogFile("perf_numa.last");
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    StagingStats after = getStagingStats();
+    uint64_t num_lines = (uint64_t)nodes.size() * threads_per_node * num_messages;
+    printf("%-16s %9.0f lines/s producers blocked %lu times\n", name, num_lines / seconds,
+           after.num_times_producer_blocked - before.num_times_producer_blocked);
+    unlink(LOG_FILE);
+    unlink("perf_numa.last");
+}
+
+int main(int argc, char** argv)
+{
+    int threads_per_node = argc > 1 ? atoi(argv[1]) : 2;
+    int num_messages = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    for (const NumaNode& node : getNumaNodes()) {
+        printf("node %d: %lu cpus (", node.id, node.cpus.size());
+        for (size_t i = 0; i < node.cpus.size(); ++i)
+            printf(i == 0 ? "%d" : " %d", node.cpus[i]);
+        printf(")\n");
+    }
+
+    perf_numa("single worker", false, threads_per_node, num_messages);
+    perf_numa("worker per node", true, threads_per_node, num_messages);
+    return 0;
+}
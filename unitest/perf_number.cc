@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "static_log.h"
+
+/**
+ * Compares the integer and float formatting kernels used by the backend
+ * with snprintf for a few common specifiers, and the rendering rate of the
+ * float heavy message of perf_latency.
+ *
+ * usage: perf_number [iterations]
+ */
+
+using namespace static_log::details;
+
+#define NUM_VALUES 1024
+
+static volatile size_t sink;
+
+template<typename Format>
+static double
+nsPerCall(int iterations, Format format)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        sink = sink + format(i % NUM_VALUES);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat"
+static void
+perf_integer(const char* fmt, int iterations, const std::vector<uint64_t>& values)
+{
+    FormatSpec spec = parseFormatSpec(fmt, 0);
+    char buffer[128];
+    double kernel = nsPerCall(iterations, [&](int i) {
+        uint64_t magnitude;
+        bool negative;
+        toPrintfInteger(spec.length, spec.conversion, values[i], magnitude, negative);
+        return formatInteger(buffer, sizeof(buffer), spec, spec.width, spec.precision,
+                             magnitude, negative);
+    });
+    double libc = nsPerCall(iterations, [&](int i) {
+        return snprintf(buffer, sizeof(buffer), fmt, values[i]);
+    });
+    printf("%-8s formatInteger %6.1f ns  snprintf %6.1f ns  (x%.1f)\n",
+           fmt, kernel, libc, libc / kernel);
+}
+
+static void
+perf_float(const char* fmt, int iterations, const std::vector<double>& values)
+{
+    FormatSpec spec = parseFormatSpec(fmt, 0);
+    char buffer[128];
+    double kernel = nsPerCall(iterations, [&](int i) {
+        return formatFloat(buffer, sizeof(buffer), spec, spec.width, spec.precision, values[i]);
+    });
+    double libc = nsPerCall(iterations, [&](int i) {
+        return snprintf(buffer, sizeof(buffer), fmt, values[i]);
+    });
+    printf("%-8s formatFloat   %6.1f ns  snprintf %6.1f ns  (x%.1f)\n",
+           fmt, kernel, libc, libc / kernel);
+}
+
+// "%s %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf " as rendered by the generated
+// formatter, and by snprintf
+static void
+perf_float_line(int iterations, const std::vector<double>& values)
+{
+    FormatSpec spec = parseFormatSpec("%lf", 0);
+    char buffer[512];
+    iterations /= 10;
+    double kernel = nsPerCall(iterations, [&](int i) {
+        size_t pos = 11;
+        memcpy(buffer, "hello world", pos);
+        for (int j = 0; j < 10; ++j) {
+            buffer[pos++] = ' ';
+            pos += formatFloat(buffer + pos, sizeof(buffer) - pos, spec, 0, -1, values[i]);
+        }
+        buffer[pos++] = ' ';
+        return pos;
+    });
+    double libc = nsPerCall(iterations, [&](int i) {
+        double v = values[i];
+        return snprintf(buffer, sizeof(buffer), "%s %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf ",
+                        "hello world", v, v, v, v, v, v, v, v, v, v);
+    });
+    printf("float line: formatFloat %.0f lines/s  snprintf %.0f lines/s  (x%.1f)\n",
+           1e9 / kernel, 1e9 / libc, libc / kernel);
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 10000000;
+    std::vector<uint64_t> small, large;
+    srand(1);
+    for (int i = 0; i < NUM_VALUES; ++i) {
+        small.push_back(rand() % 10000);
+        large.push_back(((uint64_t)rand() << 33) ^ rand());
+    }
+
+    perf_integer("%d", iterations, small);
+    perf_integer("%lu", iterations, large);
+    perf_integer("%ld", iterations, large);
+    perf_integer("%08x", iterations, small);
+    perf_integer("%lx", iterations, large);
+    perf_integer("%-12lu", iterations, large);
+
+    std::vector<double> doubles;
+    for (int i = 0; i < NUM_VALUES; ++i)
+        doubles.push_back((rand() % 1000000) / 1000.0);
+    perf_float("%lf", iterations, doubles);
+    perf_float("%.3f", iterations, doubles);
+    perf_float("%e", iterations, doubles);
+    perf_float("%g", iterations, doubles);
+    perf_float("%a", iterations, doubles);
+    perf_float_line(iterations, doubles);
+    return 0;
+}
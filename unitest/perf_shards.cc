@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "static_log.h"
+
+/**
+ * Backend throughput against the number of backend workers: many threads
+ * log a burst each and the time runs until every line is written out, with
+ * the workers merging into the log file and with a file per worker.
+ *
+ * usage: perf_shards [threads] [messages_per_thread] [max_workers]
+ */
+
+using namespace static_log;
+
+#define LOG_FILE "perf_shards.log"
+
+static void
+unlinkFiles(uint32_t num_workers)
+{
+    unlink(LOG_FILE);
+    for (uint32_t i = 1; i < num_workers; ++i)
+        unlink((std::string(LOG_FILE) + "." + std::to_string(i)).c_str());
+}
+
+static void
+perf_shards(uint32_t num_workers, ShardOutput output, int num_threads, int num_messages)
+{
+    unlinkFiles(num_workers);
+    setLogFile(LOG_FILE);
+    setBackendWorkers(num_workers, output);
+    StagingStats before = getStagingStats();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([t, num_messages]() {
+            preallocate();
+            for (int i = 0; i < num_messages; ++i)
+                STATIC_LOG(LogLevels::kNOTICE, "thread %d order %d filled %lf", t, i, 3.14);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    // Switching files writes out everything logged before
+    setLogFile("perf_shards.last");
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    StagingStats after = getStagingStats();
+    uint64_t num_lines = (uint64_t)num_threads * num_messages;
+    printf("%2u workers %-7s %10.0f lines/s producers blocked %lu times\n", num_workers,
+           output == kSHARD_FILES ? "files" : "merged", num_lines / seconds,
+           after.num_times_producer_blocked - before.num_times_producer_blocked);
+    unlinkFiles(num_workers);
+    unlink("perf_shards.last");
+}
+
+int main(int argc, char** argv)
+{
+    int num_threads = argc > 1 ? atoi(argv[1]) : 48;
+    int num_messages = argc > 2 ? atoi(argv[2]) : 200000;
+    uint32_t max_workers = argc > 3 ? atoi(argv[3]) : 8;
+
+    for (uint32_t num_workers = 1; num_workers <= max_workers; num_workers *= 2) {
+        perf_shards(num_workers, kMERGED_OUTPUT, num_threads, num_messages);
+        if (num_workers > 1)
+            perf_shards(num_workers, kSHARD_FILES, num_threads, num_messages);
+    }
+    return 0;
+}
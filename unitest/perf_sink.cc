@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <string>
+
+#include "static_log.h"
+
+/**
+ * Compares the synchronous, io_uring and writer thread sinks. For every
+ * directory given on the command line (tmpfs and a real disk by default) a
+ * producer logs a burst of fixed size messages and the time until the
+ * backend has written all of them is measured.
+ *
+ * usage: perf_sink [num_messages] [dir ...]
+ */
+
+static uint64_t
+now_ns()
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+log_one(int i)
+{
+    STATIC_LOG(static_log::LogLevels::kNOTICE, "%08d %s", i, "the quick brown fox jumps over the lazy dog");
+}
+
+static uint64_t
+wait_bytes(uint64_t bytes)
+{
+    while (static_log::getOutputStats().bytes_written < bytes)
+        usleep(100);
+    return static_log::getOutputStats().bytes_written;
+}
+
+static void
+perf_sink(const char* dir, static_log::OutputSink sink, int num_messages)
+{
+    std::string path = std::string(dir) + "/perf_sink.log";
+    unlink(path.c_str());
+    static_log::setOutputSink(sink);
+    static_log::setLogFile(path.c_str());
+
+    // All lines have the same size, measure it with a first message
+    uint64_t base = static_log::getOutputStats().bytes_written;
+    log_one(0);
+    uint64_t line_len = wait_bytes(base + 1) - base;
+
+    static_log::OutputStats before = static_log::getOutputStats();
+    uint64_t begin = now_ns();
+    for (int i = 0; i < num_messages; ++i)
+        log_one(i);
+    uint64_t produced = now_ns();
+    wait_bytes(before.bytes_written + line_len * num_messages);
+    uint64_t end = now_ns();
+    static_log::OutputStats after = static_log::getOutputStats();
+
+    uint64_t flushes = after.num_flushes - before.num_flushes;
+    uint64_t syscalls = after.num_syscalls - before.num_syscalls;
+    const char* sink_name = after.active_sink == static_log::kIO_URING ? "io_uring"
+                          : after.active_sink == static_log::kWRITER_THREAD ? "writer" : "sync";
+    printf("%-12s %-10s lines/s %10.0f  producer %6lums  total %6lums  flushes %5lu  syscalls %5lu  bytes/flush %8lu\n",
+        dir, sink_name,
+        num_messages * 1e9 / (end - begin), (produced - begin) / 1000000, (end - begin) / 1000000,
+        flushes, syscalls, flushes ? (after.bytes_written - before.bytes_written) / flushes : 0);
+    unlink(path.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    int num_messages = argc > 1 ? atoi(argv[1]) : 1000000;
+    static_log::preallocate();
+    static_log::setOutputBuffering(1024 * 1024, 1000);
+    const char* default_dirs[] = {"/dev/shm", "."};
+    int num_dirs = argc > 2 ? argc - 2 : 2;
+    for (int i = 0; i < num_dirs; ++i) {
+        const char* dir = argc > 2 ? argv[i + 2] : default_dirs[i];
+        perf_sink(dir, static_log::kSYNC_WRITE, num_messages);
+        perf_sink(dir, static_log::kIO_URING, num_messages);
+        perf_sink(dir, static_log::kWRITER_THREAD, num_messages);
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "static_log.h"
+
+/**
+ * Latency and idle CPU cost of the wait strategies of the backend. A
+ * message is logged after the backend went idle, and the time until it is
+ * written out is measured; then the CPU time the process burns while
+ * nothing is logged, which is the backend's.
+ *
+ * usage: perf_wait [samples] [backend_cpu]
+ */
+
+using namespace static_log;
+
+#define LOG_FILE "perf_wait.log"
+
+static uint64_t
+now_ns()
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t
+cpu_ns()
+{
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+static void
+perf_wait(const char* name, WaitStrategy strategy, int num_samples)
+{
+    setBackendWaitStrategy(strategy);
+    std::vector<uint64_t> latencies;
+    for (int i = 0; i < num_samples; ++i) {
+        // Long enough for the backoff to reach its limit
+        usleep(500);
+        uint64_t bytes = getOutputStats().bytes_written;
+        uint64_t start = now_ns();
+        STATIC_LOG(LogLevels::kNOTICE, "sample %d", i);
+        while (getOutputStats().bytes_written == bytes)
+            ;
+        latencies.push_back(now_ns() - start);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    uint64_t wall_start = now_ns();
+    uint64_t cpu_start = cpu_ns();
+    usleep(500000);
+    double idle_cpu = 100.0 * (cpu_ns() - cpu_start) / (now_ns() - wall_start);
+
+    printf("%-10s latency us p50 %8.1f  p99 %8.1f  max %8.1f  idle cpu %5.1f%%\n", name,
+           latencies[latencies.size() / 2] / 1e3, latencies[latencies.size() * 99 / 100] / 1e3,
+           latencies.back() / 1e3, idle_cpu);
+}
+
+int main(int argc, char** argv)
+{
+    int num_samples = argc > 1 ? atoi(argv[1]) : 1000;
+    if (argc > 2) {
+        int cpu = atoi(argv[2]);
+        setBackendThreads(&cpu, 1);
+    }
+
+    unlink(LOG_FILE);
+    setLogFile(LOG_FILE);
+    // Written out at the end of every pass of the backend
+    setOutputBuffering(4096, 0);
+    preallocate();
+
+    perf_wait("sleep", kWAIT_SLEEP, num_samples);
+    perf_wait("busy-spin", kWAIT_BUSY_SPIN, num_samples);
+    perf_wait("backoff", kWAIT_BACKOFF, num_samples);
+    perf_wait("tpause", kWAIT_TPAUSE, num_samples);
+    setBackendWaitStrategy(kWAIT_SLEEP);
+    unlink(LOG_FILE);
+    return 0;
+}
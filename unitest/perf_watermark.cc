@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "static_log.h"
+
+/**
+ * Producer blocking under bursty load with and without the fill watermark
+ * of the StagingBuffers. Each thread logs bursts larger than its buffer
+ * after pauses long enough for the backend to go to sleep.
+ *
+ * usage: perf_watermark [threads] [bursts] [messages_per_burst] [buffer_size]
+ */
+
+using namespace static_log;
+
+#define LOG_FILE "perf_watermark.log"
+
+static void
+perf_watermark(uint32_t watermark, int num_threads, int num_bursts, int burst_size,
+               size_t buffer_size)
+{
+    unlink(LOG_FILE);
+    setLogFile(LOG_FILE);
+    setStagingWatermark(watermark);
+    StagingStats before = getStagingStats();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([=]() {
+            preallocate(buffer_size);
+            for (int burst = 0; burst < num_bursts; ++burst) {
+                usleep(5000);
+                for (int i = 0; i < burst_size; ++i)
+                    STATIC_LOG(LogLevels::kNOTICE, "thread %d burst %d order %d filled %lf",
+                               t, burst, i, 3.14);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    // Switching files writes out everything logged before
+    setLogFile("perf_watermark.last");
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    StagingStats after = getStagingStats();
+    printf("watermark %3u%% producers blocked %6lu times %10lu cycles  wakeups %6lu  %.2fs\n",
+           watermark, after.num_times_producer_blocked - before.num_times_producer_blocked,
+           after.cycles_producer_blocked - before.cycles_producer_blocked,
+           after.num_watermark_wakeups - before.num_watermark_wakeups, seconds);
+    unlink(LOG_FILE);
+    unlink("perf_watermark.last");
+}
+
+int main(int argc, char** argv)
+{
+    int num_threads = argc > 1 ? atoi(argv[1]) : 4;
+    int num_bursts = argc > 2 ? atoi(argv[2]) : 100;
+    int burst_size = argc > 3 ? atoi(argv[3]) : 50000;
+    size_t buffer_size = argc > 4 ? atol(argv[4]) : 1 << 20;
+
+    for (uint32_t watermark : {0u, 75u, 50u, 25u})
+        perf_watermark(watermark, num_threads, num_bursts, burst_size, buffer_size);
+    setStagingWatermark(50);
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "static_log.h"
 
+#include <stdio.h>
+
 int main()
 {
     static_log::preallocate();
@@ -33,6 +35,10 @@ int main()
     static_log::setLogLevel(static_log::LogLevels::kNOTICE);
     STATIC_LOG(static_log::LogLevels::kDEBUG, "%s", "hello world");
     static_log::setLogFile("log_.txt");
+    static_log::setClockRecalibrationInterval(100);
+    static_log::ClockCalibration calibration = static_log::getClockCalibration();
+    printf("ns_per_tick %.6f calibrations %lu drift %ldns\n", calibration.ns_per_tick,
+        calibration.num_calibrations, calibration.last_drift_ns);
     // STATIC_LOG(static_log::LogLevels::kNOTICE, "%s", "hello world");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+#include "static_log_decoder.h"
+
+using namespace static_log;
+using namespace static_log::details;
+
+#define TIEMSTAMP_PREFIX_LEN 31
+
+static void
+logMessages(int n)
+{
+    for (int i = 0; i < n; ++i) {
+        STATIC_LOG(LogLevels::kNOTICE, "int %d uint %u long %ld char %c", -i, i, i * 1000000007L, (char)('a' + i % 26));
+        STATIC_LOG(LogLevels::kWARNING, "str %s short str %.3s double %.3lf", "hello", "abcdef", i / 7.0);
+        STATIC_LOG(LogLevels::kERROR, "no parameter");
+    }
+}
+
+static std::string
+readFile(const char* path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+// Lines without their timestamp, which differs between the two runs
+static std::vector<std::string>
+stripTimestamps(const std::string& text)
+{
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line))
+        lines.push_back(line.substr(TIEMSTAMP_PREFIX_LEN));
+    return lines;
+}
+
+TEST(test_binary, test_decode_matches_text)
+{
+    const char* text_path = "test_binary.txt";
+    const char* binary_path = "test_binary.bin";
+    const char* last_path = "test_binary.last";
+    unlink(text_path);
+    unlink(binary_path);
+    unlink(last_path);
+
+    setOutputFormat(kTEXT);
+    setLogFile(text_path);
+    logMessages(1000);
+    setOutputFormat(kBINARY);
+    setLogFile(binary_path);
+    logMessages(1000);
+    // Switching files writes out everything logged before
+    setOutputFormat(kTEXT);
+    setLogFile(last_path);
+
+    std::string text = readFile(text_path);
+    std::string binary = readFile(binary_path);
+    ASSERT_FALSE(binary.empty());
+    EXPECT_LT(binary.size(), text.size());
+
+    char* decoded = NULL;
+    size_t decoded_len = 0;
+    FILE* out = open_memstream(&decoded, &decoded_len);
+    BinaryLogDecoder decoder;
+    ASSERT_TRUE(decoder.decode(binary.data(), binary.size(), out));
+    fclose(out);
+    EXPECT_EQ(decoder.getNumMessages(), 3000u);
+
+    std::vector<std::string> expected = stripTimestamps(text);
+    std::vector<std::string> lines = stripTimestamps(std::string(decoded, decoded_len));
+    free(decoded);
+    ASSERT_EQ(expected.size(), 3000u);
+    EXPECT_EQ(lines, expected);
+
+    // A record cut by a crash is skipped
+    BinaryLogDecoder truncated;
+    out = fopen("/dev/null", "w");
+    EXPECT_TRUE(truncated.decode(binary.data(), binary.size() - 1, out));
+    fclose(out);
+    EXPECT_EQ(truncated.getNumMessages(), 2999u);
+
+    unlink(text_path);
+    unlink(binary_path);
+    unlink(last_path);
+}
+
+static void
+writeGarbage(const char* path, size_t len)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::string line(99, 'l');
+    line += '\n';
+    for (size_t i = 0; i < len; i += line.size())
+        out << line;
+}
+
+TEST(test_binary, test_overwrite_longer_file)
+{
+    // The binary logs, of the main file and of a shard file, reuse longer
+    // files and must not keep their tail
+    const char* paths[] = {"test_binary_reused.bin", "test_binary_reused.bin.1"};
+    const char* last_path = "test_binary.last";
+    for (auto path : paths)
+        writeGarbage(path, 320 * 1024);
+
+    setOutputFormat(kBINARY);
+    setLogFile(paths[0]);
+    setBackendWorkers(2, kSHARD_FILES);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back(logMessages, 100);
+    for (auto& thread : threads)
+        thread.join();
+    setBackendWorkers(1);
+    setOutputFormat(kTEXT);
+    setLogFile(last_path);
+
+    uint64_t num_messages = 0;
+    for (auto path : paths) {
+        std::string binary = readFile(path);
+        EXPECT_LT(binary.size(), 320u * 1024) << path;
+        BinaryLogDecoder decoder;
+        FILE* out = fopen("/dev/null", "w");
+        EXPECT_TRUE(decoder.decode(binary.data(), binary.size(), out)) << path;
+        fclose(out);
+        num_messages += decoder.getNumMessages();
+        unlink(path);
+    }
+    EXPECT_EQ(num_messages, 1200u);
+    unlink(last_path);
+}
+
+TEST(test_binary, test_reject_text)
+{
+    const char text[] = "[2024-01-01-00:00:00.000000000][notice][main][1]hello\n";
+    BinaryLogDecoder decoder;
+    EXPECT_FALSE(decoder.decode(text, sizeof(text) - 1, stdout));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
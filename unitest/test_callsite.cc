@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+
+using namespace static_log;
+
+#define NUM_THREADS 8
+#define NUM_MESSAGES 5000
+
+/**
+ * Every thread logs through the same call site with a string of its own
+ * length, so the argument sizes of concurrent messages differ.
+ */
+static void
+logFromThread(int thread_id)
+{
+    std::string str(1 + thread_id * 13, 'a' + thread_id);
+    for (int i = 0; i < NUM_MESSAGES; ++i)
+        STATIC_LOG(LogLevels::kNOTICE, "%d|%s|%d|%lu", thread_id, str.c_str(), i, (uint64_t)i * thread_id);
+}
+
+static void
+logSharedCallsite(const char* path)
+{
+    unlink(path);
+    setLogFile(path);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; ++t)
+        threads.emplace_back(logFromThread, t);
+    for (auto& thread : threads)
+        thread.join();
+    // Switching files writes out everything logged before
+    setLogFile("test_callsite.last");
+    unlink("test_callsite.last");
+}
+
+TEST(test_callsite, test_shared_callsite_text)
+{
+    const char* path = "test_callsite.txt";
+    logSharedCallsite(path);
+
+    std::ifstream in(path);
+    std::string line;
+    std::vector<int> next(NUM_THREADS, 0);
+    int num_lines = 0;
+    while (std::getline(in, line)) {
+        size_t prefix_end = line.rfind(']');
+        ASSERT_NE(prefix_end, std::string::npos) << line;
+        std::string message = line.substr(prefix_end + 1);
+
+        int thread_id, seq;
+        unsigned long product;
+        char str[256];
+        ASSERT_EQ(sscanf(message.c_str(), "%d|%255[^|]|%d|%lu", &thread_id, str, &seq, &product), 4) << line;
+        ASSERT_GE(thread_id, 0);
+        ASSERT_LT(thread_id, NUM_THREADS);
+        EXPECT_EQ(std::string(str), std::string(1 + thread_id * 13, 'a' + thread_id)) << line;
+        // Messages of a thread stay in order
+        EXPECT_EQ(seq, next[thread_id]) << line;
+        EXPECT_EQ(product, (unsigned long)seq * thread_id) << line;
+        next[thread_id] = seq + 1;
+        num_lines++;
+    }
+    EXPECT_EQ(num_lines, NUM_THREADS * NUM_MESSAGES);
+    unlink(path);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+#include "static_log_clock.h"
+
+using namespace static_log;
+using static_log::details::TscClock;
+
+#define CLOCK_LOG_FILE "test_clock.txt"
+
+// Error allowed to the TSC model against the wall clock
+#define MODEL_ERROR_NS 100000
+
+static int64_t
+wallClockNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+TEST(test_clock, test_timestamp_matches_wall_clock)
+{
+    unlink(CLOCK_LOG_FILE);
+    setTimestampFormat(kEPOCH_NANOSECONDS);
+    setLogFile(CLOCK_LOG_FILE);
+    int64_t before_ns = wallClockNanos();
+    STATIC_LOG(LogLevels::kNOTICE, "%s", "stamped");
+    int64_t after_ns = wallClockNanos();
+    // Switching files writes out everything logged before
+    setLogFile("test_clock.last");
+    setTimestampFormat(kLOCAL_NANOSECONDS);
+
+    std::ifstream in(CLOCK_LOG_FILE);
+    std::string line;
+    ASSERT_TRUE(std::getline(in, line));
+    int64_t timestamp_ns;
+    ASSERT_EQ(sscanf(line.c_str(), "[%ld]", &timestamp_ns), 1) << line;
+    EXPECT_GE(timestamp_ns, before_ns - MODEL_ERROR_NS) << line;
+    EXPECT_LE(timestamp_ns, after_ns + MODEL_ERROR_NS) << line;
+    EXPECT_GT(getClockCalibration().num_calibrations, 0u);
+    unlink(CLOCK_LOG_FILE);
+    unlink("test_clock.last");
+}
+
+TEST(test_clock, test_recalibration_interval)
+{
+    setLogFile("test_clock.last");
+    setClockRecalibrationInterval(10);
+    ClockCalibration before = getClockCalibration();
+    EXPECT_EQ(before.recalibrate_interval_ms, 10u);
+    // The backend recalibrates on its passes, keep it busy for a while
+    for (int i = 0; i < 40; ++i) {
+        STATIC_LOG(LogLevels::kNOTICE, "recalibrate %d", i);
+        static_log::sync();
+        usleep(5000);
+    }
+    ClockCalibration after = getClockCalibration();
+    EXPECT_GT(after.num_calibrations, before.num_calibrations);
+    EXPECT_GT(after.ns_per_tick, 0.0);
+    EXPECT_GE(after.base_tsc, before.base_tsc);
+    setClockRecalibrationInterval(1000);
+    unlink("test_clock.last");
+}
+
+TEST(test_clock, test_step_threshold)
+{
+    const int64_t second_ns = 1000000000;
+    // 10ppm of frequency error over a long interval is drift, a step of
+    // the wall clock is much larger than any
+    EXPECT_FALSE(TscClock::isStep(36000000, 3600 * second_ns));
+    EXPECT_FALSE(TscClock::isStep(-36000000, 3600 * second_ns));
+    EXPECT_TRUE(TscClock::isStep(5 * second_ns, 3600 * second_ns));
+    EXPECT_TRUE(TscClock::isStep(-5 * second_ns, 3600 * second_ns));
+
+    // The same drift over the default interval is a step
+    EXPECT_TRUE(TscClock::isStep(36000000, second_ns));
+    EXPECT_FALSE(TscClock::isStep(50000, second_ns));
+
+    // Short intervals keep a floor for the jitter of the samples
+    EXPECT_FALSE(TscClock::isStep(20000, 10000000));
+    EXPECT_TRUE(TscClock::isStep(1000000, 10000000));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
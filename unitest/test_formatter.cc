@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+
+using namespace static_log;
+using namespace static_log::details;
+
+// Start with a tiny buffer so that the formatters have to grow it
+#define INITIAL_BUFFER_SIZE 8
+#define PREFIX "[prefix]"
+
+template<typename... Ts>
+static void
+expectFormatted(FormatFunction format_function, const char* args, const char* fmt, Ts... values)
+{
+    int expected_len = snprintf(NULL, 0, fmt, values...);
+    std::string expected(expected_len + 1, '\0');
+    snprintf(&expected[0], expected.size(), fmt, values...);
+    expected.resize(expected_len);
+
+    size_t buflen = INITIAL_BUFFER_SIZE;
+    char* buffer = (char*)malloc(buflen);
+    memcpy(buffer, PREFIX, strlen(PREFIX));
+    int end = format_function(args, buffer, buflen, strlen(PREFIX));
+    ASSERT_GE(end, (int)strlen(PREFIX)) << fmt;
+    EXPECT_LE((size_t)end, buflen);
+    EXPECT_EQ(std::string(buffer, end), PREFIX + expected) << fmt;
+    free(buffer);
+}
+
+// Stores the arguments like STATIC_LOG does and renders them with the
+// formatter generated for the format string
+#define EXPECT_FORMATTED(fmt, ...) do { \
+    constexpr int n_params = countFmtParams(fmt); \
+    static constexpr std::array<ParamType, n_params> param_types = analyzeFormatString<n_params>(fmt); \
+    static constexpr auto layout = analyzeFormatLayout<n_params>(fmt); \
+    using arg_types = decltype(argTypeList(__VA_ARGS__)); \
+    FormatFunction format_function = getFormatFunction<layout>(arg_types{}); \
+    ASSERT_NE(format_function, nullptr) << fmt; \
+    size_t string_sizes[n_params + 1]; \
+    uint64_t previous_precision = -1; \
+    std::vector<char> args(getArgSizes(param_types, previous_precision, string_sizes, ##__VA_ARGS__) + 1); \
+    char* write_pos = args.data(); \
+    storeArguments(param_types, string_sizes, &write_pos, ##__VA_ARGS__); \
+    expectFormatted(format_function, args.data(), fmt, ##__VA_ARGS__); \
+} while (0)
+
+TEST(test_formatter, test_literals)
+{
+    EXPECT_FORMATTED("");
+    EXPECT_FORMATTED("no parameter");
+    EXPECT_FORMATTED("100%% done %%");
+    EXPECT_FORMATTED("%%%d%%", 5);
+    EXPECT_FORMATTED("a long literal text that does not fit in the initial buffer %d and more text after", 1);
+}
+
+TEST(test_formatter, test_integers)
+{
+    EXPECT_FORMATTED("%d %i", -42, 42);
+    EXPECT_FORMATTED("%5d|%-5d|%05d|%+d|% d", 1, 2, 3, 4, 5);
+    EXPECT_FORMATTED("%u %x %X %#x %o %#o", 42u, 255u, 255u, 255u, 8u, 8u);
+    EXPECT_FORMATTED("%hhd %hhu %hd %hu", (signed char)-5, (unsigned char)250, (short)-300, (unsigned short)60000);
+    EXPECT_FORMATTED("%ld %lu %lld %llu", -1234567890123L, 1234567890123UL, INT64_MIN, UINT64_MAX);
+    EXPECT_FORMATTED("%zu %jd", (size_t)77, (intmax_t)-77);
+    EXPECT_FORMATTED("%c%c %d", (char)'x', 'y', (int)true);
+}
+
+TEST(test_formatter, test_floats)
+{
+    EXPECT_FORMATTED("%f %.3f %10.4f %-10.2f|", 3.14159, 2.71828, -1.5, 0.25);
+    EXPECT_FORMATTED("%e %E %g %G %a", 12345.678, 0.000123, 1e20, 1e-5, 1.0);
+    EXPECT_FORMATTED("%f %.1lf", 1.5f, 2.25);
+    EXPECT_FORMATTED("%Lf", (long double)1.125);
+}
+
+TEST(test_formatter, test_strings)
+{
+    const char* str = "hello world";
+    char buffer[] = "mutable";
+    EXPECT_FORMATTED("%s", str);
+    EXPECT_FORMATTED("[%s] [%s]", buffer, "");
+    EXPECT_FORMATTED("%.5s|%10s|%-10s|%10.3s|", str, "right", "left", "truncated");
+    EXPECT_FORMATTED("%.*s|%*s|%-*.*s|", 4, str, 8, "w", 6, 2, "abc");
+    EXPECT_FORMATTED("%p", (const void*)str);
+    EXPECT_FORMATTED("%p", str);
+
+    std::string long_string(5000, 'z');
+    EXPECT_FORMATTED("long %s end", long_string.c_str());
+}
+
+TEST(test_formatter, test_dynamic_width_precision)
+{
+    EXPECT_FORMATTED("%*d|%-*d|%.*f|%*.*f|", 6, 42, 6, 42, 2, 3.14159, 10, 3, 2.5);
+    EXPECT_FORMATTED("%*.*s and %d", 12, 3, "abcdef", 7);
+}
+
+TEST(test_formatter, test_fallback)
+{
+    // A specifier longer than kMAX_SPEC_LEN is left to the runtime parser
+    constexpr int n_params = countFmtParams("%0000000000000000000000000000001d");
+    static constexpr auto layout = analyzeFormatLayout<n_params>("%0000000000000000000000000000001d");
+    EXPECT_FALSE(layout.valid);
+    EXPECT_EQ(getFormatFunction<layout>(ArgTypeList<int>{}), nullptr);
+
+    // So are arguments not matching the format string
+    static constexpr auto string_layout = analyzeFormatLayout<1>("%s");
+    EXPECT_EQ(getFormatFunction<string_layout>(ArgTypeList<int>{}), nullptr);
+    EXPECT_EQ(getFormatFunction<string_layout>(ArgTypeList<const char*, int>{}), nullptr);
+    EXPECT_NE(getFormatFunction<string_layout>(ArgTypeList<const char*>{}), nullptr);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
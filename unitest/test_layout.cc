@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+#include "static_log_format.h"
+
+using namespace static_log;
+using namespace static_log::details;
+
+// 2026-10-16 14:07:57.581963213 UTC
+#define TIMESTAMP_NS (1792159677LL * 1000000000 + 581963213)
+
+static constexpr auto param_types = analyzeFormatString<2>("order %d filled %s");
+static constexpr auto format_layout = analyzeFormatLayout<2>("order %d filled %s");
+static const StaticInfo static_info(2, param_types.data(), ArgTypeList<int, const char*>::sizes,
+                                    "order %d filled %s", LogLevels::kWARNING, "process",
+                                    "src/orders/book.cc", 42,
+                                    getFormatFunction<format_layout>(ArgTypeList<int, const char*>{}));
+
+// Renders a line of static_info with the arguments 7 and "all"
+static std::string
+renderLine(const char* pattern, uint32_t thread_id = 3, uint32_t pid = 1234)
+{
+    char args[64];
+    size_t pos = 0;
+    int order = 7;
+    memcpy(args, &order, sizeof(order));
+    pos += sizeof(order);
+    char* end = encodeVarint(args + pos, 3);
+    memcpy(end, "all", 3);
+
+    LineLayout line_layout;
+    EXPECT_TRUE(line_layout.compile(pattern));
+    CallsiteLayout layout = line_layout.bind(&static_info, pid);
+    TimestampRenderer timestamp(kISO8601_UTC);
+    size_t buflen = DEFALT_CACHE_SIZE;
+    char* buffer = (char*)malloc(buflen);
+    int len = formatLogLine(&static_info, layout, args, TIMESTAMP_NS, thread_id,
+                            timestamp, buffer, buflen);
+    std::string line = len > 0 ? std::string(buffer, len) : std::string();
+    free(buffer);
+    return line;
+}
+
+TEST(test_layout, test_default_pattern)
+{
+    EXPECT_EQ(renderLine(DEFAULT_LOG_PATTERN),
+              "[2026-10-16T14:07:57.581963213Z][warn][process][42]order 7 filled all\n");
+}
+
+TEST(test_layout, test_fields)
+{
+    EXPECT_EQ(renderLine("%T [%l] %t %s:%L %v"),
+              "2026-10-16T14:07:57.581963213Z [warn] 3 book.cc:42 order 7 filled all\n");
+    EXPECT_EQ(renderLine("%P/%t %f %F() %v", 4000000000u, 99),
+              "99/4000000000 src/orders/book.cc process() order 7 filled all\n");
+    EXPECT_EQ(renderLine("%v"), "order 7 filled all\n");
+    EXPECT_EQ(renderLine("<%v|%v> 100%%"), "<order 7 filled all|order 7 filled all> 100%\n");
+    EXPECT_EQ(renderLine("no message"), "no message\n");
+    EXPECT_EQ(renderLine(""), "\n");
+}
+
+TEST(test_layout, test_static_fields_are_bound)
+{
+    LineLayout line_layout;
+    ASSERT_TRUE(line_layout.compile("[%l] %t %s:%L %F %P %v!"));
+    CallsiteLayout layout = line_layout.bind(&static_info, 1234);
+    // Only the thread id and the message are left between the texts
+    ASSERT_EQ(layout.ops.size(), 5u);
+    EXPECT_EQ(layout.ops[0].type, LayoutOp::kLITERAL);
+    EXPECT_EQ(layout.ops[1].type, LayoutOp::kTHREAD_ID);
+    EXPECT_EQ(layout.ops[2].type, LayoutOp::kLITERAL);
+    EXPECT_EQ(layout.ops[3].type, LayoutOp::kMESSAGE);
+    EXPECT_EQ(layout.ops[4].type, LayoutOp::kLITERAL);
+    EXPECT_EQ(layout.text, "[warn]  book.cc:42 process 1234 !");
+}
+
+TEST(test_layout, test_invalid_pattern)
+{
+    LineLayout line_layout;
+    EXPECT_FALSE(line_layout.compile("%T %x %v"));
+    EXPECT_FALSE(line_layout.compile("%v %"));
+    // The previous layout is kept
+    EXPECT_EQ(line_layout.getPattern(), DEFAULT_LOG_PATTERN);
+}
+
+TEST(test_layout, test_grows_buffer)
+{
+    // A prefix longer than the buffer
+    std::string pattern(DEFALT_CACHE_SIZE + 100, 'x');
+    pattern += "%v";
+    std::string line = renderLine(pattern.c_str());
+    EXPECT_EQ(line.size(), DEFALT_CACHE_SIZE + 100 + strlen("order 7 filled all\n"));
+    EXPECT_EQ(line.substr(DEFALT_CACHE_SIZE + 100), "order 7 filled all\n");
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
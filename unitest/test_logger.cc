@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+
+using namespace static_log;
+
+static int
+countLines(const char* path, const char* needle)
+{
+    std::ifstream in(path);
+    std::string line;
+    int num_lines = 0;
+    while (std::getline(in, line))
+        if (line.find(needle) != std::string::npos)
+            num_lines++;
+    return num_lines;
+}
+
+TEST(test_logger, separate_files)
+{
+    unlink("test_logger_a.txt");
+    unlink("test_logger_b.txt");
+    unlink("test_logger_default.txt");
+    setLogFile("test_logger_default.txt");
+    {
+        Logger a("test_logger_a.txt");
+        Logger b("test_logger_b.txt");
+        b.setLogLevel(LogLevels::kWARNING);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&a, &b, t]() {
+                for (int i = 0; i < 1000; ++i) {
+                    STATIC_LOG_TO(a, LogLevels::kNOTICE, "to a %d %d", t, i);
+                    STATIC_LOG_TO(b, LogLevels::kNOTICE, "filtered %d %d", t, i);
+                    STATIC_LOG_TO(b, LogLevels::kERROR, "to b %d %d", t, i);
+                    STATIC_LOG(LogLevels::kNOTICE, "to default %d %d", t, i);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        EXPECT_EQ(a.getStagingStats().num_messages, 4000u);
+        EXPECT_EQ(b.getStagingStats().num_messages, 4000u);
+    }
+    static_log::sync();
+
+    EXPECT_EQ(countLines("test_logger_a.txt", "to a"), 4000);
+    EXPECT_EQ(countLines("test_logger_a.txt", "to b"), 0);
+    EXPECT_EQ(countLines("test_logger_b.txt", "to b"), 4000);
+    EXPECT_EQ(countLines("test_logger_b.txt", "filtered"), 0);
+    EXPECT_EQ(countLines("test_logger_default.txt", "to default"), 4000);
+    EXPECT_EQ(countLines("test_logger_default.txt", "to a"), 0);
+    unlink("test_logger_a.txt");
+    unlink("test_logger_b.txt");
+    unlink("test_logger_default.txt");
+}
+
+TEST(test_logger, overflow_isolated)
+{
+    // A flood of a small dropping logger does not take messages of
+    // another one
+    unlink("test_logger_flood.txt");
+    unlink("test_logger_quiet.txt");
+    {
+        Logger flood("test_logger_flood.txt");
+        Logger quiet("test_logger_quiet.txt");
+        flood.setStagingBufferSize(4096);
+        flood.setOverflowPolicy(kDROP_NEWEST);
+        std::thread([&flood, &quiet]() {
+            for (int i = 0; i < 100000; ++i) {
+                STATIC_LOG_TO(flood, LogLevels::kNOTICE, "flood %d", i);
+                if (i % 100 == 0)
+                    STATIC_LOG_TO(quiet, LogLevels::kNOTICE, "quiet %d", i);
+            }
+        }).join();
+        EXPECT_EQ(quiet.getStagingStats().num_dropped, 0u);
+    }
+    EXPECT_EQ(countLines("test_logger_quiet.txt", "quiet"), 1000);
+    unlink("test_logger_flood.txt");
+    unlink("test_logger_quiet.txt");
+}
+
+TEST(test_logger, outlives_thread_buffers)
+{
+    // Loggers come and go while a thread keeps logging, taking the ids and
+    // the thread slots of the destroyed ones
+    for (int round = 0; round < 40; ++round) {
+        unlink("test_logger_cycle.txt");
+        {
+            Logger logger("test_logger_cycle.txt");
+            STATIC_LOG_TO(logger, LogLevels::kNOTICE, "round %d", round);
+            std::thread([&logger, round]() {
+                STATIC_LOG_TO(logger, LogLevels::kNOTICE, "thread round %d", round);
+            }).join();
+        }
+        ASSERT_EQ(countLines("test_logger_cycle.txt", "round"), 2) << round;
+    }
+    unlink("test_logger_cycle.txt");
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
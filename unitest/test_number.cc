@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <cmath>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+
+using namespace static_log::details;
+
+#define NUM_RANDOM_SPECS 200000
+#define NUM_RANDOM_FLOATS 200000
+
+static std::mt19937_64 rng(42);
+
+static int
+randomInt(int min, int max)
+{
+    return std::uniform_int_distribution<int>(min, max)(rng);
+}
+
+static uint64_t
+randomValue()
+{
+    static const uint64_t edges[] = {0, 1, 7, 8, 9, 10, 15, 16, 99, 100, 255, 256,
+                                     INT32_MAX, (uint64_t)INT32_MIN, UINT32_MAX,
+                                     INT64_MAX, (uint64_t)INT64_MIN, UINT64_MAX,
+                                     (uint64_t)-1, (uint64_t)-100};
+    switch (randomInt(0, 3)) {
+    case 0:
+        return edges[randomInt(0, sizeof(edges) / sizeof(edges[0]) - 1)];
+    case 1:
+        // Random magnitudes, so all digit counts show up
+        return rng() >> randomInt(0, 63);
+    case 2:
+        return -(rng() >> randomInt(0, 63));
+    default:
+        return rng();
+    }
+}
+
+// Formats value, read as T, with both snprintf and formatInteger
+template<typename T>
+static void
+expectInteger(const std::string& fmt, int width_arg, int precision_arg, T value)
+{
+    FormatSpec spec = parseFormatSpec(fmt.c_str(), 0);
+    ASSERT_EQ(spec.conversion, fmt.back()) << fmt;
+
+    char expected[512];
+    int expected_len;
+    if (spec.dynamic_width && spec.dynamic_precision)
+        expected_len = snprintf(expected, sizeof(expected), fmt.c_str(), width_arg, precision_arg, value);
+    else if (spec.dynamic_width)
+        expected_len = snprintf(expected, sizeof(expected), fmt.c_str(), width_arg, value);
+    else if (spec.dynamic_precision)
+        expected_len = snprintf(expected, sizeof(expected), fmt.c_str(), precision_arg, value);
+    else
+        expected_len = snprintf(expected, sizeof(expected), fmt.c_str(), value);
+    ASSERT_LT(expected_len, (int)sizeof(expected));
+
+    int width = spec.dynamic_width ? width_arg : spec.width;
+    int precision = spec.dynamic_precision ? precision_arg : spec.precision;
+    uint64_t magnitude;
+    bool negative;
+    toPrintfInteger(spec.length, spec.conversion, integerBits(value), magnitude, negative);
+
+    // Too small a buffer only reports the length
+    char actual[512];
+    memset(actual, '#', sizeof(actual));
+    if (expected_len > 0) {
+        ASSERT_EQ(formatInteger(actual, expected_len - 1, spec, width, precision, magnitude, negative),
+                  (size_t)expected_len) << fmt;
+        ASSERT_EQ(actual[0], '#') << fmt;
+    }
+    size_t len = formatInteger(actual, sizeof(actual), spec, width, precision, magnitude, negative);
+    ASSERT_EQ(std::string(actual, len), std::string(expected, expected_len))
+        << fmt << " width " << width_arg << " precision " << precision_arg << " value " << (uint64_t)value;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat"
+static void
+expectRandomSpec()
+{
+    static const char* lengths[] = {"", "hh", "h", "l", "ll", "j", "z", "t"};
+    static const char conversions[] = "diuoxXc";
+
+    std::string fmt = "%";
+    static const char flags[] = "-+ #0";
+    for (int i = randomInt(0, 3); i > 0; --i)
+        fmt += flags[randomInt(0, 4)];
+
+    int kind = randomInt(0, 3);
+    if (kind == 1)
+        fmt += std::to_string(randomInt(0, 30));
+    else if (kind == 2)
+        fmt += '*';
+
+    kind = randomInt(0, 4);
+    if (kind == 1)
+        fmt += '.';
+    else if (kind == 2)
+        fmt += "." + std::to_string(randomInt(0, 30));
+    else if (kind == 3)
+        fmt += ".*";
+
+    char conversion = conversions[randomInt(0, 6)];
+    const char* length = conversion == 'c' ? "" : lengths[randomInt(0, 7)];
+    fmt += length;
+    fmt += conversion;
+
+    int width_arg = randomInt(-30, 30);
+    int precision_arg = randomInt(-5, 30);
+    uint64_t value = randomValue();
+    bool is_signed = isSignedConversion(conversion);
+
+    // Pass the type printf reads for the length modifier
+    if (conversion == 'c' || strcmp(length, "") == 0) {
+        if (is_signed) expectInteger(fmt, width_arg, precision_arg, (int)value);
+        else expectInteger(fmt, width_arg, precision_arg, (unsigned int)value);
+    } else if (strcmp(length, "hh") == 0) {
+        if (is_signed) expectInteger(fmt, width_arg, precision_arg, (signed char)value);
+        else expectInteger(fmt, width_arg, precision_arg, (unsigned char)value);
+    } else if (strcmp(length, "h") == 0) {
+        if (is_signed) expectInteger(fmt, width_arg, precision_arg, (short)value);
+        else expectInteger(fmt, width_arg, precision_arg, (unsigned short)value);
+    } else if (strcmp(length, "l") == 0) {
+        if (is_signed) expectInteger(fmt, width_arg, precision_arg, (long)value);
+        else expectInteger(fmt, width_arg, precision_arg, (unsigned long)value);
+    } else if (strcmp(length, "ll") == 0) {
+        if (is_signed) expectInteger(fmt, width_arg, precision_arg, (long long)value);
+        else expectInteger(fmt, width_arg, precision_arg, (unsigned long long)value);
+    } else if (strcmp(length, "j") == 0) {
+        if (is_signed) expectInteger(fmt, width_arg, precision_arg, (intmax_t)value);
+        else expectInteger(fmt, width_arg, precision_arg, (uintmax_t)value);
+    } else if (strcmp(length, "z") == 0) {
+        if (is_signed) expectInteger(fmt, width_arg, precision_arg, (ssize_t)value);
+        else expectInteger(fmt, width_arg, precision_arg, (size_t)value);
+    } else {
+        if (is_signed) expectInteger(fmt, width_arg, precision_arg, (ptrdiff_t)value);
+        else expectInteger(fmt, width_arg, precision_arg, (size_t)value);
+    }
+}
+#pragma GCC diagnostic pop
+
+// Formats value with both snprintf and formatFloat, returns false if
+// formatFloat leaves it to snprintf
+static bool
+expectFloat(const std::string& fmt, int width_arg, int precision_arg, double value)
+{
+    FormatSpec spec = parseFormatSpec(fmt.c_str(), 0);
+    EXPECT_EQ(spec.conversion, fmt.back()) << fmt;
+
+    char expected[512];
+    int expected_len;
+    if (spec.dynamic_width && spec.dynamic_precision)
+        expected_len = snprintf(expected, sizeof(expected), fmt.c_str(), width_arg, precision_arg, value);
+    else if (spec.dynamic_width)
+        expected_len = snprintf(expected, sizeof(expected), fmt.c_str(), width_arg, value);
+    else if (spec.dynamic_precision)
+        expected_len = snprintf(expected, sizeof(expected), fmt.c_str(), precision_arg, value);
+    else
+        expected_len = snprintf(expected, sizeof(expected), fmt.c_str(), value);
+    EXPECT_LT(expected_len, (int)sizeof(expected));
+
+    int width = spec.dynamic_width ? width_arg : spec.width;
+    int precision = spec.dynamic_precision ? precision_arg : spec.precision;
+    char actual[512];
+    size_t len = formatFloat(actual, sizeof(actual), spec, width, precision, value);
+    if (len == kFORMAT_UNSUPPORTED)
+        return false;
+    EXPECT_EQ(formatFloat(actual, len - 1, spec, width, precision, value), len) << fmt;
+    EXPECT_EQ(std::string(actual, len), std::string(expected, expected_len))
+        << fmt << " width " << width_arg << " precision " << precision_arg << " value "
+        << std::hexfloat << value;
+    return true;
+}
+
+static double
+randomDouble()
+{
+    switch (randomInt(0, 4)) {
+    case 0: {
+        // Any finite double
+        uint64_t bits = rng();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return std::isfinite(value) ? value : 0.0;
+    }
+    case 1:
+        // Short decimals, which are often ties or close to ties
+        return (double)(int64_t)(rng() % 2000001 - 1000000) / std::pow(10, randomInt(0, 6));
+    case 2:
+        // Typical magnitudes
+        return std::ldexp((double)(rng() >> 11), randomInt(-80, 40)) * (randomInt(0, 1) ? 1 : -1);
+    case 3:
+        // Around powers of ten, where the exponent changes when rounding
+        return std::nextafter(std::pow(10, randomInt(-10, 20)), randomInt(0, 1) ? 0.0 : INFINITY);
+    default:
+        return (double)(float)((double)rng() / (double)UINT64_MAX * std::pow(10, randomInt(-5, 10)));
+    }
+}
+
+TEST(test_number, test_float_edge_cases)
+{
+    EXPECT_TRUE(expectFloat("%f", 0, 0, 0.0));
+    EXPECT_TRUE(expectFloat("%f", 0, 0, -0.0));
+    EXPECT_TRUE(expectFloat("%e", 0, 0, 0.0));
+    EXPECT_TRUE(expectFloat("%g", 0, 0, 0.0));
+    EXPECT_TRUE(expectFloat("%a", 0, 0, 0.0));
+    EXPECT_TRUE(expectFloat("%f", 0, 0, 3.14));
+    EXPECT_TRUE(expectFloat("%.2f", 0, 0, 0.125));
+    EXPECT_TRUE(expectFloat("%.2f", 0, 0, 0.375));
+    EXPECT_TRUE(expectFloat("%.2f", 0, 0, 2.675));
+    EXPECT_TRUE(expectFloat("%.0f", 0, 0, 0.5));
+    EXPECT_TRUE(expectFloat("%.0f", 0, 0, 1.5));
+    EXPECT_TRUE(expectFloat("%.0f", 0, 0, 2.5));
+    EXPECT_TRUE(expectFloat("%#.0f", 0, 0, 2.5));
+    EXPECT_TRUE(expectFloat("%.3e", 0, 0, 9.9995));
+    EXPECT_TRUE(expectFloat("%e", 0, 0, 1e30));
+    EXPECT_TRUE(expectFloat("%e", 0, 0, 1e-15));
+    EXPECT_TRUE(expectFloat("%E", 0, 0, 123456789.0));
+    EXPECT_TRUE(expectFloat("%#.0e", 0, 0, 5.0));
+    EXPECT_TRUE(expectFloat("%g", 0, 0, 100000.0));
+    EXPECT_TRUE(expectFloat("%g", 0, 0, 1000000.0));
+    EXPECT_TRUE(expectFloat("%g", 0, 0, 0.0001));
+    EXPECT_TRUE(expectFloat("%g", 0, 0, 0.00001));
+    EXPECT_TRUE(expectFloat("%g", 0, 0, 999999.5));
+    EXPECT_TRUE(expectFloat("%#g", 0, 0, 1.0));
+    EXPECT_TRUE(expectFloat("%.0g", 0, 0, 0.5));
+    EXPECT_TRUE(expectFloat("%G", 0, 0, 1e-10));
+    EXPECT_TRUE(expectFloat("%#g", 0, 0, 999999.5));
+    EXPECT_TRUE(expectFloat("%#.3g", 0, 0, 999.7));
+    EXPECT_TRUE(expectFloat("%#g", 0, 0, 9.9999999));
+    EXPECT_TRUE(expectFloat("%a", 0, 0, 1.0));
+    EXPECT_TRUE(expectFloat("%A", 0, 0, -3.0));
+    EXPECT_TRUE(expectFloat("%#a", 0, 0, 1.0));
+    EXPECT_TRUE(expectFloat("%+012.3f", 0, 0, -1.5));
+    EXPECT_TRUE(expectFloat("% -12.3e", 0, 0, 1.5));
+    EXPECT_TRUE(expectFloat("%010a", 0, 0, 1.0));
+    EXPECT_TRUE(expectFloat("%-*.*f", 12, 3, 2.0));
+    EXPECT_TRUE(expectFloat("%*.*f", -12, -1, 2.0));
+    EXPECT_TRUE(expectFloat("%.17g", 0, 0, 0.1));
+    EXPECT_TRUE(expectFloat("%.20f", 0, 0, 0.1));
+    EXPECT_TRUE(expectFloat("%f", 0, 0, 5e-324));
+
+    // Left to snprintf
+    EXPECT_FALSE(expectFloat("%f", 0, 0, INFINITY));
+    EXPECT_FALSE(expectFloat("%e", 0, 0, NAN));
+    EXPECT_FALSE(expectFloat("%.3a", 0, 0, 1.0));
+    EXPECT_FALSE(expectFloat("%a", 0, 0, 5e-324));
+    EXPECT_FALSE(expectFloat("%.40f", 0, 0, 1.0));
+    EXPECT_FALSE(expectFloat("%e", 0, 0, 1e300));
+    EXPECT_FALSE(expectFloat("%f", 0, 0, 1.7976931348623157e308));
+}
+
+TEST(test_number, test_float_random_specs)
+{
+    static const char conversions[] = "fFeEgGaA";
+    static const char flags[] = "-+ #0";
+    int num_supported = 0;
+    for (int i = 0; i < NUM_RANDOM_FLOATS && !HasFailure(); ++i) {
+        std::string fmt = "%";
+        for (int j = randomInt(0, 3); j > 0; --j)
+            fmt += flags[randomInt(0, 4)];
+
+        int kind = randomInt(0, 3);
+        if (kind == 1)
+            fmt += std::to_string(randomInt(0, 30));
+        else if (kind == 2)
+            fmt += '*';
+
+        kind = randomInt(0, 4);
+        if (kind == 1)
+            fmt += '.';
+        else if (kind == 2)
+            fmt += "." + std::to_string(randomInt(0, 20));
+        else if (kind == 3)
+            fmt += ".*";
+        fmt += conversions[randomInt(0, 7)];
+
+        num_supported += expectFloat(fmt, randomInt(-30, 30), randomInt(-5, 20), randomDouble());
+    }
+    printf("formatFloat handled %d of %d random values\n", num_supported, NUM_RANDOM_FLOATS);
+}
+
+TEST(test_number, test_float_typical_values_supported)
+{
+    // Everything a log line usually holds must be handled without snprintf
+    static const char* specs[] = {"%f", "%.3f", "%lf", "%10.2f", "%e", "%.3e", "%g", "%.10g"};
+    for (int i = 0; i < 10000; ++i) {
+        double value = std::ldexp((double)(rng() >> 11), -53) * std::pow(10, randomInt(-6, 15));
+        for (const char* spec : specs)
+            ASSERT_TRUE(expectFloat(spec, 0, 0, randomInt(0, 1) ? value : -value)) << spec << " " << value;
+    }
+}
+
+TEST(test_number, test_integer_edge_cases)
+{
+    expectInteger("%d", 0, 0, 0);
+    expectInteger("%d", 0, 0, INT32_MIN);
+    expectInteger("%lld", 0, 0, (long long)INT64_MIN);
+    expectInteger("%llu", 0, 0, (unsigned long long)UINT64_MAX);
+    expectInteger("%llo", 0, 0, (unsigned long long)UINT64_MAX);
+    expectInteger("%#llX", 0, 0, (unsigned long long)UINT64_MAX);
+    expectInteger("%.0d", 0, 0, 0);
+    expectInteger("%+.0d", 0, 0, 0);
+    expectInteger("%#.0o", 0, 0, 0u);
+    expectInteger("%#.0x", 0, 0, 0u);
+    expectInteger("%#x", 0, 0, 0u);
+    expectInteger("%#5.3x", 0, 0, 10u);
+    expectInteger("%#08x", 0, 0, 255u);
+    expectInteger("%-#8o", 0, 0, 8u);
+    expectInteger("%-05d", 0, 0, 3);
+    expectInteger("%05c", 0, 0, 'a');
+    expectInteger("%-*d", -7, 0, 12);
+    expectInteger("%*d", -7, 0, 12);
+    expectInteger("%.*d", 0, -1, 0);
+    expectInteger("%hhd", 0, 0, (signed char)-56);
+    expectInteger("% 05d", 0, 0, 42);
+    expectInteger("%+ d", 0, 0, 42);
+}
+
+TEST(test_number, test_integer_random_specs)
+{
+    for (int i = 0; i < NUM_RANDOM_SPECS && !HasFatalFailure(); ++i)
+        expectRandomSpec();
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+#include "static_log_sink.h"
+
+using namespace static_log;
+using namespace static_log::details;
+
+#define OUTPUT_FILE "test_output.txt"
+
+static off_t
+fileSize(const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return -1;
+    return st.st_size;
+}
+
+TEST(test_output, test_flush_on_threshold)
+{
+    unlink(OUTPUT_FILE);
+    int fd = open(OUTPUT_FILE, O_RDWR|O_CREAT, 0666);
+    ASSERT_NE(fd, -1);
+    {
+        OutputBuffer output;
+        output.configure(100000, 1000000, kSYNC_WRITE, 1);
+        output.setFd(fd);
+        std::string data(60000, 'a');
+
+        output.append(data.data(), data.size(), 0);
+        OutputStats stats = output.getStats();
+        EXPECT_EQ(stats.num_flushes, 0u);
+        EXPECT_EQ(stats.bytes_written, 0u);
+        EXPECT_EQ(fileSize(OUTPUT_FILE), 0);
+
+        // Crosses the threshold in the second chunk, both go out with one
+        // pwritev
+        output.append(data.data(), data.size(), 0);
+        stats = output.getStats();
+        EXPECT_EQ(stats.num_flushes, 1u);
+        EXPECT_EQ(stats.bytes_written, 120000u);
+        EXPECT_EQ(stats.num_syscalls, 1u);
+        EXPECT_EQ(stats.last_flush_bytes, 120000u);
+        EXPECT_EQ(stats.last_flush_syscalls, 1u);
+        EXPECT_EQ(stats.max_flush_bytes, 120000u);
+        EXPECT_EQ(stats.active_sink, kSYNC_WRITE);
+        EXPECT_EQ(fileSize(OUTPUT_FILE), 120000);
+
+        // A smaller flush adds to the totals, the largest one stays
+        output.append(data.data(), 1000, 0);
+        output.flush();
+        stats = output.getStats();
+        EXPECT_EQ(stats.num_flushes, 2u);
+        EXPECT_EQ(stats.bytes_written, 121000u);
+        EXPECT_EQ(stats.num_syscalls, 2u);
+        EXPECT_EQ(stats.last_flush_bytes, 1000u);
+        EXPECT_EQ(stats.last_flush_syscalls, 1u);
+        EXPECT_EQ(stats.max_flush_bytes, 120000u);
+        EXPECT_EQ(fileSize(OUTPUT_FILE), 121000);
+    }
+    close(fd);
+    unlink(OUTPUT_FILE);
+}
+
+TEST(test_output, test_flush_on_latency)
+{
+    unlink(OUTPUT_FILE);
+    int fd = open(OUTPUT_FILE, O_RDWR|O_CREAT, 0666);
+    ASSERT_NE(fd, -1);
+    {
+        OutputBuffer output;
+        output.configure(1 << 20, 1000, kSYNC_WRITE, 1);
+        output.setFd(fd);
+        EXPECT_EQ(output.flushIfStale(0), UINT64_MAX);
+
+        // A partial chunk waits for the max latency, counted from its
+        // first byte
+        int64_t start_ns = 1000000000;
+        output.append("0123456789", 10, start_ns);
+        output.append("0123456789", 10, start_ns + 400000);
+        EXPECT_EQ(output.flushIfStale(start_ns + 500000), 501u);
+        EXPECT_EQ(output.getStats().num_flushes, 0u);
+        EXPECT_EQ(fileSize(OUTPUT_FILE), 0);
+
+        EXPECT_EQ(output.flushIfStale(start_ns + 1000000), UINT64_MAX);
+        OutputStats stats = output.getStats();
+        EXPECT_EQ(stats.num_flushes, 1u);
+        EXPECT_EQ(stats.bytes_written, 20u);
+        EXPECT_EQ(stats.last_flush_bytes, 20u);
+        EXPECT_EQ(stats.last_flush_syscalls, 1u);
+        EXPECT_EQ(fileSize(OUTPUT_FILE), 20);
+
+        // Nothing pending, nothing written
+        EXPECT_EQ(output.flushIfStale(start_ns + 5000000), UINT64_MAX);
+        EXPECT_EQ(output.getStats().num_flushes, 1u);
+    }
+    close(fd);
+    unlink(OUTPUT_FILE);
+}
+
+TEST(test_output, test_output_stats)
+{
+    // The totals of the backend account for every byte of the file
+    unlink(OUTPUT_FILE);
+    setLogFile(OUTPUT_FILE);
+    setOutputBuffering(4096, 100000);
+    OutputStats before = getOutputStats();
+    for (int i = 0; i < 10000; ++i)
+        STATIC_LOG(LogLevels::kNOTICE, "message %d of the stats test", i);
+    // Switching files writes out everything logged before
+    setLogFile("test_output.last");
+    OutputStats after = getOutputStats();
+
+    off_t size = fileSize(OUTPUT_FILE);
+    EXPECT_GT(size, 10000 * 20);
+    EXPECT_EQ(after.bytes_written - before.bytes_written, (uint64_t)size);
+    EXPECT_GT(after.num_flushes - before.num_flushes, (uint64_t)size / 65536);
+    EXPECT_GE(after.num_syscalls - before.num_syscalls, after.num_flushes - before.num_flushes);
+    EXPECT_GE(after.max_flush_bytes, 4096u);
+    EXPECT_GT(after.last_flush_bytes, 0u);
+
+    setOutputBuffering(OutputBuffer::kDEFAULT_FLUSH_THRESHOLD, OutputBuffer::kDEFAULT_MAX_LATENCY_US);
+    unlink(OUTPUT_FILE);
+    unlink("test_output.last");
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+
+using namespace static_log;
+
+#define NUM_MESSAGES 20000
+
+/**
+ * Logs NUM_MESSAGES messages of the given level from a new thread with a
+ * 4KB StagingBuffer, so that the buffer overflows many times
+ */
+static void
+logBurst(LogLevels::LogLevel level, int thread_policy = -1)
+{
+    std::thread thread([level, thread_policy]() {
+        preallocate(4096);
+        if (thread_policy >= 0)
+            setThreadOverflowPolicy(static_cast<OverflowPolicy>(thread_policy));
+        std::string padding(64, 'x');
+        for (int i = 0; i < NUM_MESSAGES; ++i) {
+            // The level of a call site is a constant
+            if (level == LogLevels::kERROR)
+                STATIC_LOG(LogLevels::kERROR, "%d|%s", i, padding.c_str());
+            else
+                STATIC_LOG(LogLevels::kNOTICE, "%d|%s", i, padding.c_str());
+        }
+    });
+    thread.join();
+}
+
+struct BurstOutput {
+    int num_lines;
+    uint64_t num_reported;
+    int last_seq;
+};
+
+/**
+ * Writes out what was logged to path and checks that the messages that
+ * made it are in order
+ */
+static BurstOutput
+readBurst(const char* path)
+{
+    // Switching files writes out everything logged before
+    setLogFile("test_overflow.last");
+    unlink("test_overflow.last");
+
+    BurstOutput output{0, 0, -1};
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t prefix_end = line.rfind(']');
+        EXPECT_NE(prefix_end, std::string::npos) << line;
+        const char* message = line.c_str() + prefix_end + 1;
+        unsigned long count;
+        int seq;
+        if (sscanf(message, "%lu messages dropped", &count) == 1 && strstr(message, "dropped")) {
+            output.num_reported += count;
+        } else {
+            EXPECT_EQ(sscanf(message, "%d|", &seq), 1) << line;
+            EXPECT_GT(seq, output.last_seq) << line;
+            output.last_seq = seq;
+            output.num_lines++;
+        }
+    }
+    unlink(path);
+    return output;
+}
+
+TEST(test_overflow, block_counts_waits)
+{
+    StagingStats before = getStagingStats();
+    unlink("test_overflow_block.txt");
+    setLogFile("test_overflow_block.txt");
+    logBurst(LogLevels::kNOTICE);
+    BurstOutput output = readBurst("test_overflow_block.txt");
+    EXPECT_EQ(output.num_lines, NUM_MESSAGES);
+    EXPECT_EQ(output.num_reported, 0u);
+
+    StagingStats after = getStagingStats();
+    EXPECT_EQ(after.num_dropped, before.num_dropped);
+    EXPECT_GT(after.num_times_producer_blocked, before.num_times_producer_blocked);
+    EXPECT_GT(after.cycles_producer_blocked, before.cycles_producer_blocked);
+}
+
+TEST(test_overflow, drop_newest)
+{
+    StagingStats before = getStagingStats();
+    setOverflowPolicy(kDROP_NEWEST);
+    unlink("test_overflow_drop.txt");
+    setLogFile("test_overflow_drop.txt");
+    logBurst(LogLevels::kNOTICE);
+    setOverflowPolicy(kBLOCK);
+    BurstOutput output = readBurst("test_overflow_drop.txt");
+
+    StagingStats after = getStagingStats();
+    uint64_t num_dropped = after.num_dropped - before.num_dropped;
+    EXPECT_GT(num_dropped, 0u);
+    EXPECT_EQ(output.num_reported, num_dropped);
+    EXPECT_EQ(output.num_lines + num_dropped, (uint64_t)NUM_MESSAGES);
+    EXPECT_EQ(after.num_times_producer_blocked, before.num_times_producer_blocked);
+}
+
+TEST(test_overflow, overwrite_oldest)
+{
+    StagingStats before = getStagingStats();
+    unlink("test_overflow_overwrite.txt");
+    setLogFile("test_overflow_overwrite.txt");
+    logBurst(LogLevels::kNOTICE, kOVERWRITE_OLDEST);
+    BurstOutput output = readBurst("test_overflow_overwrite.txt");
+
+    StagingStats after = getStagingStats();
+    uint64_t num_dropped = after.num_dropped - before.num_dropped;
+    EXPECT_GT(num_dropped, 0u);
+    EXPECT_EQ(output.num_reported, num_dropped);
+    EXPECT_EQ(output.num_lines + num_dropped, (uint64_t)NUM_MESSAGES);
+    EXPECT_EQ(after.num_times_producer_blocked, before.num_times_producer_blocked);
+}
+
+TEST(test_overflow, level_policy)
+{
+    setOverflowPolicy(kDROP_NEWEST);
+    setOverflowPolicy(LogLevels::kERROR, kBLOCK);
+    unlink("test_overflow_level.txt");
+    setLogFile("test_overflow_level.txt");
+    logBurst(LogLevels::kERROR);
+    setOverflowPolicy(kBLOCK);
+    BurstOutput output = readBurst("test_overflow_level.txt");
+    EXPECT_EQ(output.num_lines, NUM_MESSAGES);
+    EXPECT_EQ(output.num_reported, 0u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
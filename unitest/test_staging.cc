@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+
+using namespace static_log;
+
+#define NUM_THREADS 4
+#define NUM_MESSAGES 20000
+
+static void
+logBurst(int thread_id, size_t buffer_size)
+{
+    if (buffer_size != 0)
+        preallocate(buffer_size);
+    std::string padding(64, 'a' + thread_id);
+    for (int i = 0; i < NUM_MESSAGES; ++i)
+        STATIC_LOG(LogLevels::kNOTICE, "%d|%d|%s", thread_id, i, padding.c_str());
+}
+
+/**
+ * Logs a burst from NUM_THREADS threads into path and checks that every
+ * message is written once, in order within its thread. With time_sorted,
+ * the lines must also be in the order of their kEPOCH_NANOSECONDS
+ * timestamps.
+ */
+static void
+checkBurst(const char* path, size_t buffer_size, bool time_sorted = false)
+{
+    unlink(path);
+    setLogFile(path);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; ++t)
+        threads.emplace_back(logBurst, t, buffer_size);
+    for (auto& thread : threads)
+        thread.join();
+    // Switching files writes out everything logged before
+    setLogFile("test_staging.last");
+    unlink("test_staging.last");
+
+    std::ifstream in(path);
+    std::string line;
+    std::vector<int> next(NUM_THREADS, 0);
+    int num_lines = 0;
+    int64_t last_timestamp = 0;
+    while (std::getline(in, line)) {
+        if (time_sorted) {
+            int64_t timestamp;
+            ASSERT_EQ(sscanf(line.c_str(), "[%ld]", &timestamp), 1) << line;
+            ASSERT_GE(timestamp, last_timestamp) << line;
+            last_timestamp = timestamp;
+        }
+        size_t prefix_end = line.rfind(']');
+        ASSERT_NE(prefix_end, std::string::npos) << line;
+        int thread_id, seq;
+        ASSERT_EQ(sscanf(line.c_str() + prefix_end + 1, "%d|%d|", &thread_id, &seq), 2) << line;
+        ASSERT_GE(thread_id, 0);
+        ASSERT_LT(thread_id, NUM_THREADS);
+        EXPECT_EQ(seq, next[thread_id]) << line;
+        next[thread_id] = seq + 1;
+        num_lines++;
+    }
+    EXPECT_EQ(num_lines, NUM_THREADS * NUM_MESSAGES);
+    unlink(path);
+}
+
+TEST(test_staging, time_ordered)
+{
+    // A window far longer than a producer is preempted for, and no
+    // recalibration moving the rendered times during the burst
+    setTimestampFormat(kEPOCH_NANOSECONDS);
+    setClockRecalibrationInterval(3600 * 1000);
+    setOutputOrdering(kTIME_ORDERED, 100000);
+    uint64_t out_of_order = getOutputStats().num_out_of_order;
+    checkBurst("test_staging_ordered.txt", 65536, true);
+    EXPECT_EQ(getOutputStats().num_out_of_order, out_of_order);
+    setOutputOrdering(kTIME_ORDERED);
+    setClockRecalibrationInterval(1000);
+    setTimestampFormat(kLOCAL_NANOSECONDS);
+}
+
+TEST(test_staging, unordered)
+{
+    setOutputOrdering(kUNORDERED);
+    checkBurst("test_staging_unordered.txt", 65536);
+    setOutputOrdering(kTIME_ORDERED);
+}
+
+TEST(test_staging, drain_batches)
+{
+    // Batches far smaller than a contiguous region, which is consumed in
+    // several passes
+    setOutputOrdering(kUNORDERED);
+    setDrainBatchSize(1);
+    checkBurst("test_staging_batch1.txt", 4096);
+    setDrainBatchSize(7);
+    checkBurst("test_staging_batch7.txt", 4096);
+
+    // A batch ending in a full segment carries on in the next one
+    uint64_t chained = getStagingStats().num_segments_chained;
+    setStagingBufferSize(8192, 1 << 20);
+    checkBurst("test_staging_batch_elastic.txt", 0);
+    setStagingBufferSize(1 << 20);
+    EXPECT_GT(getStagingStats().num_segments_chained, chained);
+
+    // The budget of the merge is shared by all the threads
+    setOutputOrdering(kTIME_ORDERED);
+    checkBurst("test_staging_batch_merged.txt", 4096);
+    setDrainBatchSize(0);
+}
+
+TEST(test_staging, small_buffers_block)
+{
+    // The producers wait for the backend many times over
+    checkBurst("test_staging_small.txt", 4096);
+}
+
+TEST(test_staging, elastic_buffers)
+{
+    uint64_t chained = getStagingStats().num_segments_chained;
+    setStagingBufferSize(8192, 1 << 20);
+    checkBurst("test_staging_elastic.txt", 0);
+    setStagingBufferSize(1 << 20);
+    // A thread writes its burst much faster than the backend wakes up
+    EXPECT_GT(getStagingStats().num_segments_chained, chained);
+}
+
+TEST(test_staging, mapped_memory)
+{
+    setStagingMemory(kSTAGING_PREFAULT | kSTAGING_HUGEPAGES);
+    checkBurst("test_staging_mapped.txt", 65536);
+    setStagingMemory(kSTAGING_MALLOC);
+}
+
+TEST(test_staging, numa_workers)
+{
+    // One worker per node, bound to it, or a single one on a machine
+    // without NUMA
+    setNumaWorkers(true);
+    checkBurst("test_staging_numa.txt", 65536);
+    setStagingMemory(kSTAGING_PREFAULT);
+    checkBurst("test_staging_numa_mapped.txt", 65536);
+    setStagingMemory(kSTAGING_MALLOC);
+    setNumaWorkers(false);
+}
+
+TEST(test_staging, sharded_workers)
+{
+    // The workers append their batches to the same file
+    setBackendWorkers(4);
+    checkBurst("test_staging_sharded.txt", 65536);
+    setBackendWorkers(1);
+}
+
+TEST(test_staging, shard_files)
+{
+    const char* paths[] = {"test_staging_shards.txt", "test_staging_shards.txt.1",
+                           "test_staging_shards.txt.2", "test_staging_shards.txt.3"};
+    for (auto path : paths)
+        unlink(path);
+    setLogFile(paths[0]);
+    setBackendWorkers(4, kSHARD_FILES);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; ++t)
+        threads.emplace_back(logBurst, t, 65536);
+    for (auto& thread : threads)
+        thread.join();
+    // Back to a single worker writing the log file, after a last pass
+    setBackendWorkers(1);
+    STATIC_LOG(LogLevels::kNOTICE, "%s", "after the shards");
+    setLogFile("test_staging.last");
+    unlink("test_staging.last");
+
+    // Every thread is in a single file, in order
+    std::vector<int> next(NUM_THREADS, 0);
+    int num_lines = 0;
+    int num_files = 0;
+    for (auto path : paths) {
+        std::ifstream in(path);
+        std::string line;
+        bool has_lines = false;
+        while (std::getline(in, line)) {
+            if (line.find("after the shards") != std::string::npos) {
+                EXPECT_EQ(path, paths[0]);
+                continue;
+            }
+            size_t prefix_end = line.rfind(']');
+            ASSERT_NE(prefix_end, std::string::npos) << line;
+            int thread_id, seq;
+            ASSERT_EQ(sscanf(line.c_str() + prefix_end + 1, "%d|%d|", &thread_id, &seq), 2) << line;
+            ASSERT_GE(thread_id, 0);
+            ASSERT_LT(thread_id, NUM_THREADS);
+            EXPECT_EQ(seq, next[thread_id]) << path << ": " << line;
+            next[thread_id] = seq + 1;
+            num_lines++;
+            has_lines = true;
+        }
+        num_files += has_lines;
+        unlink(path);
+    }
+    EXPECT_EQ(num_lines, NUM_THREADS * NUM_MESSAGES);
+    EXPECT_GT(num_files, 1);
+}
+
+TEST(test_staging, writer_thread_sink)
+{
+    // Small flushes, so that the writer thread is often behind
+    setOutputBuffering(64 * 1024, 100);
+    setOutputSink(kWRITER_THREAD, 2);
+    checkBurst("test_staging_writer.txt", 65536);
+    EXPECT_EQ(getOutputStats().active_sink, kWRITER_THREAD);
+    setOutputSink(kSYNC_WRITE);
+    setOutputBuffering(1024 * 1024, 1000);
+}
+
+TEST(test_staging, wait_strategies)
+{
+    // Pinned to the first CPU, which every machine has
+    int cpu = 0;
+    setBackendThreads(&cpu, 1);
+    setBackendWaitStrategy(kWAIT_BACKOFF, 20);
+    checkBurst("test_staging_backoff.txt", 65536);
+    setBackendWaitStrategy(kWAIT_TPAUSE);
+    checkBurst("test_staging_tpause.txt", 65536);
+    setBackendWaitStrategy(kWAIT_SLEEP);
+    setBackendThreads(NULL, 0);
+}
+
+/**
+ * Logs bursts of about twice the capacity of a 64KB StagingBuffer, each
+ * after the backend went to sleep, and returns the number of watermark
+ * wakeups.
+ */
+static uint64_t
+logSleepyBursts(uint32_t watermark)
+{
+    setStagingWatermark(watermark);
+    StagingStats before = getStagingStats();
+    std::thread([]() {
+        preallocate(65536);
+        for (int burst = 0; burst < 20; ++burst) {
+            usleep(3000);
+            for (int i = 0; i < 4000; ++i)
+                STATIC_LOG(LogLevels::kNOTICE, "burst %d message %d %s", burst, i, "padding");
+        }
+    }).join();
+    StagingStats after = getStagingStats();
+    return after.num_watermark_wakeups - before.num_watermark_wakeups;
+}
+
+TEST(test_staging, watermark_wakeup)
+{
+    unlink("test_staging_watermark.txt");
+    setLogFile("test_staging_watermark.txt");
+    EXPECT_EQ(logSleepyBursts(0), 0u);
+    // The backend starts draining from the middle of the bursts
+    EXPECT_GT(logSleepyBursts(50), 0u);
+
+    // A slow stream the backend keeps up with goes round the buffer many
+    // times without ever filling half of it
+    uint64_t wakeups = getStagingStats().num_watermark_wakeups;
+    std::thread([]() {
+        preallocate(65536);
+        for (int i = 0; i < 20000; ++i) {
+            STATIC_LOG(LogLevels::kNOTICE, "steady message %d %s", i, "padding");
+            if (i % 100 == 99) {
+                static_log::sync();
+                usleep(1000);
+            }
+        }
+    }).join();
+    EXPECT_EQ(getStagingStats().num_watermark_wakeups, wakeups);
+    setStagingWatermark(50);
+    setLogFile("test_staging.last");
+    unlink("test_staging.last");
+    unlink("test_staging_watermark.txt");
+}
+
+TEST(test_staging, thread_churn)
+{
+    // More threads than a block of the registry, registering and exiting
+    // while the backend drains and retires buffers
+    const int num_threads = 200;
+    const int num_messages = 10;
+    unlink("test_staging_churn.txt");
+    setLogFile("test_staging_churn.txt");
+    uint64_t logged = getStagingStats().num_messages;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < num_messages; ++i)
+                STATIC_LOG(LogLevels::kNOTICE, "%d|%d|", t, i);
+        });
+        // Stats readers run concurrently with the retirements
+        getStagingStats();
+    }
+    for (auto& thread : threads)
+        thread.join();
+    setLogFile("test_staging.last");
+    unlink("test_staging.last");
+    EXPECT_EQ(getStagingStats().num_messages - logged, (uint64_t)num_threads * num_messages);
+
+    std::ifstream in("test_staging_churn.txt");
+    std::string line;
+    int num_lines = 0;
+    while (std::getline(in, line))
+        num_lines++;
+    EXPECT_EQ(num_lines, num_threads * num_messages);
+    unlink("test_staging_churn.txt");
+}
+
+TEST(test_staging, pool_reuse)
+{
+    const size_t buffer_size = 65536;
+    // Empties the pool of the buffers of the other tests
+    setStagingPoolSize(0);
+    setStagingPoolSize(4 * buffer_size);
+    StagingStats before = getStagingStats();
+    std::thread([]() {
+        preallocate(buffer_size);
+        STATIC_LOG(LogLevels::kNOTICE, "%s", "first thread");
+    }).join();
+
+    // The worker retires the buffer once it has written it out
+    for (int i = 0; i < 2000 && getStagingStats().pool_bytes < buffer_size; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ASSERT_EQ(getStagingStats().pool_bytes, buffer_size);
+
+    std::thread([]() {
+        preallocate(buffer_size);
+        STATIC_LOG(LogLevels::kNOTICE, "%s", "second thread");
+    }).join();
+    StagingStats after = getStagingStats();
+    EXPECT_EQ(after.num_pool_hits, before.num_pool_hits + 1);
+    EXPECT_EQ(after.num_pool_misses, before.num_pool_misses + 1);
+
+    // A buffer of another capacity is not taken from the pool
+    for (int i = 0; i < 2000 && getStagingStats().pool_bytes < buffer_size; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::thread([]() { preallocate(2 * buffer_size); }).join();
+    EXPECT_EQ(getStagingStats().num_pool_misses, before.num_pool_misses + 2);
+
+    setStagingPoolSize(0);
+    EXPECT_EQ(getStagingStats().pool_bytes, 0u);
+    setStagingPoolSize(8 << 20);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "static_log.h"
+#include "static_log_timestamp.h"
+
+using namespace static_log;
+using namespace static_log::details;
+
+static std::string
+render(TimestampRenderer& renderer, int64_t timestamp_ns)
+{
+    char buffer[MAX_TIMESTAMP_LEN];
+    size_t len = renderer.render(timestamp_ns, buffer);
+    EXPECT_LE(len, sizeof(buffer));
+    return std::string(buffer, len);
+}
+
+// The timestamp as rendered by strftime() from a fresh localtime_r() call
+static std::string
+expectedLocal(int64_t timestamp_ns)
+{
+    time_t seconds = timestamp_ns / 1000000000;
+    struct tm tm_now;
+    localtime_r(&seconds, &tm_now);
+    char buffer[64];
+    size_t len = strftime(buffer, sizeof(buffer), "%Y-%m-%d-%H:%M:%S.", &tm_now);
+    snprintf(buffer + len, sizeof(buffer) - len, "%09lld", (long long)(timestamp_ns % 1000000000));
+    return buffer;
+}
+
+class test_timestamp : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        const char* tz = getenv("TZ");
+        saved_tz_ = tz ? tz : "";
+        had_tz_ = tz != NULL;
+    }
+
+    void TearDown() override
+    {
+        if (had_tz_)
+            setenv("TZ", saved_tz_.c_str(), 1);
+        else
+            unsetenv("TZ");
+        tzset();
+    }
+
+    std::string saved_tz_;
+    bool had_tz_;
+};
+
+TEST_F(test_timestamp, test_formats)
+{
+    setenv("TZ", "UTC", 1);
+    // 2026-10-16 14:07:57 UTC
+    int64_t ts = 1792159677LL * 1000000000 + 581963213;
+
+    TimestampRenderer renderer;
+    EXPECT_EQ(render(renderer, ts), "2026-10-16-14:07:57.581963213");
+    EXPECT_EQ(render(renderer, ts + 1), "2026-10-16-14:07:57.581963214");
+    EXPECT_EQ(render(renderer, ts - 581963213), "2026-10-16-14:07:57.000000000");
+
+    renderer.setFormat(kLOCAL_MICROSECONDS);
+    EXPECT_EQ(render(renderer, ts), "2026-10-16-14:07:57.581963");
+
+    renderer.setFormat(kEPOCH_NANOSECONDS);
+    EXPECT_EQ(render(renderer, ts), "1792159677581963213");
+    EXPECT_EQ(render(renderer, -5), "-5");
+
+    renderer.setFormat(kISO8601_UTC);
+    EXPECT_EQ(render(renderer, ts), "2026-10-16T14:07:57.581963213Z");
+    // The sub-second digits stay positive before the epoch
+    EXPECT_EQ(render(renderer, -1), "1969-12-31T23:59:59.999999999Z");
+}
+
+TEST_F(test_timestamp, test_follows_seconds)
+{
+    setenv("TZ", "UTC", 1);
+    TimestampRenderer renderer;
+    int64_t ts = 1792159677LL * 1000000000;
+    EXPECT_EQ(render(renderer, ts + 999999999), "2026-10-16-14:07:57.999999999");
+    EXPECT_EQ(render(renderer, ts + 1000000000), "2026-10-16-14:07:58.000000000");
+    // Out of order timestamps, as output by the unordered mode
+    EXPECT_EQ(render(renderer, ts), "2026-10-16-14:07:57.000000000");
+    EXPECT_EQ(render(renderer, ts + 86400000000000LL), "2026-10-17-14:07:57.000000000");
+}
+
+TEST_F(test_timestamp, test_dst_transitions)
+{
+    setenv("TZ", "America/New_York", 1);
+    TimestampRenderer renderer;
+
+    // 2026-03-08 06:59:59 UTC is 01:59:59 EST, one second later is 03:00:00
+    // EDT, and 2026-11-01 05:59:59 UTC is 01:59:59 EDT, followed by 01:00:00
+    // EST
+    int64_t spring = 1772953199LL * 1000000000 + 123;
+    EXPECT_EQ(render(renderer, spring), "2026-03-08-01:59:59.000000123");
+    EXPECT_EQ(render(renderer, spring + 1000000000), "2026-03-08-03:00:00.000000123");
+
+    int64_t fall = 1793512799LL * 1000000000 + 456;
+    EXPECT_EQ(render(renderer, fall), "2026-11-01-01:59:59.000000456");
+    EXPECT_EQ(render(renderer, fall + 1000000000), "2026-11-01-01:00:00.000000456");
+
+    // Every second of a day spanning a transition matches a fresh conversion
+    for (int64_t s = 0; s < 86400; s += 7) {
+        int64_t ts = (1772928000LL + s) * 1000000000 + s;
+        ASSERT_EQ(render(renderer, ts), expectedLocal(ts));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -367,10 +367,10 @@ process_fmt(
 
                 if (param_idx < num_params) {
                     if (param_types[param_idx] > ParamType::kNON_STRING) {
-                        uint32_t string_size = *(uint32_t*)param_list;
-                        param_list += sizeof(uint32_t);
+                        uint64_t string_size;
+                        param_list = decodeVarint(param_list, &string_size);
                         log_fmt_len = decodeStringFmt(log_buffer, buflen, reserved, log_pos - log_buffer, param_list, string_size, fmt_single);
-                        param_list = param_list + sizeof(uint32_t) + string_size;
+                        param_list = param_list + string_size;
                     }
                     else {
                         log_fmt_len = decodeNonStringFmt(log_buffer, buflen, reserved, log_pos - log_buffer, fmt_single, param_list, param_size_list[param_idx]);
@@ -414,7 +414,7 @@ TEST(test_utils, test_fmt_simple)
     uint64_t previousPrecision = -1;
     size_t alloc_size = getArgSizes(param_types, previousPrecision,
                             string_sizes, c_parma, int_param, fl_param, f_param, s_param);
-    uint64_t store_bufsize = sizeof(char) + sizeof(int) + sizeof(double) + sizeof(float) + sizeof(uint32_t) + 11;
+    uint64_t store_bufsize = sizeof(char) + sizeof(int) + sizeof(double) + sizeof(float) + varintSize(11) + 11;
     ASSERT_EQ(alloc_size, store_bufsize);
     
     ASSERT_EQ(string_sizes[0], 1);
@@ -524,9 +524,9 @@ TEST(test_fmt, test_decode_string_fmt)
     ParamType param_type[1] = {kSTRING};
     size_t string_size[1] = {11};
     size_t buflen = 1;
-    char* param_list = (char*)malloc(sizeof(uint32_t) + 11);
-    *(uint32_t*)param_list = 11;
-    memcpy(param_list + sizeof(uint32_t), "hello world", 11);
+    char* param_list = (char*)malloc(kMAX_VARINT_LEN + 11);
+    char* string_pos = encodeVarint(param_list, 11);
+    memcpy(string_pos, "hello world", 11);
     int plen = process_fmt("%s", 1, &param_type[0], &string_size[0], (char*)param_list, log_buffer, buflen, 0);
     ASSERT_EQ(plen, 11);
     log_buffer[plen] = '\0';